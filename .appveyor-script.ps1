@@ -26,6 +26,7 @@ Run-Test -TestName "diff"
 Run-Test -TestName "graph"
 Run-Test -TestName "ignore"
 Run-Test -TestName "index"
+Run-Test -TestName "log"
 Run-Test -TestName "merge"
 Run-Test -TestName "message"
 Run-Test -TestName "pathspec"
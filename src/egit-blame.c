@@ -3,7 +3,10 @@
 #include "git2.h"
 
 #include "egit.h"
+#include "egit-diff.h"
+#include "egit-util.h"
 #include "interface.h"
+#include "egit-blame.h"
 
 
 static emacs_value extract_options(emacs_env *env, emacs_value eopts, git_blame_options *opts)
@@ -90,6 +93,994 @@ emacs_value egit_blame_file(emacs_env *env, emacs_value _repo, emacs_value _path
     return egit_wrap(env, EGIT_BLAME, blame, NULL);
 }
 
+
+// =============================================================================
+// Incremental blame
+
+/**
+ * A commit in the incremental blame walk, with the lines still waiting
+ * to be attributed in its version of the file, which is at PATH.
+ */
+typedef struct {
+    git_oid commit_id;
+    git_commit *commit;
+    char *path;
+    git_oid blob_id;
+    egit_rangebuf ranges;
+    bool queued;
+} blame_origin;
+
+/**
+ * Function called with the RANGES of lines that the walk attributes to ORIGIN.
+ * RANGES may be reordered.  A non-zero return value stops the walk.
+ */
+typedef int (*blame_emit_fn)(blame_origin *origin, egit_rangebuf *ranges, void *payload);
+
+typedef struct {
+    blame_emit_fn emit;
+    void *payload;
+    git_repository *repo;
+    const char *path;
+    const git_blame_options *opts;
+    egit_oidmap origins;
+    blame_origin **queue;
+    size_t queue_size;
+    size_t queue_alloc;
+} blame_engine;
+
+/**
+ * Find the blob at PATH in COMMIT.  Sets FOUND to false, without error,
+ * if there is no such blob.
+ */
+static int commit_blob_id(git_oid *out, bool *found, const git_commit *commit, const char *path)
+{
+    git_tree *tree;
+    int retval = git_commit_tree(&tree, commit);
+    if (retval)
+        return retval;
+
+    git_tree_entry *entry;
+    retval = git_tree_entry_bypath(&entry, tree, path);
+    git_tree_free(tree);
+    if (retval == GIT_ENOTFOUND) {
+        giterr_clear();
+        *found = false;
+        return 0;
+    }
+    if (retval)
+        return retval;
+
+    *found = git_tree_entry_type(entry) == GIT_OBJ_BLOB;
+    if (*found)
+        git_oid_cpy(out, git_tree_entry_id(entry));
+    git_tree_entry_free(entry);
+    return 0;
+}
+
+/**
+ * Follow a rename of PATH between OLD-TREE and NEW-TREE.  If FORWARD is
+ * true, PATH is in OLD-TREE and OUT is set to its path in NEW-TREE,
+ * otherwise the other way around.  OUT is set to NULL if there is no
+ * such rename, and must be freed otherwise.
+ */
+static int renamed_path(char **out, git_repository *repo, git_tree *old_tree, git_tree *new_tree,
+                        const char *path, bool forward)
+{
+    git_diff *diff = NULL;
+    git_diff_options diff_opts;
+    git_diff_find_options find_opts;
+    *out = NULL;
+
+    int retval;
+    if ((retval = git_diff_init_options(&diff_opts, GIT_DIFF_OPTIONS_VERSION)) ||
+        (retval = git_diff_tree_to_tree(&diff, repo, old_tree, new_tree, &diff_opts)) ||
+        (retval = git_diff_find_init_options(&find_opts, GIT_DIFF_FIND_OPTIONS_VERSION)))
+        goto cleanup;
+    find_opts.flags = GIT_DIFF_FIND_RENAMES;
+    if ((retval = egit_diff_find_similar_cached(diff, &find_opts)))
+        goto cleanup;
+
+    size_t ndeltas = git_diff_num_deltas(diff);
+    for (size_t i = 0; i < ndeltas; i++) {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        const git_diff_file *from = forward ? &delta->old_file : &delta->new_file;
+        const git_diff_file *to = forward ? &delta->new_file : &delta->old_file;
+        if (delta->status != GIT_DELTA_RENAMED || strcmp(from->path, path))
+            continue;
+
+        *out = strdup(to->path);
+        if (!*out) {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+        }
+        break;
+    }
+
+cleanup:
+    git_diff_free(diff);
+    return retval;
+}
+
+/**
+ * Find the blob in PARENT that the file of ORIGIN was renamed from.  Sets
+ * PATH to its path, or to NULL if there is no such blob.
+ */
+static int parent_renamed_blob(char **path, git_oid *blob_id, git_repository *repo,
+                               const blame_origin *origin, const git_commit *parent)
+{
+    git_tree *tree = NULL, *parent_tree = NULL;
+    bool found = false;
+
+    int retval;
+    if ((retval = git_commit_tree(&tree, origin->commit)) ||
+        (retval = git_commit_tree(&parent_tree, parent)) ||
+        (retval = renamed_path(path, repo, parent_tree, tree, origin->path, false)))
+        goto cleanup;
+    if (*path)
+        retval = commit_blob_id(blob_id, &found, parent, *path);
+
+cleanup:
+    if (retval || !found) {
+        free(*path);
+        *path = NULL;
+    }
+    git_tree_free(tree);
+    git_tree_free(parent_tree);
+    return retval;
+}
+
+/**
+ * Hand RANGES over to the commit COMMIT-ID, where the file is BLOB-ID at
+ * PATH, and make sure that commit is queued.
+ */
+static int blame_engine_pass(blame_engine *engine, const git_oid *commit_id,
+                             const git_oid *blob_id, const char *path,
+                             const egit_rangebuf *ranges)
+{
+    if (ranges->size == 0)
+        return 0;
+
+    bool existed;
+    void **slot = egit_oidmap_put(&engine->origins, commit_id, &existed);
+    if (!slot)
+        return GIT_ERROR;
+
+    blame_origin *origin = (blame_origin*) *slot;
+    if (!existed) {
+        origin = (blame_origin*) calloc(1, sizeof(blame_origin));
+        if (!origin) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        *slot = origin;
+        git_oid_cpy(&origin->commit_id, commit_id);
+        git_oid_cpy(&origin->blob_id, blob_id);
+        origin->path = strdup(path);
+        if (!origin->path) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        int retval = git_commit_lookup(&origin->commit, engine->repo, commit_id);
+        if (retval)
+            return retval;
+    }
+
+    for (size_t i = 0; i < ranges->size; i++) {
+        const egit_line_range *r = &ranges->ptr[i];
+        if (!egit_rangebuf_push(&origin->ranges, r->final_start, r->start, r->lines))
+            return GIT_ERROR;
+    }
+
+    if (!origin->queued) {
+        if (engine->queue_size == engine->queue_alloc) {
+            size_t alloc = engine->queue_alloc ? 2 * engine->queue_alloc : 16;
+            blame_origin **queue = (blame_origin**) realloc(engine->queue, alloc * sizeof(blame_origin*));
+            if (!queue) {
+                giterr_set_oom();
+                return GIT_ERROR;
+            }
+            engine->queue = queue;
+            engine->queue_alloc = alloc;
+        }
+        engine->queue[engine->queue_size++] = origin;
+        origin->queued = true;
+    }
+
+    return 0;
+}
+
+/**
+ * Remove and return the most recent commit in the queue.
+ */
+static blame_origin *blame_engine_pop(blame_engine *engine)
+{
+    if (engine->queue_size == 0)
+        return NULL;
+
+    size_t best = 0;
+    git_time_t best_time = git_commit_time(engine->queue[0]->commit);
+    for (size_t i = 1; i < engine->queue_size; i++) {
+        git_time_t time = git_commit_time(engine->queue[i]->commit);
+        if (time > best_time) {
+            best = i;
+            best_time = time;
+        }
+    }
+
+    blame_origin *origin = engine->queue[best];
+    engine->queue[best] = engine->queue[--engine->queue_size];
+    origin->queued = false;
+    return origin;
+}
+
+static int compare_final_start(const void *a, const void *b)
+{
+    const egit_line_range *ra = (const egit_line_range*) a;
+    const egit_line_range *rb = (const egit_line_range*) b;
+    return ra->final_start < rb->final_start ? -1 : ra->final_start > rb->final_start;
+}
+
+/**
+ * Report RANGES as attributed to ORIGIN by calling an Emacs function.
+ */
+static int incremental_emit(blame_origin *origin, egit_rangebuf *ranges, void *payload)
+{
+    egit_generic_payload *ctx = (egit_generic_payload*) payload;
+    emacs_env *env = ctx->env;
+
+    qsort(ranges->ptr, ranges->size, sizeof(egit_line_range), compare_final_start);
+
+    egit_intbuf hunks = {0};
+    for (size_t i = 0; i < ranges->size; i++) {
+        const egit_line_range *r = &ranges->ptr[i];
+        if (!egit_intbuf_push(&hunks, r->final_start) || !egit_intbuf_push(&hunks, r->lines) ||
+            !egit_intbuf_push(&hunks, r->start)) {
+            egit_intbuf_dispose(&hunks);
+            return GIT_ERROR;
+        }
+    }
+
+    emacs_value args[2];
+    args[0] = EM_STRING(git_oid_tostr_s(&origin->commit_id));
+    args[1] = em_integer_vector(env, hunks.ptr, hunks.size);
+    egit_intbuf_dispose(&hunks);
+    EM_RETURN_IF_NLE(GIT_EUSER);
+
+    emacs_value retval = env->funcall(env, ctx->func, 2, args);
+    EM_RETURN_IF_NLE(GIT_EUSER);
+    if (EM_EQ(retval, esym_abort))
+        return GIT_EUSER;
+    return 0;
+}
+
+#define PARENT_PATH(i) (parent_paths[i] ? parent_paths[i] : origin->path)
+
+/**
+ * Pass the pending lines of ORIGIN on to its parents, and report the
+ * lines that none of them can take.  A parent that does not have the
+ * file is checked for a rename, as `git blame' does.
+ */
+static int blame_engine_step(blame_engine *engine, blame_origin *origin)
+{
+    int retval = 0;
+    egit_rangebuf pending = origin->ranges, carried = {0}, changed = {0};
+    egit_intbuf hunks = {0};
+    git_blob *blob = NULL, *parent_blob = NULL;
+    memset(&origin->ranges, 0, sizeof(egit_rangebuf));
+    egit_rangebuf_sort(&pending);
+
+    unsigned int nparents = git_commit_parentcount(origin->commit);
+    if (nparents > 1 && (engine->opts->flags & GIT_BLAME_FIRST_PARENT))
+        nparents = 1;
+    if (git_oid_equal(&origin->commit_id, &engine->opts->oldest_commit))
+        nparents = 0;
+
+    // Parents that have the file under another name get it in PARENT-PATHS
+    git_oid *parent_blobs = NULL;
+    bool *parent_found = NULL;
+    char **parent_paths = NULL;
+    if (nparents > 0) {
+        parent_blobs = (git_oid*) malloc(nparents * sizeof(git_oid));
+        parent_found = (bool*) malloc(nparents * sizeof(bool));
+        parent_paths = (char**) calloc(nparents, sizeof(char*));
+        if (!parent_blobs || !parent_found || !parent_paths) {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+            goto cleanup;
+        }
+    }
+
+    // If some parent has the same file, it takes every line
+    for (unsigned int i = 0; i < nparents; i++) {
+        git_commit *parent;
+        retval = git_commit_parent(&parent, origin->commit, i);
+        if (retval)
+            goto cleanup;
+        retval = commit_blob_id(&parent_blobs[i], &parent_found[i], parent, origin->path);
+        if (!retval && !parent_found[i]) {
+            retval = parent_renamed_blob(&parent_paths[i], &parent_blobs[i], engine->repo,
+                                         origin, parent);
+            parent_found[i] = parent_paths[i] != NULL;
+        }
+        git_commit_free(parent);
+        if (retval)
+            goto cleanup;
+
+        if (parent_found[i] && git_oid_equal(&parent_blobs[i], &origin->blob_id)) {
+            retval = blame_engine_pass(engine, git_commit_parent_id(origin->commit, i),
+                                       &parent_blobs[i], PARENT_PATH(i), &pending);
+            pending.size = 0;
+            goto cleanup;
+        }
+    }
+
+    // Otherwise, every parent in turn takes the lines it shares with us
+    for (unsigned int i = 0; i < nparents && pending.size > 0; i++) {
+        if (!parent_found[i])
+            continue;
+
+        if (!blob) {
+            retval = git_blob_lookup(&blob, engine->repo, &origin->blob_id);
+            if (retval)
+                goto cleanup;
+        }
+        retval = git_blob_lookup(&parent_blob, engine->repo, &parent_blobs[i]);
+        if (retval)
+            goto cleanup;
+
+        hunks.size = carried.size = changed.size = 0;
+        retval = egit_diff_blob_hunks(&hunks, parent_blob, blob);
+        git_blob_free(parent_blob);
+        parent_blob = NULL;
+        if (retval)
+            goto cleanup;
+
+        if (!egit_line_ranges_map(&pending, &hunks, &carried, &changed)) {
+            retval = GIT_ERROR;
+            goto cleanup;
+        }
+
+        retval = blame_engine_pass(engine, git_commit_parent_id(origin->commit, i),
+                                   &parent_blobs[i], PARENT_PATH(i), &carried);
+        if (retval)
+            goto cleanup;
+
+        egit_rangebuf tmp = pending;
+        pending = changed;
+        changed = tmp;
+    }
+
+    // What is left was introduced here
+    if (pending.size > 0)
+        retval = engine->emit(origin, &pending, engine->payload);
+
+cleanup:
+    for (unsigned int i = 0; parent_paths && i < nparents; i++)
+        free(parent_paths[i]);
+    free(parent_paths);
+    free(parent_blobs);
+    free(parent_found);
+    git_blob_free(blob);
+    egit_intbuf_dispose(&hunks);
+    egit_rangebuf_dispose(&pending);
+    egit_rangebuf_dispose(&carried);
+    egit_rangebuf_dispose(&changed);
+    return retval;
+}
+
+#undef PARENT_PATH
+
+static void blame_engine_dispose(blame_engine *engine)
+{
+    for (size_t i = 0; i < engine->origins.alloc; i++) {
+        if (!engine->origins.used[i])
+            continue;
+        blame_origin *origin = (blame_origin*) engine->origins.values[i];
+        if (!origin)
+            continue;
+        git_commit_free(origin->commit);
+        egit_rangebuf_dispose(&origin->ranges);
+        free(origin->path);
+        free(origin);
+    }
+    egit_oidmap_dispose(&engine->origins);
+    free(engine->queue);
+}
+
+/**
+ * Find the blob at PATH in the commit COMMIT-ID and count its lines.
+ */
+static int file_blob(git_oid *blob_id, size_t *nlines, git_repository *repo,
+                     const git_oid *commit_id, const char *path)
+{
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, repo, commit_id);
+    if (retval)
+        return retval;
+
+    git_tree *tree;
+    git_tree_entry *entry;
+    retval = git_commit_tree(&tree, commit);
+    git_commit_free(commit);
+    if (retval)
+        return retval;
+    retval = git_tree_entry_bypath(&entry, tree, path);
+    git_tree_free(tree);
+    if (retval)
+        return retval;
+
+    git_blob *blob;
+    git_oid_cpy(blob_id, git_tree_entry_id(entry));
+    git_tree_entry_free(entry);
+    retval = git_blob_lookup(&blob, repo, blob_id);
+    if (retval)
+        return retval;
+
+    *nlines = egit_count_lines(git_blob_rawcontent(blob), git_blob_rawsize(blob));
+    git_blob_free(blob);
+    return 0;
+}
+
+/**
+ * Attribute RANGES of the file as found in COMMIT-ID, where it is BLOB-ID.
+ */
+static int blame_engine_run(blame_engine *engine, const git_oid *commit_id,
+                            const git_oid *blob_id, const egit_rangebuf *ranges)
+{
+    int retval = blame_engine_pass(engine, commit_id, blob_id, engine->path, ranges);
+
+    blame_origin *origin;
+    while (!retval && (origin = blame_engine_pop(engine)))
+        retval = blame_engine_step(engine, origin);
+
+    return retval;
+}
+
+EGIT_DOC(blame_incremental, "REPOSITORY PATH FUNC &optional OPTIONS",
+         "Blame the file PATH, calling FUNC as soon as lines are attributed.\n"
+         "FUNC is called with a commit ID and a vector\n"
+         "[FINAL-START LINES ORIG-START ...] of the hunks attributed to that commit.\n"
+         "Commits are visited newest first, so recent changes are reported before\n"
+         "the rest of the history is walked.  A commit may be reported more than once.\n"
+         "If FUNC returns `abort', the walk stops early.\n\n"
+         "OPTIONS is an alist as for `libgit-blame-file', with the keys\n"
+         "`first-parent', `newest-commit', `oldest-commit', `min-line' and\n"
+         "`max-line'.  Options that track copied or moved lines are not supported\n"
+         "and signal an error.  Lines are passed to the parents of a merge in\n"
+         "order, each taking the lines it has unchanged.\n"
+         "If a parent does not have the file, it is looked for under the name it\n"
+         "was renamed from.\n\n"
+         "Return t if every line was attributed, or nil if FUNC stopped the walk.");
+emacs_value egit_blame_incremental(emacs_env *env, emacs_value _repo, emacs_value _path,
+                                   emacs_value func, emacs_value options)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_path);
+    EM_ASSERT_FUNCTION(func);
+
+    git_blame_options opts;
+    extract_options(env, options, &opts);
+    EM_RETURN_NIL_IF_NLE();
+
+    // The walk below only knows how to follow lines within one file
+    if (opts.flags & ~GIT_BLAME_FIRST_PARENT) {
+        em_signal_wrong_value(env, options);
+        return esym_nil;
+    }
+
+    git_repository *repo = EGIT_EXTRACT(_repo);
+    git_oid newest;
+    int retval;
+    if (git_oid_iszero(&opts.newest_commit))
+        retval = git_reference_name_to_id(&newest, repo, "HEAD");
+    else {
+        git_oid_cpy(&newest, &opts.newest_commit);
+        retval = 0;
+    }
+    EGIT_CHECK_ERROR(retval);
+
+    char *path = EM_EXTRACT_STRING(_path);
+
+    git_oid blob_id;
+    size_t nlines;
+    retval = file_blob(&blob_id, &nlines, repo, &newest, path);
+    if (retval) {
+        free(path);
+        EGIT_CHECK_ERROR(retval);
+    }
+
+    size_t min_line = opts.min_line > 0 ? opts.min_line : 1;
+    size_t max_line = opts.max_line > 0 && opts.max_line < nlines ? opts.max_line : nlines;
+    egit_rangebuf initial = {0};
+    if (min_line <= max_line && !egit_rangebuf_push(&initial, min_line, min_line, max_line - min_line + 1)) {
+        free(path);
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+
+    egit_generic_payload ctx = {env, func, NULL};
+    blame_engine engine;
+    memset(&engine, 0, sizeof(blame_engine));
+    engine.emit = incremental_emit;
+    engine.payload = &ctx;
+    engine.repo = repo;
+    engine.path = path;
+    engine.opts = &opts;
+
+    retval = blame_engine_run(&engine, &newest, &blob_id, &initial);
+    blame_engine_dispose(&engine);
+    egit_rangebuf_dispose(&initial);
+    free(path);
+
+    EM_RETURN_NIL_IF_NLE();
+    if (retval == GIT_EUSER)
+        return esym_nil;
+    EGIT_CHECK_ERROR(retval);
+
+    return esym_t;
+}
+
+
+// =============================================================================
+// Blame sessions
+
+/**
+ * Blame of a file at one revision, kept so that moving to an adjacent
+ * revision only needs to attribute the lines the step touches.
+ */
+struct egit_blame_session {
+    git_repository *repo;
+    char *path;
+    git_oid commit_id;
+    git_oid blob_id;
+    size_t nlines;
+    git_oid *lines;
+
+    // Name of the file in each commit of LINES, owned by the session
+    egit_oidmap paths;
+};
+
+static void session_paths_dispose(egit_oidmap *paths)
+{
+    for (size_t i = 0; i < paths->alloc; i++)
+        if (paths->used[i])
+            free(paths->values[i]);
+    egit_oidmap_dispose(paths);
+}
+
+void egit_blame_session_free(egit_blame_session *session)
+{
+    if (!session)
+        return;
+    free(session->path);
+    free(session->lines);
+    session_paths_dispose(&session->paths);
+    free(session);
+}
+
+/**
+ * Record PATH as the name of the file in COMMIT-ID, unless it has one.
+ */
+static bool session_note_path(egit_oidmap *paths, const git_oid *commit_id, const char *path)
+{
+    bool existed;
+    void **slot = egit_oidmap_put(paths, commit_id, &existed);
+    if (!slot)
+        return false;
+    if (!existed && !(*slot = strdup(path))) {
+        giterr_set_oom();
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    git_oid *lines;
+    egit_oidmap *paths;
+} session_emit_ctx;
+
+static int session_emit(blame_origin *origin, egit_rangebuf *ranges, void *payload)
+{
+    session_emit_ctx *ctx = (session_emit_ctx*) payload;
+    for (size_t i = 0; i < ranges->size; i++) {
+        const egit_line_range *r = &ranges->ptr[i];
+        for (size_t j = 0; j < r->lines; j++)
+            git_oid_cpy(&ctx->lines[r->final_start - 1 + j], &origin->commit_id);
+    }
+    if (ranges->size > 0 && !session_note_path(ctx->paths, &origin->commit_id, origin->path))
+        return GIT_ERROR;
+    return 0;
+}
+
+/**
+ * Attribute RANGES of the file at PATH in COMMIT-ID to their commits, writing
+ * into LINES, and note the name of the file in those commits in PATHS.
+ */
+static int session_blame_ranges(egit_blame_session *session, git_oid *lines, egit_oidmap *paths,
+                                const git_oid *commit_id, const git_oid *blob_id, const char *path,
+                                const egit_rangebuf *ranges)
+{
+    git_blame_options opts;
+    int retval = git_blame_init_options(&opts, GIT_BLAME_OPTIONS_VERSION);
+    if (retval)
+        return retval;
+
+    blame_engine engine;
+    memset(&engine, 0, sizeof(blame_engine));
+    session_emit_ctx ctx = {lines, paths};
+    engine.emit = session_emit;
+    engine.payload = &ctx;
+    engine.repo = session->repo;
+    engine.path = path;
+    engine.opts = &opts;
+
+    retval = blame_engine_run(&engine, commit_id, blob_id, ranges);
+    blame_engine_dispose(&engine);
+    return retval;
+}
+
+/**
+ * Whether CHILD has PARENT as its only parent.
+ */
+static int only_parent(bool *out, git_repository *repo, const git_oid *child, const git_oid *parent)
+{
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, repo, child);
+    if (retval)
+        return retval;
+    *out = git_commit_parentcount(commit) == 1 && git_oid_equal(git_commit_parent_id(commit, 0), parent);
+    git_commit_free(commit);
+    return 0;
+}
+
+/**
+ * Find the name of the file of SESSION in its CHILD or parent COMMIT-ID,
+ * if it was renamed between them.  Sets OUT to NULL otherwise.
+ */
+static int session_renamed_path(char **out, egit_blame_session *session,
+                                const git_oid *commit_id, bool child)
+{
+    git_commit *current = NULL, *other = NULL;
+    git_tree *current_tree = NULL, *other_tree = NULL;
+    *out = NULL;
+
+    int retval;
+    if ((retval = git_commit_lookup(&current, session->repo, &session->commit_id)) ||
+        (retval = git_commit_lookup(&other, session->repo, commit_id)) ||
+        (retval = git_commit_tree(&current_tree, current)) ||
+        (retval = git_commit_tree(&other_tree, other)))
+        goto cleanup;
+
+    if (child)
+        retval = renamed_path(out, session->repo, current_tree, other_tree, session->path, true);
+    else
+        retval = renamed_path(out, session->repo, other_tree, current_tree, session->path, false);
+
+cleanup:
+    git_tree_free(current_tree);
+    git_tree_free(other_tree);
+    git_commit_free(current);
+    git_commit_free(other);
+    return retval;
+}
+
+/**
+ * Move SESSION to the commit COMMIT-ID.  Sets RECOMPUTED to the number of
+ * lines whose attribution could not be carried over.  On error, SESSION
+ * is unchanged.
+ */
+static int session_move(egit_blame_session *session, const git_oid *commit_id, size_t *recomputed)
+{
+    // Moving to a child is exact if it has one parent: what it changed is
+    // attributed to it, and the rest keeps its attribution.  Moving to the
+    // only parent of the current commit is the same, except that the lines
+    // the current commit introduced must be blamed afresh.
+    bool child = false, parent = false;
+    int retval = 0;
+    if (session->lines) {
+        retval = only_parent(&child, session->repo, commit_id, &session->commit_id);
+        if (!retval && !child)
+            retval = only_parent(&parent, session->repo, &session->commit_id, commit_id);
+        if (retval)
+            return retval;
+    }
+
+    // Between a commit and its parent, the file may have been renamed
+    char *renamed = NULL;
+    git_oid blob_id;
+    size_t nlines;
+    retval = file_blob(&blob_id, &nlines, session->repo, commit_id, session->path);
+    if (retval == GIT_ENOTFOUND && (child || parent)) {
+        int error = session_renamed_path(&renamed, session, commit_id, child);
+        if (error)
+            retval = error;
+        else if (renamed)
+            retval = file_blob(&blob_id, &nlines, session->repo, commit_id, renamed);
+    }
+    if (retval) {
+        free(renamed);
+        return retval;
+    }
+    const char *path = renamed ? renamed : session->path;
+
+    git_oid *lines = (git_oid*) calloc(nlines + 1, sizeof(git_oid));
+    if (!lines) {
+        free(renamed);
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    egit_rangebuf all = {0}, carried = {0}, changed = {0};
+    egit_intbuf hunks = {0};
+    egit_oidmap paths = {0};
+    git_blob *old_blob = NULL, *new_blob = NULL;
+
+    if (nlines > 0 && !egit_rangebuf_push(&all, 1, 1, nlines)) {
+        retval = GIT_ERROR;
+        goto cleanup;
+    }
+
+    if (!child && !parent) {
+        *recomputed = nlines;
+        retval = session_blame_ranges(session, lines, &paths, commit_id, &blob_id, path, &all);
+        goto cleanup;
+    }
+
+    if ((retval = git_blob_lookup(&old_blob, session->repo, &session->blob_id)) ||
+        (retval = git_blob_lookup(&new_blob, session->repo, &blob_id)) ||
+        (retval = egit_diff_blob_hunks(&hunks, old_blob, new_blob)))
+        goto cleanup;
+
+    if (!egit_line_ranges_map(&all, &hunks, &carried, &changed)) {
+        retval = GIT_ERROR;
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < carried.size; i++) {
+        const egit_line_range *r = &carried.ptr[i];
+        memcpy(&lines[r->final_start - 1], &session->lines[r->start - 1], r->lines * sizeof(git_oid));
+    }
+
+    *recomputed = 0;
+    for (size_t i = 0; i < changed.size; i++)
+        *recomputed += changed.ptr[i].lines;
+
+    if (child) {
+        for (size_t i = 0; i < changed.size; i++) {
+            const egit_line_range *r = &changed.ptr[i];
+            for (size_t j = 0; j < r->lines; j++)
+                git_oid_cpy(&lines[r->final_start - 1 + j], commit_id);
+        }
+        if (changed.size > 0 && !session_note_path(&paths, commit_id, path))
+            retval = GIT_ERROR;
+    }
+    else
+        retval = session_blame_ranges(session, lines, &paths, commit_id, &blob_id, path, &changed);
+
+    // Carried lines keep the names their commits had
+    for (size_t i = 0; i < carried.size && !retval; i++) {
+        const egit_line_range *r = &carried.ptr[i];
+        const git_oid *id = &lines[r->final_start - 1];
+        for (size_t j = 0; j < r->lines && !retval; j++, id++) {
+            const char *name = (const char*) egit_oidmap_get(&session->paths, id);
+            if (!session_note_path(&paths, id, name ? name : session->path))
+                retval = GIT_ERROR;
+        }
+    }
+
+cleanup:
+    git_blob_free(old_blob);
+    git_blob_free(new_blob);
+    egit_intbuf_dispose(&hunks);
+    egit_rangebuf_dispose(&all);
+    egit_rangebuf_dispose(&carried);
+    egit_rangebuf_dispose(&changed);
+
+    if (retval) {
+        free(renamed);
+        free(lines);
+        session_paths_dispose(&paths);
+        return retval;
+    }
+
+    if (renamed) {
+        free(session->path);
+        session->path = renamed;
+    }
+    free(session->lines);
+    session->lines = lines;
+    session->nlines = nlines;
+    session_paths_dispose(&session->paths);
+    session->paths = paths;
+    git_oid_cpy(&session->commit_id, commit_id);
+    git_oid_cpy(&session->blob_id, &blob_id);
+    return 0;
+}
+
+/**
+ * Extract a commit ID from REVISION, or resolve HEAD if it is nil.
+ */
+static bool extract_revision(emacs_env *env, git_oid *out, git_repository *repo, emacs_value revision)
+{
+    if (!EM_EXTRACT_BOOLEAN(revision)) {
+        int retval = git_reference_name_to_id(out, repo, "HEAD");
+        return !egit_dispatch_error(env, retval);
+    }
+    if (!em_assert(env, esym_stringp, revision))
+        return false;
+    char *str = EM_EXTRACT_STRING(revision);
+    int retval = git_oid_fromstr(out, str);
+    free(str);
+    return !egit_dispatch_error(env, retval);
+}
+
+EGIT_DOC(blame_session_new, "REPOSITORY PATH &optional REVISION",
+         "Return a blame session for the file PATH at the commit REVISION.\n"
+         "REVISION is a commit ID, and defaults to HEAD.  The session can be moved\n"
+         "to other revisions with `libgit-blame-session-move', which reuses the\n"
+         "current attribution when the step is between a commit and its parent.\n"
+         "Such a step follows the file if it was renamed.");
+emacs_value egit_blame_session_new(emacs_env *env, emacs_value _repo, emacs_value _path,
+                                   emacs_value revision)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_path);
+
+    git_repository *repo = EGIT_EXTRACT(_repo);
+    git_oid commit_id;
+    if (!extract_revision(env, &commit_id, repo, revision))
+        return esym_nil;
+
+    egit_blame_session *session = (egit_blame_session*) calloc(1, sizeof(egit_blame_session));
+    if (!session) {
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+    session->repo = repo;
+    session->path = EM_EXTRACT_STRING(_path);
+
+    size_t recomputed;
+    int retval = session_move(session, &commit_id, &recomputed);
+    if (retval)
+        egit_blame_session_free(session);
+    EGIT_CHECK_ERROR(retval);
+
+    return egit_wrap(env, EGIT_BLAME_SESSION, session, EM_EXTRACT_USER_PTR(_repo));
+}
+
+EGIT_DOC(blame_session_move, "SESSION REVISION",
+         "Move the blame SESSION to the commit REVISION.\n"
+         "If REVISION is a child of the current revision, or its parent, and the\n"
+         "child has no other parent, only the lines changed between them are\n"
+         "attributed again.  Otherwise the file is blamed from scratch.\n"
+         "Return the number of lines that were attributed again.");
+emacs_value egit_blame_session_move(emacs_env *env, emacs_value _session, emacs_value revision)
+{
+    EGIT_ASSERT_BLAME_SESSION(_session);
+    EM_ASSERT_STRING(revision);
+    egit_blame_session *session = EGIT_EXTRACT(_session);
+
+    git_oid commit_id;
+    if (!extract_revision(env, &commit_id, session->repo, revision))
+        return esym_nil;
+
+    if (git_oid_equal(&commit_id, &session->commit_id))
+        return EM_INTEGER(0);
+
+    size_t recomputed;
+    int retval = session_move(session, &commit_id, &recomputed);
+    EGIT_CHECK_ERROR(retval);
+
+    return EM_INTEGER(recomputed);
+}
+
+EGIT_DOC(blame_session_revision, "SESSION", "Return the commit ID that SESSION blames.");
+emacs_value egit_blame_session_revision(emacs_env *env, emacs_value _session)
+{
+    EGIT_ASSERT_BLAME_SESSION(_session);
+    egit_blame_session *session = EGIT_EXTRACT(_session);
+    return EM_STRING(git_oid_tostr_s(&session->commit_id));
+}
+
+EGIT_DOC(blame_session_to_vectors, "SESSION",
+         "Return the attribution of every line in SESSION as flat vectors.\n"
+         "The value has the same form as for `libgit-blame-to-vectors'.  The\n"
+         "path of each commit is the name of the file in that commit, which\n"
+         "differs from the current one for commits before a rename.");
+emacs_value egit_blame_session_to_vectors(emacs_env *env, emacs_value _session)
+{
+    EGIT_ASSERT_BLAME_SESSION(_session);
+    egit_blame_session *session = EGIT_EXTRACT(_session);
+
+    egit_oidmap seen = {0};
+    egit_intbuf indices = {0};
+    emacs_value *commits = NULL;
+    size_t ncommits = 0, commits_alloc = 0;
+    int retval = 0;
+
+    for (size_t i = 0; i < session->nlines && !retval; i++) {
+        bool existed;
+        void **slot = egit_oidmap_put(&seen, &session->lines[i], &existed);
+        if (!slot) {
+            retval = GIT_ERROR;
+            break;
+        }
+
+        if (!existed) {
+            git_commit *commit;
+            retval = git_commit_lookup(&commit, session->repo, &session->lines[i]);
+            if (retval)
+                break;
+
+            if (ncommits == commits_alloc) {
+                commits_alloc = commits_alloc ? 2 * commits_alloc : 16;
+                emacs_value *grown = (emacs_value*) realloc(commits, commits_alloc * sizeof(emacs_value));
+                if (!grown) {
+                    git_commit_free(commit);
+                    giterr_set_oom();
+                    retval = GIT_ERROR;
+                    break;
+                }
+                commits = grown;
+            }
+
+            const git_signature *sig = git_commit_author(commit);
+            emacs_value fields[5];
+            fields[0] = EM_STRING(git_oid_tostr_s(&session->lines[i]));
+            fields[1] = EM_STRING(sig->name);
+            fields[2] = EM_STRING(sig->email);
+            fields[3] = EM_INTEGER(sig->when.time);
+            const char *path = (const char*) egit_oidmap_get(&session->paths, &session->lines[i]);
+            fields[4] = EM_STRING(path ? path : session->path);
+            git_commit_free(commit);
+
+            *slot = (void*) (uintptr_t) ncommits;
+            commits[ncommits++] = em_vector(env, fields, 5);
+        }
+
+        if (!egit_intbuf_push(&indices, (uintptr_t) *slot))
+            retval = GIT_ERROR;
+    }
+    egit_oidmap_dispose(&seen);
+
+    emacs_value ret = esym_nil;
+    if (!retval)
+        ret = em_cons(env, em_vector(env, commits, ncommits),
+                      em_integer_vector(env, indices.ptr, indices.size));
+    free(commits);
+    egit_intbuf_dispose(&indices);
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+EGIT_DOC(blame_buffer, "REFERENCE STRING-OR-BUFFER",
+         "Return the BLAME object for an edited version of a blamed file.\n"
+         "REFERENCE is a BLAME for the file as committed, and STRING-OR-BUFFER\n"
+         "holds the edited contents.  If it is a buffer, its accessible portion\n"
+         "is used.  Only the changes relative to REFERENCE are examined, so this\n"
+         "is much cheaper than blaming the file again.  The text is compared\n"
+         "to the blob of REFERENCE as UTF-8, without any filters or conversion\n"
+         "of line endings.\n\n"
+         "Lines that are not committed yet belong to hunks whose commit ID is\n"
+         "all zeros, and whose signature is nil.");
+emacs_value egit_blame_buffer(emacs_env *env, emacs_value _reference, emacs_value text)
+{
+    EGIT_ASSERT_BLAME(_reference);
+    git_blame *reference = EGIT_EXTRACT(_reference);
+
+    ptrdiff_t size;
+    char *buffer = em_get_text_with_size(env, text, &size, false);
+    if (!buffer)
+        return esym_nil;
+
+    git_blame *blame = NULL;
+    int retval = git_blame_buffer(&blame, reference, buffer, size);
+    free(buffer);
+    EGIT_CHECK_ERROR(retval);
+
+    return egit_wrap(env, EGIT_BLAME, blame, EM_EXTRACT_USER_PTR(_reference));
+}
+
 EGIT_DOC(blame_get_hunk_byindex, "BLAME N", "Return the Nth hunk of BLAME.");
 emacs_value egit_blame_get_hunk_byindex(emacs_env *env, emacs_value _blame, emacs_value _index)
 {
@@ -136,6 +1127,351 @@ emacs_value egit_blame_get_hunk_count(emacs_env *env, emacs_value _blame)
     return EM_INTEGER(count);
 }
 
+/**
+ * Convert blame HUNKS to a cons of a commit vector and a line index vector.
+ */
+static emacs_value blame_to_vectors(emacs_env *env, const git_blame_hunk *const *hunks, size_t nhunks)
+{
+    size_t nlines = 0;
+    for (size_t i = 0; i < nhunks; i++) {
+        const git_blame_hunk *hunk = hunks[i];
+        size_t end = hunk->final_start_line_number + hunk->lines_in_hunk - 1;
+        if (end > nlines)
+            nlines = end;
+    }
+
+    egit_oidmap seen = {0};
+    emacs_value *commits = (emacs_value*) malloc((nhunks + 1) * sizeof(emacs_value));
+    emacs_value *lines = (emacs_value*) malloc((nlines + 1) * sizeof(emacs_value));
+    if (!commits || !lines) {
+        free(commits);
+        free(lines);
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+    for (size_t i = 0; i < nlines; i++)
+        lines[i] = esym_nil;
+
+    size_t ncommits = 0;
+    for (size_t i = 0; i < nhunks; i++) {
+        const git_blame_hunk *hunk = hunks[i];
+
+        bool existed;
+        void **slot = egit_oidmap_put(&seen, &hunk->final_commit_id, &existed);
+        if (!slot) {
+            egit_oidmap_dispose(&seen);
+            free(commits);
+            free(lines);
+            EGIT_CHECK_ERROR(GIT_ERROR);
+        }
+
+        if (!existed) {
+            const git_signature *sig = hunk->final_signature;
+            *slot = (void*) (uintptr_t) ncommits;
+            emacs_value fields[5];
+            fields[0] = EM_STRING(git_oid_tostr_s(&hunk->final_commit_id));
+            fields[1] = sig ? EM_STRING(sig->name) : esym_nil;
+            fields[2] = sig ? EM_STRING(sig->email) : esym_nil;
+            fields[3] = sig ? EM_INTEGER(sig->when.time) : esym_nil;
+            fields[4] = hunk->orig_path ? EM_STRING(hunk->orig_path) : esym_nil;
+            commits[ncommits++] = em_vector(env, fields, 5);
+        }
+
+        emacs_value index = EM_INTEGER((uintptr_t) *slot);
+        for (size_t j = 0; j < hunk->lines_in_hunk; j++)
+            lines[hunk->final_start_line_number - 1 + j] = index;
+    }
+    egit_oidmap_dispose(&seen);
+
+    emacs_value ret = em_cons(env, em_vector(env, commits, ncommits), em_vector(env, lines, nlines));
+    free(commits);
+    free(lines);
+    return ret;
+}
+
+EGIT_DOC(blame_to_vectors, "BLAME",
+         "Return the attribution of every line in BLAME as flat vectors.\n"
+         "The value is a cons (COMMITS . LINES).  COMMITS is a vector of the\n"
+         "distinct commits in BLAME, each a vector [ID NAME EMAIL TIME PATH]\n"
+         "giving the commit ID, the author name and email, the author time in\n"
+         "seconds since the Unix epoch and the path of the file in that commit.\n"
+         "LINES has one element per line of the file: the index in COMMITS of\n"
+         "the commit that last changed it, or nil if the line was not blamed.\n\n"
+         "For uncommitted lines, the ID is all zeros and the other fields are nil.");
+emacs_value egit_blame_to_vectors(emacs_env *env, emacs_value _blame)
+{
+    EGIT_ASSERT_BLAME(_blame);
+    git_blame *blame = EGIT_EXTRACT(_blame);
+
+    uint32_t nhunks = git_blame_get_hunk_count(blame);
+    const git_blame_hunk **hunks = (const git_blame_hunk**) malloc((nhunks + 1) * sizeof(git_blame_hunk*));
+    if (!hunks) {
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+    for (uint32_t i = 0; i < nhunks; i++)
+        hunks[i] = git_blame_get_hunk_byindex(blame, i);
+
+    emacs_value ret = blame_to_vectors(env, hunks, nhunks);
+    free(hunks);
+    return ret;
+}
+
+
+// =============================================================================
+// Parallel blame
+
+/**
+ * Copy of the hunks of a git_blame that does not depend on the blame or
+ * its repository, so it can outlive a worker thread.
+ */
+typedef struct {
+    git_blame_hunk *hunks;
+    size_t nhunks;
+    bool done;
+} blame_snapshot;
+
+static void blame_snapshot_dispose(blame_snapshot *snapshot)
+{
+    for (size_t i = 0; i < snapshot->nhunks; i++) {
+        git_signature_free(snapshot->hunks[i].final_signature);
+        free((char*) snapshot->hunks[i].orig_path);
+    }
+    free(snapshot->hunks);
+    snapshot->hunks = NULL;
+    snapshot->nhunks = 0;
+    snapshot->done = false;
+}
+
+static int blame_snapshot_take(blame_snapshot *snapshot, git_blame *blame)
+{
+    uint32_t nhunks = git_blame_get_hunk_count(blame);
+    snapshot->hunks = (git_blame_hunk*) calloc(nhunks + 1, sizeof(git_blame_hunk));
+    if (!snapshot->hunks) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    for (uint32_t i = 0; i < nhunks; i++) {
+        git_blame_hunk *hunk = &snapshot->hunks[i];
+        *hunk = *git_blame_get_hunk_byindex(blame, i);
+        hunk->orig_signature = NULL;
+        snapshot->nhunks = i + 1;
+
+        git_signature *sig = hunk->final_signature;
+        hunk->final_signature = NULL;
+        hunk->orig_path = hunk->orig_path ? strdup(hunk->orig_path) : NULL;
+        if (sig && git_signature_dup(&hunk->final_signature, sig)) {
+            blame_snapshot_dispose(snapshot);
+            return GIT_ERROR;
+        }
+    }
+
+    snapshot->done = true;
+    return 0;
+}
+
+typedef struct {
+    const char *repo_path;
+    const git_strarray *paths;
+    git_blame_options *opts;
+    blame_snapshot *results;
+} blame_files_ctx;
+
+// Each worker thread has its own repository handle.
+static void *blame_files_init(void *payload)
+{
+    blame_files_ctx *ctx = (blame_files_ctx*) payload;
+    git_repository *repo;
+    if (git_repository_open(&repo, ctx->repo_path))
+        return NULL;
+    return repo;
+}
+
+static void blame_files_cleanup(void *state, __attribute__((unused)) void *payload)
+{
+    git_repository_free(state);
+}
+
+static int blame_files_one(size_t index, void *state, void *payload)
+{
+    blame_files_ctx *ctx = (blame_files_ctx*) payload;
+    if (!state)
+        return 1;
+
+    // Failed files are blamed again on the main thread, where errors can be signaled
+    git_blame_options opts = *ctx->opts;
+    git_blame *blame;
+    if (git_blame_file(&blame, state, ctx->paths->strings[index], &opts))
+        return 0;
+    blame_snapshot_take(&ctx->results[index], blame);
+    git_blame_free(blame);
+    return 0;
+}
+
+typedef struct {
+    const git_signature *sig;
+    size_t lines;
+} author_lines;
+
+static int compare_author_lines(const void *a, const void *b)
+{
+    const author_lines *aa = (const author_lines*) a;
+    const author_lines *ab = (const author_lines*) b;
+    return aa->lines > ab->lines ? -1 : aa->lines < ab->lines;
+}
+
+/**
+ * Add the lines of SNAPSHOT to the per-author counts in AUTHORS.  INDEX
+ * maps a digest of the email and name of each author to their position
+ * in AUTHORS.
+ */
+static bool count_author_lines(author_lines **authors, size_t *nauthors, size_t *alloc,
+                               egit_oidmap *index, const blame_snapshot *snapshot)
+{
+    for (size_t i = 0; i < snapshot->nhunks; i++) {
+        const git_signature *sig = snapshot->hunks[i].final_signature;
+        if (!sig)
+            continue;
+
+        egit_sha1_ctx ctx;
+        egit_sha1_init(&ctx);
+        egit_sha1_update(&ctx, sig->email, strlen(sig->email) + 1);
+        egit_sha1_update(&ctx, sig->name, strlen(sig->name));
+        git_oid key;
+        egit_sha1_final(key.id, &ctx);
+
+        bool existed;
+        void **slot = egit_oidmap_put(index, &key, &existed);
+        if (!slot)
+            return false;
+        size_t j = (uintptr_t) *slot;
+
+        if (!existed) {
+            if (*nauthors == *alloc) {
+                size_t new_alloc = *alloc ? 2 * *alloc : 16;
+                author_lines *grown = (author_lines*) realloc(*authors, new_alloc * sizeof(author_lines));
+                if (!grown) {
+                    giterr_set_oom();
+                    return false;
+                }
+                *authors = grown;
+                *alloc = new_alloc;
+            }
+            j = (*nauthors)++;
+            *slot = (void*) (uintptr_t) j;
+            (*authors)[j].sig = sig;
+            (*authors)[j].lines = 0;
+        }
+        (*authors)[j].lines += snapshot->hunks[i].lines_in_hunk;
+    }
+    return true;
+}
+
+EGIT_DOC(blame_files, "REPOSITORY PATHS &optional OPTIONS THREADS",
+         "Blame every file in the list PATHS, using up to THREADS threads.\n"
+         "THREADS must be at least 1, and defaults to the number of processors.\n"
+         "Each thread opens its own handle on REPOSITORY.  OPTIONS is an alist\n"
+         "as for `libgit-blame-file'.\n\n"
+         "The value is a cons (FILES . AUTHORS).  FILES has an element\n"
+         "(PATH . VECTORS) for each path, where VECTORS is as returned by\n"
+         "`libgit-blame-to-vectors'.  AUTHORS is a list of elements\n"
+         "(NAME EMAIL . LINES) counting the lines last changed by each author\n"
+         "in all files, with the largest counts first.");
+emacs_value egit_blame_files(emacs_env *env, emacs_value _repo, emacs_value _paths,
+                             emacs_value options, emacs_value threads)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_INTEGER_OR_NIL(threads);
+    intmax_t nthreads = EM_EXTRACT_BOOLEAN(threads) ? EM_EXTRACT_INTEGER(threads)
+        : (intmax_t) egit_parallel_default_threads();
+    if (nthreads < 1) {
+        em_signal_args_out_of_range(env, nthreads);
+        return esym_nil;
+    }
+
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    git_blame_options opts;
+    extract_options(env, options, &opts);
+    EM_RETURN_NIL_IF_NLE();
+
+    git_strarray paths;
+    if (!egit_strarray_from_list(&paths, env, _paths))
+        return esym_nil;
+
+    blame_snapshot *results = (blame_snapshot*) calloc(paths.count + 1, sizeof(blame_snapshot));
+    if (!results) {
+        egit_strarray_dispose(&paths);
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+
+    blame_files_ctx ctx = {git_repository_path(repo), &paths, &opts, results};
+    if (nthreads > 1 && paths.count > 1)
+        egit_parallel_for(paths.count, nthreads, &blame_files_init, &blame_files_cleanup,
+                          &blame_files_one, &ctx);
+
+    int retval = 0;
+    for (size_t i = 0; i < paths.count && !retval; i++) {
+        if (results[i].done)
+            continue;
+        git_blame *blame;
+        git_blame_options file_opts = opts;
+        retval = git_blame_file(&blame, repo, paths.strings[i], &file_opts);
+        if (!retval) {
+            retval = blame_snapshot_take(&results[i], blame);
+            git_blame_free(blame);
+        }
+    }
+
+    author_lines *authors = NULL;
+    size_t nauthors = 0, authors_alloc = 0;
+    egit_oidmap author_index = {0};
+    for (size_t i = 0; i < paths.count && !retval; i++)
+        if (!count_author_lines(&authors, &nauthors, &authors_alloc, &author_index, &results[i]))
+            retval = GIT_ERROR;
+    egit_oidmap_dispose(&author_index);
+
+    emacs_value files = esym_nil, ret = esym_nil;
+    for (size_t i = paths.count; i > 0 && !retval; i--) {
+        blame_snapshot *snapshot = &results[i-1];
+        const git_blame_hunk **hunks = (const git_blame_hunk**)
+            malloc((snapshot->nhunks + 1) * sizeof(git_blame_hunk*));
+        if (!hunks) {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+            break;
+        }
+        for (size_t j = 0; j < snapshot->nhunks; j++)
+            hunks[j] = &snapshot->hunks[j];
+        emacs_value vectors = blame_to_vectors(env, hunks, snapshot->nhunks);
+        free(hunks);
+        files = em_cons(env, em_cons(env, EM_STRING(paths.strings[i-1]), vectors), files);
+    }
+
+    if (!retval) {
+        qsort(authors, nauthors, sizeof(author_lines), compare_author_lines);
+        emacs_value counts = esym_nil;
+        for (size_t i = nauthors; i > 0; i--) {
+            const author_lines *author = &authors[i-1];
+            emacs_value entry = em_cons(env, EM_STRING(author->sig->email), EM_INTEGER(author->lines));
+            entry = em_cons(env, EM_STRING(author->sig->name), entry);
+            counts = em_cons(env, entry, counts);
+        }
+        ret = em_cons(env, files, counts);
+    }
+
+    free(authors);
+    for (size_t i = 0; i < paths.count; i++)
+        blame_snapshot_dispose(&results[i]);
+    free(results);
+    egit_strarray_dispose(&paths);
+
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+    return ret;
+}
 
 // =============================================================================
 // Getters - blame hunk
@@ -175,12 +1511,15 @@ emacs_value egit_blame_hunk_orig_path(emacs_env *env, emacs_value _hunk)
 EGIT_DOC(blame_hunk_signature, "BLAME-HUNK &optional ORIG",
          "Get the author of the change represented by BLAME-HUNK.\n"
          "If ORIG is non-nil, instead get the author of the commit named by\n"
-         "(libgit-blame-hunk-commit-id BLAME-HUNK t).");
+         "(libgit-blame-hunk-commit-id BLAME-HUNK t).\n"
+         "Return nil for lines that are not committed.");
 emacs_value egit_blame_hunk_signature(emacs_env *env, emacs_value _hunk, emacs_value orig)
 {
     EGIT_ASSERT_BLAME_HUNK(_hunk);
     git_blame_hunk *hunk = EGIT_EXTRACT(_hunk);
     git_signature *sig = EM_EXTRACT_BOOLEAN(orig) ? hunk->final_signature : hunk->orig_signature;
+    if (!sig)
+        return esym_nil;
     git_signature *ret;
     int retval = git_signature_dup(&ret, sig);
     EGIT_CHECK_ERROR(retval);
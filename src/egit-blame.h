@@ -3,10 +3,24 @@
 #ifndef EGIT_BLAME_H
 #define EGIT_BLAME_H
 
+typedef struct egit_blame_session egit_blame_session;
+void egit_blame_session_free(egit_blame_session *session);
+
 EGIT_DEFUN(blame_file, emacs_value _repo, emacs_value _path, emacs_value _options);
+EGIT_DEFUN(blame_buffer, emacs_value _reference, emacs_value text);
 EGIT_DEFUN(blame_get_hunk_byindex, emacs_value _blame, emacs_value _index);
 EGIT_DEFUN(blame_get_hunk_byline, emacs_value _blame, emacs_value _line);
 EGIT_DEFUN(blame_get_hunk_count, emacs_value _blame);
+EGIT_DEFUN(blame_to_vectors, emacs_value _blame);
+EGIT_DEFUN(blame_files, emacs_value _repo, emacs_value _paths, emacs_value _options,
+           emacs_value threads);
+EGIT_DEFUN(blame_incremental, emacs_value _repo, emacs_value _path, emacs_value func,
+           emacs_value _options);
+
+EGIT_DEFUN(blame_session_new, emacs_value _repo, emacs_value _path, emacs_value revision);
+EGIT_DEFUN(blame_session_move, emacs_value _session, emacs_value revision);
+EGIT_DEFUN(blame_session_revision, emacs_value _session);
+EGIT_DEFUN(blame_session_to_vectors, emacs_value _session);
 
 EGIT_DEFUN(blame_hunk_commit_id, emacs_value _hunk, emacs_value orig);
 EGIT_DEFUN(blame_hunk_lines, emacs_value _hunk);
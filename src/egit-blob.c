@@ -3,6 +3,7 @@
 #include "git2.h"
 
 #include "egit.h"
+#include "egit-util.h"
 #include "interface.h"
 #include "egit-blob.h"
 
@@ -107,13 +108,20 @@ emacs_value egit_blob_lookup_prefix(emacs_env *env, emacs_value _repo, emacs_val
 // =============================================================================
 // Getters
 
-EGIT_DOC(blob_binary_p, "BLOB",
+EGIT_DOC(blob_binary_p, "BLOB &optional FULL",
          "Non-nil if BLOB is binary.\n"
-         "Note: This check is only heuristic!");
-emacs_value egit_blob_binary_p(emacs_env *env, emacs_value _blob)
+         "Note: This check is only heuristic!\n"
+         "If FULL is non-nil, BLOB is instead considered binary if it\n"
+         "contains a NUL byte anywhere, not just near the start.");
+emacs_value egit_blob_binary_p(emacs_env *env, emacs_value _blob, emacs_value full)
 {
     EGIT_ASSERT_BLOB(_blob);
     git_blob *blob = EGIT_EXTRACT(_blob);
+    if (EM_EXTRACT_BOOLEAN(full)) {
+        bool nul;
+        egit_scan_text(git_blob_rawcontent(blob), git_blob_rawsize(blob), &nul, NULL);
+        return nul ? esym_t : esym_nil;
+    }
     return git_blob_is_binary(blob) ? esym_t : esym_nil;
 }
 
@@ -151,6 +159,35 @@ emacs_value egit_blob_id(emacs_env *env, emacs_value _blob)
     return EM_STRING(oid_s);
 }
 
+EGIT_DOC(blob_line_count, "BLOB",
+         "Return the number of lines in BLOB.\n"
+         "A final line without a newline is counted.");
+emacs_value egit_blob_line_count(emacs_env *env, emacs_value _blob)
+{
+    EGIT_ASSERT_BLOB(_blob);
+    git_blob *blob = EGIT_EXTRACT(_blob);
+    size_t count = egit_count_lines(git_blob_rawcontent(blob), git_blob_rawsize(blob));
+    return EM_INTEGER(count);
+}
+
+EGIT_DOC(blob_line_offsets, "BLOB",
+         "Return a vector of the byte offsets at which the lines of BLOB start.");
+emacs_value egit_blob_line_offsets(emacs_env *env, emacs_value _blob)
+{
+    EGIT_ASSERT_BLOB(_blob);
+    git_blob *blob = EGIT_EXTRACT(_blob);
+
+    egit_intbuf offsets = {0};
+    if (!egit_line_offsets(&offsets, git_blob_rawcontent(blob), git_blob_rawsize(blob))) {
+        egit_intbuf_dispose(&offsets);
+        EGIT_CHECK_ERROR(-1);
+    }
+
+    emacs_value ret = em_integer_vector(env, offsets.ptr, offsets.size);
+    egit_intbuf_dispose(&offsets);
+    return ret;
+}
+
 EGIT_DOC(blob_owner, "BLOB", "Return the repository that BLOB belongs to.");
 emacs_value egit_blob_owner(emacs_env *env, emacs_value _blob)
 {
@@ -7,9 +7,11 @@ EGIT_DEFUN(blob_create_fromworkdir, emacs_value _repo, emacs_value _str);
 EGIT_DEFUN(blob_lookup, emacs_value _repo, emacs_value _oid);
 EGIT_DEFUN(blob_lookup_prefix, emacs_value _repo, emacs_value _oid);
 
-EGIT_DEFUN(blob_binary_p, emacs_value _blob);
+EGIT_DEFUN(blob_binary_p, emacs_value _blob, emacs_value full);
 EGIT_DEFUN(blob_filtered_content, emacs_value _blob, emacs_value _path, emacs_value ignore);
 EGIT_DEFUN(blob_id, emacs_value _blob);
+EGIT_DEFUN(blob_line_count, emacs_value _blob);
+EGIT_DEFUN(blob_line_offsets, emacs_value _blob);
 EGIT_DEFUN(blob_owner, emacs_value _blob);
 EGIT_DEFUN(blob_rawcontent, emacs_value _blob);
 EGIT_DEFUN(blob_rawsize, emacs_value _blob);
@@ -0,0 +1,1552 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "git2.h"
+
+#include "egit.h"
+#include "egit-util.h"
+#include "interface.h"
+#include "egit-commit-graph.h"
+
+// See Documentation/technical/commit-graph-format.txt in git.git
+#define GRAPH_SIGNATURE 0x43475048 /* "CGPH" */
+#define GRAPH_VERSION 1
+#define GRAPH_HASH_SHA1 1
+#define GRAPH_HEADER_SIZE 8
+#define GRAPH_CHUNK_ENTRY_SIZE 12
+#define GRAPH_FANOUT_SIZE (256 * 4)
+#define GRAPH_CDAT_SIZE (GIT_OID_RAWSZ + 16)
+
+#define GRAPH_CHUNK_OIDF 0x4f494446 /* "OIDF" */
+#define GRAPH_CHUNK_OIDL 0x4f49444c /* "OIDL" */
+#define GRAPH_CHUNK_CDAT 0x43444154 /* "CDAT" */
+#define GRAPH_CHUNK_EDGE 0x45444745 /* "EDGE" */
+#define GRAPH_CHUNK_BIDX 0x42494458 /* "BIDX" */
+#define GRAPH_CHUNK_BDAT 0x42444154 /* "BDAT" */
+
+#define GRAPH_PARENT_NONE 0x70000000
+#define GRAPH_EXTRA_EDGES 0x80000000
+#define GRAPH_LAST_EDGE 0x80000000
+#define GRAPH_GENERATION_MAX 0x3fffffff
+#define GRAPH_TIME_MAX 0x3ffffffffLL
+
+// Changed-path Bloom filters, with the settings git uses
+#define BLOOM_HEADER_SIZE 12
+#define BLOOM_VERSION 1
+#define BLOOM_NUM_HASHES 7
+#define BLOOM_BITS_PER_ENTRY 10
+#define BLOOM_MAX_CHANGED_PATHS 512
+#define BLOOM_SEED0 0x293ae76f
+#define BLOOM_SEED1 0x7e646e2c
+
+#define GRAPH_CACHE_SIZE 4
+
+struct egit_commit_graph {
+    // References from the cache and from egit_commit_graph_retain
+    size_t refcount;
+
+    unsigned char *data;
+    size_t size;
+    uint32_t ncommits;
+    const unsigned char *fanout;
+    const unsigned char *oids;
+    const unsigned char *cdat;
+    const unsigned char *edges;
+    size_t nedges;
+    bool generations;
+
+    const unsigned char *bloom_index;
+    const unsigned char *bloom_data;
+    size_t bloom_size;
+    uint32_t bloom_version;
+    uint32_t bloom_hashes;
+    uint32_t bloom_bits;
+};
+
+static uint32_t get_be32(const unsigned char *p)
+{
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static uint64_t get_be64(const unsigned char *p)
+{
+    return (uint64_t) get_be32(p) << 32 | get_be32(p + 4);
+}
+
+static void put_be32(unsigned char *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static void put_be64(unsigned char *p, uint64_t value)
+{
+    put_be32(p, value >> 32);
+    put_be32(p + 4, value);
+}
+
+static const unsigned char *graph_cdat(const egit_commit_graph *graph, uint32_t pos)
+{
+    return graph->cdat + (size_t) pos * GRAPH_CDAT_SIZE;
+}
+
+/**
+ * Store the Ith parent of the commit at POS in OUT.
+ * @return False if the commit has no Ith parent.
+ */
+static bool graph_parent(const egit_commit_graph *graph, uint32_t pos, size_t i, uint32_t *out)
+{
+    const unsigned char *cdat = graph_cdat(graph, pos) + GIT_OID_RAWSZ;
+    uint32_t first = get_be32(cdat), second = get_be32(cdat + 4);
+
+    if (i == 0) {
+        *out = first;
+        return first != GRAPH_PARENT_NONE;
+    }
+    if (second == GRAPH_PARENT_NONE)
+        return false;
+    if (!(second & GRAPH_EXTRA_EDGES)) {
+        *out = second;
+        return i == 1;
+    }
+
+    const unsigned char *edge = graph->edges + 4 * ((size_t) (second & ~GRAPH_EXTRA_EDGES) + i - 1);
+    if (i > 1 && (get_be32(edge - 4) & GRAPH_LAST_EDGE))
+        return false;
+    *out = get_be32(edge) & ~GRAPH_LAST_EDGE;
+    return true;
+}
+
+/**
+ * Check that every parent of the commit at POS is in GRAPH, and that its
+ * generation number is above theirs.
+ */
+static bool graph_check_parents(egit_commit_graph *graph, uint32_t pos)
+{
+    const unsigned char *cdat = graph_cdat(graph, pos) + GIT_OID_RAWSZ;
+    uint32_t second = get_be32(cdat + 4);
+    if (second != GRAPH_PARENT_NONE && (second & GRAPH_EXTRA_EDGES)) {
+        size_t i = second & ~GRAPH_EXTRA_EDGES;
+        while (i < graph->nedges && !(get_be32(graph->edges + 4 * i) & GRAPH_LAST_EDGE))
+            i++;
+        if (i >= graph->nedges)
+            return false;
+    }
+
+    uint32_t generation = egit_commit_graph_level(graph, pos), parent;
+    for (size_t i = 0; graph_parent(graph, pos, i, &parent); i++) {
+        if (parent >= graph->ncommits)
+            return false;
+        uint32_t parent_generation = egit_commit_graph_level(graph, parent);
+        if (parent_generation >= generation && generation != GRAPH_GENERATION_MAX)
+            graph->generations = false;
+    }
+    return true;
+}
+
+/**
+ * Check the changed-path Bloom filter chunks.  A graph with broken filters
+ * is still usable without them.
+ */
+static bool graph_parse_bloom(egit_commit_graph *graph, size_t bidx_size)
+{
+    if (!graph->bloom_index || !graph->bloom_data ||
+        bidx_size != (size_t) graph->ncommits * 4 || graph->bloom_size < BLOOM_HEADER_SIZE)
+        return false;
+
+    graph->bloom_version = get_be32(graph->bloom_data);
+    graph->bloom_hashes = get_be32(graph->bloom_data + 4);
+    graph->bloom_bits = get_be32(graph->bloom_data + 8);
+    if ((graph->bloom_version != 1 && graph->bloom_version != 2) ||
+        !graph->bloom_hashes || graph->bloom_hashes > 32)
+        return false;
+
+    uint32_t prev = 0;
+    for (uint32_t pos = 0; pos < graph->ncommits; pos++) {
+        uint32_t end = get_be32(graph->bloom_index + 4 * (size_t) pos);
+        if (end < prev || end > graph->bloom_size - BLOOM_HEADER_SIZE)
+            return false;
+        prev = end;
+    }
+    return true;
+}
+
+static bool graph_parse(egit_commit_graph *graph)
+{
+    const unsigned char *data = graph->data;
+    if (graph->size < GRAPH_HEADER_SIZE + GIT_OID_RAWSZ || get_be32(data) != GRAPH_SIGNATURE ||
+        data[4] != GRAPH_VERSION || data[5] != GRAPH_HASH_SHA1 || data[7] != 0)
+        return false;
+
+    size_t nchunks = data[6], end = graph->size - GIT_OID_RAWSZ;
+    size_t oids_size = 0, cdat_size = 0, bidx_size = 0;
+    if (GRAPH_HEADER_SIZE + (nchunks + 1) * GRAPH_CHUNK_ENTRY_SIZE > end)
+        return false;
+
+    for (size_t i = 0; i < nchunks; i++) {
+        const unsigned char *entry = data + GRAPH_HEADER_SIZE + i * GRAPH_CHUNK_ENTRY_SIZE;
+        uint64_t start = get_be64(entry + 4), stop = get_be64(entry + 4 + GRAPH_CHUNK_ENTRY_SIZE);
+        if (start > stop || stop > end)
+            return false;
+
+        switch (get_be32(entry)) {
+        case GRAPH_CHUNK_OIDF:
+            if (stop - start != GRAPH_FANOUT_SIZE)
+                return false;
+            graph->fanout = data + start;
+            break;
+        case GRAPH_CHUNK_OIDL:
+            graph->oids = data + start;
+            oids_size = stop - start;
+            break;
+        case GRAPH_CHUNK_CDAT:
+            graph->cdat = data + start;
+            cdat_size = stop - start;
+            break;
+        case GRAPH_CHUNK_EDGE:
+            graph->edges = data + start;
+            graph->nedges = (stop - start) / 4;
+            break;
+        case GRAPH_CHUNK_BIDX:
+            graph->bloom_index = data + start;
+            bidx_size = stop - start;
+            break;
+        case GRAPH_CHUNK_BDAT:
+            graph->bloom_data = data + start;
+            graph->bloom_size = stop - start;
+            break;
+        }
+    }
+    if (!graph->fanout || !graph->oids || !graph->cdat)
+        return false;
+
+    for (size_t i = 0; i < 256; i++) {
+        uint32_t count = get_be32(graph->fanout + 4 * i);
+        if (count < graph->ncommits)
+            return false;
+        graph->ncommits = count;
+    }
+    if (oids_size != (size_t) graph->ncommits * GIT_OID_RAWSZ ||
+        cdat_size != (size_t) graph->ncommits * GRAPH_CDAT_SIZE)
+        return false;
+
+    graph->generations = true;
+    for (uint32_t pos = 0; pos < graph->ncommits; pos++) {
+        if (pos > 0 && memcmp(graph->oids + (size_t) (pos - 1) * GIT_OID_RAWSZ,
+                              graph->oids + (size_t) pos * GIT_OID_RAWSZ, GIT_OID_RAWSZ) >= 0)
+            return false;
+        if (!graph_check_parents(graph, pos))
+            return false;
+        if (!egit_commit_graph_level(graph, pos))
+            graph->generations = false;
+    }
+
+    if (!graph_parse_bloom(graph, bidx_size))
+        graph->bloom_index = graph->bloom_data = NULL;
+
+    return true;
+}
+
+static void graph_free(egit_commit_graph *graph)
+{
+    if (!graph)
+        return;
+    free(graph->data);
+    free(graph);
+}
+
+static egit_commit_graph *graph_load(const char *path, size_t size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    egit_commit_graph *graph = calloc(1, sizeof(egit_commit_graph));
+    if (graph) {
+        graph->refcount = 1;
+        graph->size = size;
+        graph->data = malloc(size ? size : 1);
+    }
+    bool ok = graph && graph->data && fread(graph->data, 1, size, file) == size;
+    fclose(file);
+
+    if (!ok || !graph_parse(graph)) {
+        graph_free(graph);
+        return NULL;
+    }
+    return graph;
+}
+
+static char *graph_path(git_repository *repo)
+{
+    static const char suffix[] = "objects/info/commit-graph";
+    const char *dir = git_repository_commondir(repo);
+    char *path = malloc(strlen(dir) + sizeof(suffix));
+    if (path) {
+        strcpy(path, dir);
+        strcat(path, suffix);
+    }
+    return path;
+}
+
+typedef struct {
+    char *path;
+    egit_commit_graph *graph;
+    off_t size;
+    time_t mtime;
+    ino_t ino;
+} graph_cache_entry;
+
+static graph_cache_entry graph_cache[GRAPH_CACHE_SIZE];
+static size_t graph_cache_next;
+
+static void graph_cache_clear(graph_cache_entry *entry)
+{
+    free(entry->path);
+    egit_commit_graph_release(entry->graph);
+    memset(entry, 0, sizeof(graph_cache_entry));
+}
+
+static graph_cache_entry *graph_cache_find(const char *path)
+{
+    for (size_t i = 0; i < GRAPH_CACHE_SIZE; i++)
+        if (graph_cache[i].path && !strcmp(graph_cache[i].path, path))
+            return &graph_cache[i];
+    return NULL;
+}
+
+/**
+ * Return the commit graph of REPO, whether or not it has generation numbers.
+ */
+static egit_commit_graph *graph_cache_lookup(git_repository *repo)
+{
+    char *path = graph_path(repo);
+    if (!path)
+        return NULL;
+
+    struct stat st;
+    bool exists = !stat(path, &st);
+    graph_cache_entry *entry = graph_cache_find(path);
+
+    if (entry && exists && entry->size == st.st_size &&
+        entry->mtime == st.st_mtime && entry->ino == st.st_ino) {
+        free(path);
+        return entry->graph;
+    }
+
+    if (!entry) {
+        entry = &graph_cache[graph_cache_next];
+        graph_cache_next = (graph_cache_next + 1) % GRAPH_CACHE_SIZE;
+    }
+    graph_cache_clear(entry);
+    if (!exists) {
+        free(path);
+        return NULL;
+    }
+
+    entry->path = path;
+    entry->graph = graph_load(path, st.st_size);
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->ino = st.st_ino;
+    return entry->graph;
+}
+
+egit_commit_graph *egit_commit_graph_get(git_repository *repo)
+{
+    egit_commit_graph *graph = graph_cache_lookup(repo);
+    return graph && graph->generations ? graph : NULL;
+}
+
+egit_commit_graph *egit_commit_graph_retain(egit_commit_graph *graph)
+{
+    if (graph)
+        graph->refcount++;
+    return graph;
+}
+
+void egit_commit_graph_release(egit_commit_graph *graph)
+{
+    if (graph && !--graph->refcount)
+        graph_free(graph);
+}
+
+bool egit_commit_graph_find(const egit_commit_graph *graph, const git_oid *id, uint32_t *pos)
+{
+    unsigned char first = id->id[0];
+    uint32_t lo = first ? get_be32(graph->fanout + 4 * (first - 1)) : 0;
+    uint32_t hi = get_be32(graph->fanout + 4 * first);
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(id->id, graph->oids + (size_t) mid * GIT_OID_RAWSZ, GIT_OID_RAWSZ);
+        if (!cmp) {
+            *pos = mid;
+            return true;
+        }
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return false;
+}
+
+uint32_t egit_commit_graph_count(const egit_commit_graph *graph)
+{
+    return graph->ncommits;
+}
+
+void egit_commit_graph_id(git_oid *out, const egit_commit_graph *graph, uint32_t pos)
+{
+    git_oid_fromraw(out, graph->oids + (size_t) pos * GIT_OID_RAWSZ);
+}
+
+void egit_commit_graph_tree_id(git_oid *out, const egit_commit_graph *graph, uint32_t pos)
+{
+    git_oid_fromraw(out, graph_cdat(graph, pos));
+}
+
+uint32_t egit_commit_graph_level(const egit_commit_graph *graph, uint32_t pos)
+{
+    return get_be32(graph_cdat(graph, pos) + GIT_OID_RAWSZ + 8) >> 2;
+}
+
+int64_t egit_commit_graph_time(const egit_commit_graph *graph, uint32_t pos)
+{
+    const unsigned char *p = graph_cdat(graph, pos) + GIT_OID_RAWSZ + 8;
+    return (int64_t) (get_be32(p) & 3) << 32 | get_be32(p + 4);
+}
+
+size_t egit_commit_graph_parents(const egit_commit_graph *graph, uint32_t pos,
+                                 uint32_t *out, size_t max)
+{
+    size_t n = 0;
+    uint32_t parent;
+    for (; graph_parent(graph, pos, n, &parent); n++)
+        if (n < max)
+            out[n] = parent;
+    return n;
+}
+
+static uint32_t rotl32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+/**
+ * 32-bit Murmur3, as git uses it for changed-path filters.  Version 1
+ * filters hash the bytes as signed chars, which git fixed in version 2.
+ */
+static uint32_t bloom_murmur3(uint32_t seed, const char *data, size_t len, bool sign_extend)
+{
+#define BLOOM_BYTE(i) (sign_extend ? (uint32_t) (int32_t) (signed char) data[i] \
+                       : (uint32_t) (unsigned char) data[i])
+    const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+    uint32_t hash = seed, k;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        k = BLOOM_BYTE(i) | BLOOM_BYTE(i+1) << 8 | BLOOM_BYTE(i+2) << 16 | BLOOM_BYTE(i+3) << 24;
+        k = rotl32(k * c1, 15) * c2;
+        hash = rotl32(hash ^ k, 13) * 5 + 0xe6546b64;
+    }
+
+    k = 0;
+    switch (len - i) {
+    case 3:
+        k ^= BLOOM_BYTE(i+2) << 16;
+        /* fall through */
+    case 2:
+        k ^= BLOOM_BYTE(i+1) << 8;
+        /* fall through */
+    case 1:
+        k ^= BLOOM_BYTE(i);
+        hash ^= rotl32(k * c1, 15) * c2;
+    }
+#undef BLOOM_BYTE
+
+    hash ^= (uint32_t) len;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * Compute the bit positions of the key PATH (of length LEN) in a filter of
+ * NBITS bits, storing NHASHES of them in OUT.
+ */
+static void bloom_key(uint32_t *out, uint32_t nhashes, uint32_t nbits,
+                      const char *path, size_t len, bool sign_extend)
+{
+    uint32_t hash0 = bloom_murmur3(BLOOM_SEED0, path, len, sign_extend);
+    uint32_t hash1 = bloom_murmur3(BLOOM_SEED1, path, len, sign_extend);
+    for (uint32_t i = 0; i < nhashes; i++)
+        out[i] = (hash0 + i * hash1) % nbits;
+}
+
+int egit_commit_graph_maybe_changed(const egit_commit_graph *graph, uint32_t pos, const char *path)
+{
+    if (!graph->bloom_index)
+        return -1;
+
+    uint32_t start = pos ? get_be32(graph->bloom_index + 4 * ((size_t) pos - 1)) : 0;
+    uint32_t end = get_be32(graph->bloom_index + 4 * (size_t) pos);
+    if (start == end)
+        return -1;
+    const unsigned char *filter = graph->bloom_data + BLOOM_HEADER_SIZE + start;
+    uint32_t nbits = 8 * (end - start), bits[graph->bloom_hashes];
+
+    // The leading directories of every changed path are keys as well, and
+    // testing them too weeds out more false positives
+    size_t len = strlen(path);
+    while (len > 0 && path[len-1] == '/')
+        len--;
+    while (len > 0) {
+        bloom_key(bits, graph->bloom_hashes, nbits, path, len, graph->bloom_version == 1);
+        for (uint32_t i = 0; i < graph->bloom_hashes; i++)
+            if (!(filter[bits[i] / 8] & (1 << (bits[i] % 8))))
+                return 0;
+        do
+            len--;
+        while (len > 0 && path[len] != '/');
+    }
+    return 1;
+}
+
+/**
+ * Priority queue of commit positions, highest generation first.  Among
+ * commits of equal generation the most recent one comes first.
+ */
+typedef struct {
+    const egit_commit_graph *graph;
+    uint32_t *ptr;
+    size_t size;
+    size_t alloc;
+} graph_queue;
+
+static bool graph_queue_before(const graph_queue *queue, uint32_t a, uint32_t b)
+{
+    uint32_t gen_a = egit_commit_graph_level(queue->graph, a);
+    uint32_t gen_b = egit_commit_graph_level(queue->graph, b);
+    if (gen_a != gen_b)
+        return gen_a > gen_b;
+    return egit_commit_graph_time(queue->graph, a) > egit_commit_graph_time(queue->graph, b);
+}
+
+static bool graph_queue_push(graph_queue *queue, uint32_t pos)
+{
+    if (queue->size == queue->alloc) {
+        size_t alloc = queue->alloc ? 2 * queue->alloc : 64;
+        uint32_t *ptr = realloc(queue->ptr, alloc * sizeof(uint32_t));
+        if (!ptr)
+            return false;
+        queue->ptr = ptr;
+        queue->alloc = alloc;
+    }
+
+    size_t i = queue->size++;
+    while (i > 0 && graph_queue_before(queue, pos, queue->ptr[(i-1)/2])) {
+        queue->ptr[i] = queue->ptr[(i-1)/2];
+        i = (i-1)/2;
+    }
+    queue->ptr[i] = pos;
+    return true;
+}
+
+static uint32_t graph_queue_pop(graph_queue *queue)
+{
+    uint32_t top = queue->ptr[0], last = queue->ptr[--queue->size];
+    size_t i = 0;
+    while (2*i + 1 < queue->size) {
+        size_t child = 2*i + 1;
+        if (child + 1 < queue->size && graph_queue_before(queue, queue->ptr[child+1], queue->ptr[child]))
+            child++;
+        if (!graph_queue_before(queue, queue->ptr[child], last))
+            break;
+        queue->ptr[i] = queue->ptr[child];
+        i = child;
+    }
+    queue->ptr[i] = last;
+    return top;
+}
+
+#define GRAPH_SIDE_ONE 1
+#define GRAPH_SIDE_TWO 2
+#define GRAPH_SIDE_BOTH 3
+#define GRAPH_STALE 4
+
+int egit_commit_graph_ahead_behind(size_t *ahead, size_t *behind, const egit_commit_graph *graph,
+                                   uint32_t local, uint32_t upstream)
+{
+    *ahead = *behind = 0;
+    if (local == upstream)
+        return 0;
+
+    graph_queue queue = {.graph = graph};
+    unsigned char *flags = calloc(graph->ncommits, 1);
+    if (!flags || !graph_queue_push(&queue, local) || !graph_queue_push(&queue, upstream))
+        goto oom;
+    flags[local] = GRAPH_SIDE_ONE;
+    flags[upstream] = GRAPH_SIDE_TWO;
+
+    // Commits come out in generation order, so their flags are final when
+    // popped.  Once every queued commit is on both sides, the rest are too.
+    size_t active = 2;
+    while (active && queue.size) {
+        uint32_t pos = graph_queue_pop(&queue), parent;
+        unsigned char side = flags[pos];
+        if (side == GRAPH_SIDE_ONE)
+            (*ahead)++;
+        else if (side == GRAPH_SIDE_TWO)
+            (*behind)++;
+        if (side != GRAPH_SIDE_BOTH)
+            active--;
+
+        for (size_t i = 0; graph_parent(graph, pos, i, &parent); i++) {
+            unsigned char old = flags[parent];
+            if ((old | side) == old)
+                continue;
+            flags[parent] |= side;
+            if (!old) {
+                if (!graph_queue_push(&queue, parent))
+                    goto oom;
+                if (side != GRAPH_SIDE_BOTH)
+                    active++;
+            }
+            else if (active)
+                active--;
+        }
+    }
+
+    free(queue.ptr);
+    free(flags);
+    return 0;
+
+oom:
+    free(queue.ptr);
+    free(flags);
+    giterr_set_oom();
+    return -1;
+}
+
+void egit_commit_graph_count_pairs(size_t *ahead, size_t *behind, const unsigned char *mark,
+                                   const size_t *pairs, size_t npairs)
+{
+    for (size_t i = 0; i < npairs; i++) {
+        size_t local = pairs[2*i], upstream = pairs[2*i + 1];
+        bool in_local = mark[local / 8] & (1 << (local % 8));
+        bool in_upstream = mark[upstream / 8] & (1 << (upstream % 8));
+        if (in_local && !in_upstream)
+            ahead[i]++;
+        else if (in_upstream && !in_local)
+            behind[i]++;
+    }
+}
+
+int egit_commit_graph_ahead_behind_many(size_t *ahead, size_t *behind, const egit_commit_graph *graph,
+                                        const uint32_t *tips, size_t ntips,
+                                        const size_t *pairs, size_t npairs)
+{
+    memset(ahead, 0, npairs * sizeof(size_t));
+    memset(behind, 0, npairs * sizeof(size_t));
+
+    // Every commit on the way gets a mark with one bit per tip that reaches
+    // it, which lives from its discovery until it is popped
+    size_t size = (ntips + 7) / 8;
+    graph_queue queue = {.graph = graph};
+    unsigned char **marks = calloc(graph->ncommits, sizeof(unsigned char*));
+    unsigned char *full = calloc(size, 1);
+    if (!marks || !full)
+        goto oom;
+    for (size_t i = 0; i < ntips; i++)
+        full[i / 8] |= 1 << (i % 8);
+
+    for (size_t i = 0; i < ntips; i++) {
+        if (!marks[tips[i]]) {
+            unsigned char *mark = calloc(size, 1);
+            if (!mark || !graph_queue_push(&queue, tips[i])) {
+                free(mark);
+                goto oom;
+            }
+            marks[tips[i]] = mark;
+        }
+        marks[tips[i]][i / 8] |= 1 << (i % 8);
+    }
+
+    size_t active = 0;
+    for (size_t i = 0; i < queue.size; i++)
+        if (memcmp(marks[queue.ptr[i]], full, size))
+            active++;
+
+    // As in egit_commit_graph_ahead_behind, marks are final when popped, and
+    // once every queued commit is reachable from all tips, the rest are too
+    while (active && queue.size) {
+        uint32_t pos = graph_queue_pop(&queue), parent;
+        unsigned char *mark = marks[pos];
+        bool mark_full = !memcmp(mark, full, size);
+        if (!mark_full) {
+            egit_commit_graph_count_pairs(ahead, behind, mark, pairs, npairs);
+            active--;
+        }
+
+        for (size_t i = 0; graph_parent(graph, pos, i, &parent); i++) {
+            unsigned char *old = marks[parent];
+            if (!old) {
+                unsigned char *copy = malloc(size);
+                if (!copy || !graph_queue_push(&queue, parent)) {
+                    free(copy);
+                    free(mark);
+                    goto oom;
+                }
+                marks[parent] = memcpy(copy, mark, size);
+                if (!mark_full)
+                    active++;
+                continue;
+            }
+
+            bool was_full = !memcmp(old, full, size);
+            for (size_t j = 0; j < size; j++)
+                old[j] |= mark[j];
+            if (!was_full && !memcmp(old, full, size))
+                active--;
+        }
+
+        free(mark);
+        marks[pos] = NULL;
+    }
+
+    for (size_t i = 0; i < queue.size; i++)
+        free(marks[queue.ptr[i]]);
+    free(queue.ptr);
+    free(marks);
+    free(full);
+    return 0;
+
+oom:
+    if (marks)
+        for (size_t i = 0; i < queue.size; i++)
+            free(marks[queue.ptr[i]]);
+    free(queue.ptr);
+    free(marks);
+    free(full);
+    giterr_set_oom();
+    return -1;
+}
+
+int egit_commit_graph_descendant_of(const egit_commit_graph *graph, uint32_t commit, uint32_t ancestor)
+{
+    uint32_t min_generation = egit_commit_graph_level(graph, ancestor);
+    if (commit == ancestor || egit_commit_graph_level(graph, commit) <= min_generation)
+        return 0;
+
+    graph_queue queue = {.graph = graph};
+    unsigned char *seen = calloc(graph->ncommits, 1);
+    if (!seen || !graph_queue_push(&queue, commit))
+        goto oom;
+    seen[commit] = 1;
+
+    int retval = 0;
+    while (queue.size && !retval) {
+        uint32_t pos = graph_queue_pop(&queue), parent;
+        for (size_t i = 0; graph_parent(graph, pos, i, &parent); i++) {
+            if (parent == ancestor) {
+                retval = 1;
+                break;
+            }
+            if (seen[parent] || egit_commit_graph_level(graph, parent) <= min_generation)
+                continue;
+            seen[parent] = 1;
+            if (!graph_queue_push(&queue, parent))
+                goto oom;
+        }
+    }
+
+    free(queue.ptr);
+    free(seen);
+    return retval;
+
+oom:
+    free(queue.ptr);
+    free(seen);
+    giterr_set_oom();
+    return -1;
+}
+
+int egit_commit_graph_merge_base(uint32_t *out, const egit_commit_graph *graph,
+                                 const uint32_t *commits, size_t n)
+{
+    graph_queue queue = {.graph = graph};
+    unsigned char *flags = calloc(graph->ncommits, 1);
+    if (!flags)
+        goto oom;
+
+    // Number of queued commits that are not below a merge base
+    size_t active = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!flags[commits[i]]) {
+            if (!graph_queue_push(&queue, commits[i]))
+                goto oom;
+            active++;
+        }
+        flags[commits[i]] |= i ? GRAPH_SIDE_TWO : GRAPH_SIDE_ONE;
+    }
+
+    // Commits come out in generation order, so one on both sides that is
+    // not below an earlier one is a merge base.  Keep walking until only
+    // commits below a base are left, to find out whether there is another.
+    int retval = GIT_ENOTFOUND;
+    while (active && retval != GIT_EAMBIGUOUS) {
+        uint32_t pos = graph_queue_pop(&queue), parent;
+        unsigned char side = flags[pos];
+        if (!(side & GRAPH_STALE))
+            active--;
+        if (side == GRAPH_SIDE_BOTH) {
+            if (retval == GIT_ENOTFOUND) {
+                *out = pos;
+                retval = 0;
+            }
+            else
+                retval = GIT_EAMBIGUOUS;
+            side |= GRAPH_STALE;
+        }
+
+        for (size_t i = 0; graph_parent(graph, pos, i, &parent); i++) {
+            unsigned char old = flags[parent];
+            if ((old | side) == old)
+                continue;
+            flags[parent] |= side;
+            if (!old) {
+                if (!graph_queue_push(&queue, parent))
+                    goto oom;
+                if (!(side & GRAPH_STALE))
+                    active++;
+            }
+            else if ((side & GRAPH_STALE) && !(old & GRAPH_STALE))
+                active--;
+        }
+    }
+
+    free(queue.ptr);
+    free(flags);
+    if (retval == GIT_ENOTFOUND)
+        giterr_set_str(GITERR_MERGE, "no merge base found");
+    return retval;
+
+oom:
+    free(queue.ptr);
+    free(flags);
+    giterr_set_oom();
+    return -1;
+}
+
+/**
+ * A commit collected for writing.  Its parents are a run in the writer's
+ * parent arrays.
+ */
+typedef struct {
+    git_oid id;
+    git_oid tree_id;
+    int64_t time;
+    size_t parents;
+    size_t nparents;
+    unsigned char *filter;
+    size_t filter_len;
+} graph_entry;
+
+typedef struct {
+    git_repository *repo;
+    const egit_commit_graph *old;
+    bool changed_paths;
+    egit_oidmap seen;
+
+    graph_entry *entries;
+    size_t nentries;
+    size_t entries_alloc;
+
+    git_oid *parent_ids;
+    uint32_t *parent_pos;
+    size_t nparents;
+    size_t parents_alloc;
+
+    git_oid *stack;
+    size_t nstack;
+    size_t stack_alloc;
+} graph_writer;
+
+static bool graph_grow(void **ptr, size_t *alloc, size_t need, size_t elsize)
+{
+    if (need <= *alloc)
+        return true;
+    size_t n = *alloc ? *alloc : 64;
+    while (n < need)
+        n *= 2;
+    void *grown = realloc(*ptr, n * elsize);
+    if (!grown)
+        return false;
+    *ptr = grown;
+    *alloc = n;
+    return true;
+}
+
+static int graph_writer_visit(graph_writer *writer, const git_oid *id)
+{
+    bool existed;
+    void **slot = egit_oidmap_put(&writer->seen, id, &existed);
+    if (!slot ||
+        (!existed && !graph_grow((void **) &writer->stack, &writer->stack_alloc,
+                                 writer->nstack + 1, sizeof(git_oid)))) {
+        giterr_set_oom();
+        return -1;
+    }
+    if (!existed)
+        git_oid_cpy(&writer->stack[writer->nstack++], id);
+    return 0;
+}
+
+static int graph_writer_add_parent(graph_writer *writer, graph_entry *entry, const git_oid *id)
+{
+    if (!graph_grow((void **) &writer->parent_ids, &writer->parents_alloc,
+                    writer->nparents + 1, sizeof(git_oid))) {
+        giterr_set_oom();
+        return -1;
+    }
+    git_oid_cpy(&writer->parent_ids[writer->nparents++], id);
+    entry->nparents++;
+    return graph_writer_visit(writer, id);
+}
+
+/**
+ * Copy the changed-path filter of the commit at POS in OLD to ENTRY, if it
+ * was written with the same settings.
+ */
+static bool graph_copy_filter(graph_entry *entry, const egit_commit_graph *old, uint32_t pos)
+{
+    if (!old->bloom_index || old->bloom_version != BLOOM_VERSION ||
+        old->bloom_hashes != BLOOM_NUM_HASHES || old->bloom_bits != BLOOM_BITS_PER_ENTRY)
+        return true;
+
+    uint32_t start = pos ? get_be32(old->bloom_index + 4 * ((size_t) pos - 1)) : 0;
+    uint32_t end = get_be32(old->bloom_index + 4 * (size_t) pos);
+    if (start == end)
+        return true;
+
+    entry->filter = malloc(end - start);
+    if (!entry->filter)
+        return false;
+    memcpy(entry->filter, old->bloom_data + BLOOM_HEADER_SIZE + start, end - start);
+    entry->filter_len = end - start;
+    return true;
+}
+
+/**
+ * Collect the commit ID, taking it from the old graph when possible so
+ * that only new commits are read from the object database.
+ */
+static int graph_writer_add(graph_writer *writer, const git_oid *id)
+{
+    if (!graph_grow((void **) &writer->entries, &writer->entries_alloc,
+                    writer->nentries + 1, sizeof(graph_entry))) {
+        giterr_set_oom();
+        return -1;
+    }
+    graph_entry *entry = &writer->entries[writer->nentries++];
+    git_oid_cpy(&entry->id, id);
+    entry->parents = writer->nparents;
+    entry->nparents = 0;
+    entry->filter = NULL;
+    entry->filter_len = 0;
+
+    int retval = 0;
+    uint32_t pos, parent;
+    if (writer->old && egit_commit_graph_find(writer->old, id, &pos)) {
+        egit_commit_graph_tree_id(&entry->tree_id, writer->old, pos);
+        entry->time = egit_commit_graph_time(writer->old, pos);
+        if (writer->changed_paths && !graph_copy_filter(entry, writer->old, pos)) {
+            giterr_set_oom();
+            return -1;
+        }
+        for (size_t i = 0; !retval && graph_parent(writer->old, pos, i, &parent); i++) {
+            git_oid parent_id;
+            egit_commit_graph_id(&parent_id, writer->old, parent);
+            retval = graph_writer_add_parent(writer, entry, &parent_id);
+        }
+        return retval;
+    }
+
+    git_commit *commit;
+    retval = git_commit_lookup(&commit, writer->repo, id);
+    if (retval)
+        return retval;
+    git_oid_cpy(&entry->tree_id, git_commit_tree_id(commit));
+    entry->time = git_commit_time(commit);
+    unsigned int nparents = git_commit_parentcount(commit);
+    for (unsigned int i = 0; !retval && i < nparents; i++)
+        retval = graph_writer_add_parent(writer, entry, git_commit_parent_id(commit, i));
+    git_commit_free(commit);
+    return retval;
+}
+
+static int graph_writer_push_tips(graph_writer *writer)
+{
+    git_reference *ref;
+    git_object *commit;
+    int retval;
+
+    if (!git_repository_head(&ref, writer->repo)) {
+        if (!git_reference_peel(&commit, ref, GIT_OBJ_COMMIT)) {
+            retval = graph_writer_visit(writer, git_object_id(commit));
+            git_object_free(commit);
+            if (retval) {
+                git_reference_free(ref);
+                return retval;
+            }
+        }
+        git_reference_free(ref);
+    }
+
+    git_reference_iterator *iter;
+    retval = git_reference_iterator_new(&iter, writer->repo);
+    if (retval)
+        return retval;
+
+    while (!(retval = git_reference_next(&ref, iter))) {
+        if (!git_reference_peel(&commit, ref, GIT_OBJ_COMMIT)) {
+            retval = graph_writer_visit(writer, git_object_id(commit));
+            git_object_free(commit);
+        }
+        git_reference_free(ref);
+        if (retval)
+            break;
+    }
+    git_reference_iterator_free(iter);
+
+    giterr_clear();
+    return retval == GIT_ITEROVER ? 0 : retval;
+}
+
+static int compare_graph_entries(const void *a, const void *b)
+{
+    return git_oid_cmp(&((const graph_entry *) a)->id, &((const graph_entry *) b)->id);
+}
+
+/**
+ * Replace the parent IDs of all entries by their positions.
+ * The entries must be sorted.
+ */
+static void graph_writer_resolve_parents(graph_writer *writer)
+{
+    for (size_t i = 0; i < writer->nparents; i++) {
+        graph_entry key;
+        git_oid_cpy(&key.id, &writer->parent_ids[i]);
+        graph_entry *found = bsearch(&key, writer->entries, writer->nentries,
+                                     sizeof(graph_entry), compare_graph_entries);
+        writer->parent_pos[i] = found - writer->entries;
+    }
+}
+
+/**
+ * Compute the generation number of every entry: one more than the
+ * highest generation among its parents.
+ */
+static bool graph_writer_generations(graph_writer *writer, uint32_t *generations)
+{
+    uint32_t *stack = NULL;
+    size_t nstack = 0, alloc = 0;
+
+    for (size_t root = 0; root < writer->nentries; root++) {
+        if (generations[root])
+            continue;
+        if (!graph_grow((void **) &stack, &alloc, 1, sizeof(uint32_t)))
+            goto oom;
+        stack[nstack++] = root;
+
+        while (nstack) {
+            uint32_t pos = stack[nstack - 1];
+            const graph_entry *entry = &writer->entries[pos];
+            if (generations[pos]) {
+                nstack--;
+                continue;
+            }
+
+            uint32_t max = 0;
+            bool ready = true;
+            for (size_t i = 0; i < entry->nparents; i++) {
+                uint32_t parent = writer->parent_pos[entry->parents + i];
+                if (!generations[parent]) {
+                    if (!graph_grow((void **) &stack, &alloc, nstack + 1, sizeof(uint32_t)))
+                        goto oom;
+                    stack[nstack++] = parent;
+                    ready = false;
+                }
+                else if (generations[parent] > max)
+                    max = generations[parent];
+            }
+            if (ready) {
+                generations[pos] = max < GRAPH_GENERATION_MAX ? max + 1 : GRAPH_GENERATION_MAX;
+                nstack--;
+            }
+        }
+    }
+
+    free(stack);
+    return true;
+
+oom:
+    free(stack);
+    return false;
+}
+
+typedef struct {
+    const char *path;
+    size_t len;
+} bloom_path;
+
+static int compare_bloom_paths(const void *a, const void *b)
+{
+    const bloom_path *pa = (const bloom_path*) a, *pb = (const bloom_path*) b;
+    int cmp = memcmp(pa->path, pb->path, pa->len < pb->len ? pa->len : pb->len);
+    return cmp ? cmp : (pa->len > pb->len) - (pa->len < pb->len);
+}
+
+/**
+ * Compute the changed-path filter of ENTRY from the diff between the trees
+ * of the entry and of its first parent, whose ID is PARENT_TREE_ID.
+ */
+static int graph_entry_filter(graph_entry *entry, const git_oid *parent_tree_id, git_repository *repo)
+{
+    git_tree *tree = NULL, *parent = NULL;
+    git_diff *diff = NULL;
+    bloom_path *paths = NULL;
+
+    int retval = git_tree_lookup(&tree, repo, &entry->tree_id);
+    if (!retval && parent_tree_id)
+        retval = git_tree_lookup(&parent, repo, parent_tree_id);
+    if (!retval)
+        retval = git_diff_tree_to_tree(&diff, repo, parent, tree, NULL);
+    if (retval)
+        goto cleanup;
+
+    // Too many changes make a filter with all bits set
+    size_t ndeltas = git_diff_num_deltas(diff), npaths = 0, nkeys = 0;
+    if (ndeltas > BLOOM_MAX_CHANGED_PATHS) {
+        if (!(entry->filter = malloc(1)))
+            goto oom;
+        entry->filter[0] = 0xff;
+        entry->filter_len = 1;
+        goto cleanup;
+    }
+
+    // Every changed path is a key, and so are its leading directories
+    for (size_t i = 0; i < ndeltas; i++)
+        for (const char *p = git_diff_get_delta(diff, i)->new_file.path; *p; p++)
+            npaths += *p == '/';
+    npaths += ndeltas;
+    if (!(paths = malloc((npaths ? npaths : 1) * sizeof(bloom_path))))
+        goto oom;
+
+    npaths = 0;
+    for (size_t i = 0; i < ndeltas; i++) {
+        const char *path = git_diff_get_delta(diff, i)->new_file.path;
+        size_t len = strlen(path);
+        while (len > 0) {
+            paths[npaths].path = path;
+            paths[npaths++].len = len;
+            do
+                len--;
+            while (len > 0 && path[len] != '/');
+        }
+    }
+    qsort(paths, npaths, sizeof(bloom_path), compare_bloom_paths);
+    for (size_t i = 0; i < npaths; i++)
+        if (!nkeys || compare_bloom_paths(&paths[nkeys-1], &paths[i]))
+            paths[nkeys++] = paths[i];
+
+    size_t len = (nkeys * BLOOM_BITS_PER_ENTRY + 7) / 8;
+    len = len ? len : 1;
+    if (!(entry->filter = calloc(len, 1)))
+        goto oom;
+    entry->filter_len = len;
+
+    uint32_t bits[BLOOM_NUM_HASHES];
+    for (size_t i = 0; i < nkeys; i++) {
+        bloom_key(bits, BLOOM_NUM_HASHES, 8 * len, paths[i].path, paths[i].len, BLOOM_VERSION == 1);
+        for (size_t j = 0; j < BLOOM_NUM_HASHES; j++)
+            entry->filter[bits[j] / 8] |= 1 << (bits[j] % 8);
+    }
+    goto cleanup;
+
+oom:
+    giterr_set_oom();
+    retval = -1;
+
+cleanup:
+    free(paths);
+    git_diff_free(diff);
+    git_tree_free(parent);
+    git_tree_free(tree);
+    return retval;
+}
+
+static const git_oid *graph_writer_parent_tree(const graph_writer *writer, const graph_entry *entry)
+{
+    if (!entry->nparents)
+        return NULL;
+    return &writer->entries[writer->parent_pos[entry->parents]].tree_id;
+}
+
+typedef struct {
+    const char *repo_path;
+    graph_writer *writer;
+    const size_t *todo;
+} graph_filters_ctx;
+
+// Each worker thread has its own repository handle.
+static void *graph_filters_init(void *payload)
+{
+    graph_filters_ctx *ctx = (graph_filters_ctx*) payload;
+    git_repository *repo;
+    if (git_repository_open(&repo, ctx->repo_path))
+        return NULL;
+    return repo;
+}
+
+static void graph_filters_cleanup(void *state, __attribute__((unused)) void *payload)
+{
+    git_repository_free(state);
+}
+
+static int graph_filters_one(size_t index, void *state, void *payload)
+{
+    graph_filters_ctx *ctx = (graph_filters_ctx*) payload;
+    if (!state)
+        return 1;
+
+    // Failed commits are done again on the main thread, where errors can be signaled
+    graph_entry *entry = &ctx->writer->entries[ctx->todo[index]];
+    graph_entry_filter(entry, graph_writer_parent_tree(ctx->writer, entry), state);
+    return 0;
+}
+
+/**
+ * Compute the changed-path filters of all entries that were not copied
+ * from the old graph, spreading the diffs over worker threads.
+ */
+static int graph_writer_filters(graph_writer *writer)
+{
+    size_t *todo = malloc((writer->nentries ? writer->nentries : 1) * sizeof(size_t)), ntodo = 0;
+    if (!todo) {
+        giterr_set_oom();
+        return -1;
+    }
+    for (size_t i = 0; i < writer->nentries; i++)
+        if (!writer->entries[i].filter)
+            todo[ntodo++] = i;
+
+    size_t nthreads = egit_parallel_default_threads();
+    graph_filters_ctx ctx = {git_repository_path(writer->repo), writer, todo};
+    if (nthreads > 1 && ntodo > 1)
+        egit_parallel_for(ntodo, nthreads, &graph_filters_init, &graph_filters_cleanup,
+                          &graph_filters_one, &ctx);
+
+    int retval = 0;
+    for (size_t i = 0; i < ntodo && !retval; i++) {
+        graph_entry *entry = &writer->entries[todo[i]];
+        if (!entry->filter)
+            retval = graph_entry_filter(entry, graph_writer_parent_tree(writer, entry), writer->repo);
+    }
+
+    free(todo);
+    return retval;
+}
+
+/**
+ * Lay out the commit-graph file for the collected entries in OUT.
+ */
+static bool graph_writer_serialize(graph_writer *writer, const uint32_t *generations,
+                                   unsigned char **out, size_t *out_size)
+{
+    size_t n = writer->nentries, nedges = 0;
+    for (size_t i = 0; i < n; i++)
+        if (writer->entries[i].nparents > 2)
+            nedges += writer->entries[i].nparents - 1;
+
+    size_t nfilters = 0;
+    for (size_t i = 0; writer->changed_paths && i < n; i++)
+        nfilters += writer->entries[i].filter_len;
+
+    // OIDF, OIDL and CDAT come first, followed by the optional chunks
+    uint32_t ids[6] = {GRAPH_CHUNK_OIDF, GRAPH_CHUNK_OIDL, GRAPH_CHUNK_CDAT};
+    size_t sizes[6] = {GRAPH_FANOUT_SIZE, n * GIT_OID_RAWSZ, n * GRAPH_CDAT_SIZE};
+    size_t nchunks = 3, edge_chunk = 0, bloom_chunk = 0;
+    if (nedges) {
+        edge_chunk = nchunks;
+        ids[nchunks] = GRAPH_CHUNK_EDGE;
+        sizes[nchunks++] = nedges * 4;
+    }
+    if (writer->changed_paths) {
+        bloom_chunk = nchunks;
+        ids[nchunks] = GRAPH_CHUNK_BIDX;
+        sizes[nchunks++] = n * 4;
+        ids[nchunks] = GRAPH_CHUNK_BDAT;
+        sizes[nchunks++] = BLOOM_HEADER_SIZE + nfilters;
+    }
+
+    size_t size = GRAPH_HEADER_SIZE + (nchunks + 1) * GRAPH_CHUNK_ENTRY_SIZE;
+    size_t offsets[7];
+    for (size_t i = 0; i < nchunks; i++) {
+        offsets[i] = size;
+        size += sizes[i];
+    }
+    offsets[nchunks] = size;
+    size += GIT_OID_RAWSZ;
+
+    unsigned char *data = malloc(size);
+    if (!data)
+        return false;
+
+    put_be32(data, GRAPH_SIGNATURE);
+    data[4] = GRAPH_VERSION;
+    data[5] = GRAPH_HASH_SHA1;
+    data[6] = nchunks;
+    data[7] = 0;
+    for (size_t i = 0; i <= nchunks; i++) {
+        unsigned char *entry = data + GRAPH_HEADER_SIZE + i * GRAPH_CHUNK_ENTRY_SIZE;
+        put_be32(entry, i < nchunks ? ids[i] : 0);
+        put_be64(entry + 4, offsets[i]);
+    }
+
+    unsigned char *fanout = data + offsets[0];
+    for (size_t byte = 0, i = 0; byte < 256; byte++) {
+        while (i < n && writer->entries[i].id.id[0] <= byte)
+            i++;
+        put_be32(fanout + 4 * byte, i);
+    }
+
+    unsigned char *oids = data + offsets[1], *cdat = data + offsets[2];
+    unsigned char *edges = nedges ? data + offsets[edge_chunk] : NULL;
+    size_t edge = 0;
+    for (size_t i = 0; i < n; i++, cdat += GRAPH_CDAT_SIZE) {
+        const graph_entry *entry = &writer->entries[i];
+        const uint32_t *parents = writer->parent_pos + entry->parents;
+        memcpy(oids + i * GIT_OID_RAWSZ, entry->id.id, GIT_OID_RAWSZ);
+        memcpy(cdat, entry->tree_id.id, GIT_OID_RAWSZ);
+
+        put_be32(cdat + GIT_OID_RAWSZ, entry->nparents ? parents[0] : GRAPH_PARENT_NONE);
+        if (entry->nparents < 2)
+            put_be32(cdat + GIT_OID_RAWSZ + 4, GRAPH_PARENT_NONE);
+        else if (entry->nparents == 2)
+            put_be32(cdat + GIT_OID_RAWSZ + 4, parents[1]);
+        else {
+            put_be32(cdat + GIT_OID_RAWSZ + 4, GRAPH_EXTRA_EDGES | edge);
+            for (size_t j = 1; j < entry->nparents; j++, edge++)
+                put_be32(edges + 4 * edge,
+                         parents[j] | (j == entry->nparents - 1 ? GRAPH_LAST_EDGE : 0));
+        }
+
+        int64_t time = entry->time < 0 ? 0 : entry->time > GRAPH_TIME_MAX ? GRAPH_TIME_MAX : entry->time;
+        put_be64(cdat + GIT_OID_RAWSZ + 8, (uint64_t) generations[i] << 34 | (uint64_t) time);
+    }
+
+    if (writer->changed_paths) {
+        unsigned char *bidx = data + offsets[bloom_chunk], *bdat = data + offsets[bloom_chunk + 1];
+        put_be32(bdat, BLOOM_VERSION);
+        put_be32(bdat + 4, BLOOM_NUM_HASHES);
+        put_be32(bdat + 8, BLOOM_BITS_PER_ENTRY);
+        size_t end = 0;
+        for (size_t i = 0; i < n; i++) {
+            const graph_entry *entry = &writer->entries[i];
+            memcpy(bdat + BLOOM_HEADER_SIZE + end, entry->filter, entry->filter_len);
+            end += entry->filter_len;
+            put_be32(bidx + 4 * i, end);
+        }
+    }
+
+    egit_sha1_ctx ctx;
+    egit_sha1_init(&ctx);
+    egit_sha1_update(&ctx, data, size - GIT_OID_RAWSZ);
+    egit_sha1_final(data + size - GIT_OID_RAWSZ, &ctx);
+
+    *out = data;
+    *out_size = size;
+    return true;
+}
+
+/**
+ * Write DATA to PATH through a lock file, the way git replaces files.
+ */
+static int graph_write_file(const char *path, const unsigned char *data, size_t size)
+{
+    char lock[strlen(path) + sizeof(".lock")];
+    strcpy(lock, path);
+    strcat(lock, ".lock");
+
+    // Like git, never touch a lock that someone else holds, and leave
+    // the file read-only
+#ifdef _WIN32
+    int fd = open(lock, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0444);
+#else
+    int fd = open(lock, O_WRONLY | O_CREAT | O_EXCL, 0444);
+#endif
+    if (fd < 0 && errno == EEXIST) {
+        giterr_set_str(GITERR_OS, "Commit-graph lock file exists; is another git process running?");
+        return GIT_ELOCKED;
+    }
+    FILE *file = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (!file) {
+        if (fd >= 0) {
+            close(fd);
+            remove(lock);
+        }
+        giterr_set_str(GITERR_OS, "Failed to create commit-graph lock file");
+        return -1;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = !fclose(file) && ok;
+
+#ifdef _WIN32
+    if (ok) {
+        chmod(path, 0666);
+        remove(path);
+    }
+#endif
+    if (!ok || rename(lock, path)) {
+        remove(lock);
+        giterr_set_str(GITERR_OS, "Failed to write commit-graph file");
+        return -1;
+    }
+    return 0;
+}
+
+static void graph_writer_dispose(graph_writer *writer)
+{
+    for (size_t i = 0; i < writer->nentries; i++)
+        free(writer->entries[i].filter);
+    egit_oidmap_dispose(&writer->seen);
+    free(writer->entries);
+    free(writer->parent_ids);
+    free(writer->parent_pos);
+    free(writer->stack);
+}
+
+static int graph_write(size_t *count, git_repository *repo, bool changed_paths)
+{
+    if (git_repository_is_shallow(repo)) {
+        giterr_set_str(GITERR_REPOSITORY, "Cannot write a commit-graph file for a shallow repository");
+        return -1;
+    }
+
+    char *path = graph_path(repo);
+    if (!path) {
+        giterr_set_oom();
+        return -1;
+    }
+
+    graph_writer writer;
+    memset(&writer, 0, sizeof(graph_writer));
+    writer.repo = repo;
+    writer.old = graph_cache_lookup(repo);
+    writer.changed_paths = changed_paths || (writer.old && writer.old->bloom_index);
+
+    uint32_t *generations = NULL;
+    unsigned char *data = NULL;
+    size_t size;
+
+    int retval = graph_writer_push_tips(&writer);
+    while (!retval && writer.nstack) {
+        git_oid id;
+        git_oid_cpy(&id, &writer.stack[--writer.nstack]);
+        retval = graph_writer_add(&writer, &id);
+    }
+    if (retval || !writer.nentries)
+        goto cleanup;
+
+    qsort(writer.entries, writer.nentries, sizeof(graph_entry), compare_graph_entries);
+    writer.parent_pos = malloc((writer.nparents ? writer.nparents : 1) * sizeof(uint32_t));
+    generations = calloc(writer.nentries, sizeof(uint32_t));
+    if (!writer.parent_pos || !generations) {
+        giterr_set_oom();
+        retval = -1;
+        goto cleanup;
+    }
+    graph_writer_resolve_parents(&writer);
+
+    if (writer.changed_paths && (retval = graph_writer_filters(&writer)))
+        goto cleanup;
+    if (!graph_writer_generations(&writer, generations) ||
+        !graph_writer_serialize(&writer, generations, &data, &size)) {
+        giterr_set_oom();
+        retval = -1;
+        goto cleanup;
+    }
+
+    retval = graph_write_file(path, data, size);
+
+cleanup:
+    *count = retval ? 0 : writer.nentries;
+    graph_writer_dispose(&writer);
+    free(generations);
+    free(data);
+
+    // The old graph may have been replaced, so stop trusting the cache
+    graph_cache_entry *entry = graph_cache_find(path);
+    if (entry)
+        graph_cache_clear(entry);
+    free(path);
+    return retval;
+}
+
+EGIT_DOC(commit_graph_generation, "REPO ID",
+         "Return the generation number of the commit ID in the commit-graph file of REPO.\n"
+         "Returns nil if REPO has no usable commit-graph file, or if ID is not in it.");
+emacs_value egit_commit_graph_generation(emacs_env *env, emacs_value _repo, emacs_value _id)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_id);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+    git_oid id;
+    EGIT_EXTRACT_OID(_id, id);
+
+    egit_commit_graph *graph = egit_commit_graph_get(repo);
+    uint32_t pos;
+    if (!graph || !egit_commit_graph_find(graph, &id, &pos))
+        return esym_nil;
+    return EM_INTEGER(egit_commit_graph_level(graph, pos));
+}
+
+EGIT_DOC(commit_graph_write, "REPO &optional CHANGED-PATHS",
+         "Write the commit-graph file of REPO for all commits reachable from its references.\n"
+         "Commits that are already in an existing commit-graph file are copied from it\n"
+         "instead of being read from the object database, so refreshing the file after\n"
+         "new commits only reads those.  Returns the number of commits written.\n\n"
+         "If CHANGED-PATHS is non-nil, or the existing file has them, also write\n"
+         "changed-path Bloom filters in the format git uses.  Computing them takes a\n"
+         "diff per new commit, which is spread over all CPUs.\n\n"
+         "While the file exists, `libgit-graph-ahead-behind', `libgit-graph-descendant-p'\n"
+         "and `libgit-merge-base' use it instead of parsing commits, and `libgit-log-path'\n"
+         "uses the Bloom filters to skip commits.");
+emacs_value egit_commit_graph_write(emacs_env *env, emacs_value _repo, emacs_value changed_paths)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    size_t count;
+    int retval = graph_write(&count, repo, EM_EXTRACT_BOOLEAN(changed_paths));
+    EGIT_CHECK_ERROR(retval);
+    return EM_INTEGER(count);
+}
@@ -0,0 +1,100 @@
+#include "egit.h"
+
+#ifndef EGIT_COMMIT_GRAPH_H
+#define EGIT_COMMIT_GRAPH_H
+
+/**
+ * A parsed .git/objects/info/commit-graph file.  Commits are addressed by
+ * their position in the file, which is the order of their IDs.
+ */
+typedef struct egit_commit_graph egit_commit_graph;
+
+/**
+ * Return the commit graph of REPO, or NULL if it has none.
+ * Graphs are cached and reloaded when the file changes, so the pointer is
+ * only valid until the next call unless retained.  Files without generation numbers, or
+ * that fail to parse, are ignored.
+ */
+egit_commit_graph *egit_commit_graph_get(git_repository *repo);
+
+/**
+ * Keep GRAPH, which may be NULL, valid past the next call to
+ * egit_commit_graph_get, until a matching egit_commit_graph_release.
+ * @return GRAPH.
+ */
+egit_commit_graph *egit_commit_graph_retain(egit_commit_graph *graph);
+void egit_commit_graph_release(egit_commit_graph *graph);
+
+/**
+ * Find the position of the commit ID in GRAPH.
+ * @return Whether the commit is in the graph.
+ */
+bool egit_commit_graph_find(const egit_commit_graph *graph, const git_oid *id, uint32_t *pos);
+
+uint32_t egit_commit_graph_count(const egit_commit_graph *graph);
+void egit_commit_graph_id(git_oid *out, const egit_commit_graph *graph, uint32_t pos);
+void egit_commit_graph_tree_id(git_oid *out, const egit_commit_graph *graph, uint32_t pos);
+
+/**
+ * Return the generation number of the commit at POS, which is one more
+ * than the highest generation number of its parents.
+ */
+uint32_t egit_commit_graph_level(const egit_commit_graph *graph, uint32_t pos);
+int64_t egit_commit_graph_time(const egit_commit_graph *graph, uint32_t pos);
+
+/**
+ * Store the positions of up to MAX parents of the commit at POS in OUT.
+ * @return The number of parents, which may be larger than MAX.
+ */
+size_t egit_commit_graph_parents(const egit_commit_graph *graph, uint32_t pos,
+                                 uint32_t *out, size_t max);
+
+/**
+ * Consult the changed-path Bloom filter of the commit at POS, which
+ * records the paths that changed relative to its first parent.
+ * @return 0 if PATH certainly did not change, 1 if it may have changed,
+ *         or -1 if there is no filter for the commit.
+ */
+int egit_commit_graph_maybe_changed(const egit_commit_graph *graph, uint32_t pos, const char *path);
+
+/**
+ * Like git_graph_ahead_behind, for two commits in GRAPH.
+ */
+int egit_commit_graph_ahead_behind(size_t *ahead, size_t *behind, const egit_commit_graph *graph,
+                                   uint32_t local, uint32_t upstream);
+
+/**
+ * Like egit_commit_graph_ahead_behind for many pairs of commits at once,
+ * with one walk.  PAIRS holds NPAIRS pairs of indices into TIPS, the
+ * local commit first, and the counts of pair I go to AHEAD[I] and BEHIND[I].
+ */
+int egit_commit_graph_ahead_behind_many(size_t *ahead, size_t *behind, const egit_commit_graph *graph,
+                                        const uint32_t *tips, size_t ntips,
+                                        const size_t *pairs, size_t npairs);
+
+/**
+ * Add one commit to the counts of egit_commit_graph_ahead_behind_many.
+ * MARK is a bitmap over the tips that reach the commit, and a pair
+ * counts it when exactly one of its two tips does.
+ */
+void egit_commit_graph_count_pairs(size_t *ahead, size_t *behind, const unsigned char *mark,
+                                   const size_t *pairs, size_t npairs);
+
+/**
+ * Like git_graph_descendant_of, for two commits in GRAPH.
+ */
+int egit_commit_graph_descendant_of(const egit_commit_graph *graph, uint32_t commit, uint32_t ancestor);
+
+/**
+ * Like git_merge_base_many, for commits in GRAPH.  Only a unique merge
+ * base is found, since libgit2 may pick another one of several.
+ * @return 0, GIT_ENOTFOUND if there is no merge base, GIT_EAMBIGUOUS if
+ *         there is more than one, or -1 on failure.
+ */
+int egit_commit_graph_merge_base(uint32_t *out, const egit_commit_graph *graph,
+                                 const uint32_t *commits, size_t n);
+
+EGIT_DEFUN(commit_graph_generation, emacs_value _repo, emacs_value _id);
+EGIT_DEFUN(commit_graph_write, emacs_value _repo, emacs_value changed_paths);
+
+#endif /* EGIT_COMMIT_GRAPH_H */
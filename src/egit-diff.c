@@ -1,6 +1,7 @@
 #include <string.h>
 
 #include "git2.h"
+#include "git2/sys/hashsig.h"
 
 #include "egit.h"
 #include "egit-options.h"
@@ -159,6 +160,566 @@ static void egit_diff_options_release(git_diff_options *opts)
 }
 
 
+// =============================================================================
+// Helpers - Diff cache
+
+// Tree-to-tree diffs are shared between callers.  The cache owns a private
+// wrapper for each diff, and every caller gets a wrapper of its own whose
+// parent is the private one.  Such a wrapper shares the git_diff of its
+// parent until it is modified, see diff_cache_unshare.
+// Entries are kept in a doubly linked list in LRU order, most recent first.
+typedef struct diff_cache_entry_s diff_cache_entry;
+
+struct diff_cache_entry_s {
+    char *repo_path;
+    git_oid old_id;
+    git_oid new_id;
+    uint64_t options_hash;
+    git_diff_options options;
+    egit_object *diff_wrapper;
+    char *patch;
+    size_t patch_size;
+    size_t cost;
+    diff_cache_entry *prev;
+    diff_cache_entry *next;
+};
+
+static struct {
+    diff_cache_entry *head;
+    diff_cache_entry *tail;
+    size_t nentries;
+    size_t size;
+    size_t budget;
+    intmax_t hits;
+    intmax_t misses;
+} diff_cache = {NULL, NULL, 0, 0, 32 * 1024 * 1024, 0, 0};
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char*) data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t diff_cache_hash_options(const git_diff_options *opts)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = fnv1a(hash, &opts->flags, sizeof(opts->flags));
+    hash = fnv1a(hash, &opts->ignore_submodules, sizeof(opts->ignore_submodules));
+    hash = fnv1a(hash, &opts->context_lines, sizeof(opts->context_lines));
+    hash = fnv1a(hash, &opts->interhunk_lines, sizeof(opts->interhunk_lines));
+    hash = fnv1a(hash, &opts->id_abbrev, sizeof(opts->id_abbrev));
+    hash = fnv1a(hash, &opts->max_size, sizeof(opts->max_size));
+    for (size_t i = 0; i < opts->pathspec.count; i++)
+        hash = fnv1a(hash, opts->pathspec.strings[i], strlen(opts->pathspec.strings[i]) + 1);
+    hash = fnv1a(hash, "\0", 1);
+    if (opts->old_prefix)
+        hash = fnv1a(hash, opts->old_prefix, strlen(opts->old_prefix));
+    hash = fnv1a(hash, "\0", 1);
+    if (opts->new_prefix)
+        hash = fnv1a(hash, opts->new_prefix, strlen(opts->new_prefix));
+    return hash;
+}
+
+static bool diff_cache_string_equal(const char *a, const char *b)
+{
+    return a == b || (a && b && !strcmp(a, b));
+}
+
+static bool diff_cache_options_equal(const git_diff_options *a, const git_diff_options *b)
+{
+    if (a->flags != b->flags ||
+        a->ignore_submodules != b->ignore_submodules ||
+        a->context_lines != b->context_lines ||
+        a->interhunk_lines != b->interhunk_lines ||
+        a->id_abbrev != b->id_abbrev ||
+        a->max_size != b->max_size ||
+        a->pathspec.count != b->pathspec.count ||
+        !diff_cache_string_equal(a->old_prefix, b->old_prefix) ||
+        !diff_cache_string_equal(a->new_prefix, b->new_prefix))
+        return false;
+    for (size_t i = 0; i < a->pathspec.count; i++)
+        if (strcmp(a->pathspec.strings[i], b->pathspec.strings[i]))
+            return false;
+    return true;
+}
+
+// Rough estimate of the memory held by a diff.
+static size_t diff_cache_cost(git_diff *diff)
+{
+    size_t cost = 256;
+    size_t ndeltas = git_diff_num_deltas(diff);
+    for (size_t i = 0; i < ndeltas; i++) {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        cost += sizeof(git_diff_delta) + 64;
+        if (delta->old_file.path)
+            cost += strlen(delta->old_file.path) + 1;
+        if (delta->new_file.path && delta->new_file.path != delta->old_file.path)
+            cost += strlen(delta->new_file.path) + 1;
+    }
+    return cost;
+}
+
+static void diff_cache_unlink(diff_cache_entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        diff_cache.head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        diff_cache.tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void diff_cache_push_front(diff_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = diff_cache.head;
+    if (diff_cache.head)
+        diff_cache.head->prev = entry;
+    diff_cache.head = entry;
+    if (!diff_cache.tail)
+        diff_cache.tail = entry;
+}
+
+static void diff_cache_remove(diff_cache_entry *entry)
+{
+    diff_cache_unlink(entry);
+    diff_cache.nentries--;
+    diff_cache.size -= entry->cost;
+
+    // Drop our reference; the diff survives as long as Emacs holds it
+    egit_finalize(entry->diff_wrapper);
+    egit_diff_options_release(&entry->options);
+    free(entry->repo_path);
+    free(entry->patch);
+    free(entry);
+}
+
+static void diff_cache_trim(size_t budget)
+{
+    while (diff_cache.tail && diff_cache.size > budget)
+        diff_cache_remove(diff_cache.tail);
+}
+
+static diff_cache_entry *diff_cache_lookup(
+    const char *repo_path, const git_oid *old_id, const git_oid *new_id,
+    uint64_t options_hash, const git_diff_options *options)
+{
+    for (diff_cache_entry *entry = diff_cache.head; entry; entry = entry->next) {
+        if (entry->options_hash == options_hash &&
+            git_oid_equal(&entry->old_id, old_id) &&
+            git_oid_equal(&entry->new_id, new_id) &&
+            !strcmp(entry->repo_path, repo_path) &&
+            diff_cache_options_equal(&entry->options, options)) {
+            diff_cache_unlink(entry);
+            diff_cache_push_front(entry);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static diff_cache_entry *diff_cache_find_diff(git_diff *diff)
+{
+    for (diff_cache_entry *entry = diff_cache.head; entry; entry = entry->next)
+        if (entry->diff_wrapper->ptr == diff)
+            return entry;
+    return NULL;
+}
+
+// Add DIFF to the cache.  On success, the cache takes over OPTIONS and
+// returns the wrapper that owns DIFF; callers get wrappers of their own with
+// that as parent.  Otherwise NULL is returned.
+static egit_object *diff_cache_insert(
+    const char *repo_path, const git_oid *old_id, const git_oid *new_id, uint64_t options_hash,
+    git_diff_options *options, git_diff *diff, egit_object *repo_wrapper)
+{
+    size_t cost = diff_cache_cost(diff) + sizeof(diff_cache_entry) + strlen(repo_path);
+    if (cost > diff_cache.budget)
+        return NULL;
+
+    diff_cache_entry *entry = (diff_cache_entry*) malloc(sizeof(diff_cache_entry));
+    egit_object *wrapper = (egit_object*) malloc(sizeof(egit_object));
+    if (!entry || !wrapper) {
+        free(entry);
+        free(wrapper);
+        return NULL;
+    }
+    wrapper->type = EGIT_DIFF;
+    wrapper->refcount = 1;
+    wrapper->ptr = diff;
+    wrapper->parent = repo_wrapper;
+    repo_wrapper->refcount++;
+
+    entry->repo_path = strdup(repo_path);
+    git_oid_cpy(&entry->old_id, old_id);
+    git_oid_cpy(&entry->new_id, new_id);
+    entry->options_hash = options_hash;
+    entry->options = *options;
+    free(entry->options.payload);
+    entry->options.payload = NULL;
+    entry->options.notify_cb = NULL;
+    entry->options.progress_cb = NULL;
+    entry->diff_wrapper = wrapper;
+    entry->patch = NULL;
+    entry->patch_size = 0;
+    entry->cost = cost;
+
+    diff_cache_push_front(entry);
+    diff_cache.nentries++;
+    diff_cache.size += cost;
+    diff_cache_trim(diff_cache.budget);
+    return wrapper;
+}
+
+// Give WRAPPER a private copy of a diff it shares with the cache, so that it
+// can be modified in place.  The copy is made by running the diff again.
+static int diff_cache_unshare(egit_object *wrapper)
+{
+    egit_object *owner = wrapper->parent;
+    if (!owner || owner->type != EGIT_DIFF || owner->ptr != wrapper->ptr)
+        return 0;
+
+    diff_cache_entry *entry = diff_cache_find_diff(owner->ptr);
+    if (!entry) {
+        // Evicted, so nobody else can get hold of it anymore
+        if (owner->refcount == 1)
+            return 0;
+        giterr_set_str(GITERR_INVALID,
+                       "diff is shared with other callers and is no longer cached");
+        return GIT_ERROR;
+    }
+
+    git_repository *repo = owner->parent->ptr;
+    git_tree *old_tree = NULL, *new_tree = NULL;
+    git_diff *diff = NULL;
+    int retval = 0;
+    if (!git_oid_iszero(&entry->old_id))
+        retval = git_tree_lookup(&old_tree, repo, &entry->old_id);
+    if (!retval && !git_oid_iszero(&entry->new_id))
+        retval = git_tree_lookup(&new_tree, repo, &entry->new_id);
+    if (!retval)
+        retval = git_diff_tree_to_tree(&diff, repo, old_tree, new_tree, &entry->options);
+    git_tree_free(old_tree);
+    git_tree_free(new_tree);
+    if (retval)
+        return retval;
+
+    // The shared diff stays alive through the parent, in case there are
+    // deltas that point into it
+    wrapper->ptr = diff;
+    return 0;
+}
+
+
+// =============================================================================
+// Helpers - Similarity
+
+// Blob signatures shared between calls to `libgit-diff-find-similar', keyed
+// by OID.  There is one map for each set of hashsig options.  Signatures are
+// borrowed by libgit2 while a call is in progress, so maps that have grown
+// past the limit are only flushed at the start of a call.
+#define SIGNATURE_CACHE_LIMIT 16384
+#define SIGNATURE_CACHE_MAPS 8
+
+static egit_oidmap signature_cache[SIGNATURE_CACHE_MAPS];
+
+static void signature_cache_flush(egit_oidmap *map)
+{
+    for (size_t i = 0; i < map->alloc; i++)
+        if (map->used[i] && map->values[i])
+            git_hashsig_free(map->values[i]);
+    egit_oidmap_dispose(map);
+}
+
+typedef struct {
+    egit_oidmap *cache;
+    git_hashsig_option_t opts;
+    uint64_t deadline;
+    bool exceeded;
+} similarity_ctx;
+
+// Signature handed to libgit2, which owns the hashsig unless it is cached.
+typedef struct {
+    git_hashsig *sig;
+    bool owned;
+} similarity_sig;
+
+// Signature of files that are not compared, e.g. past the budget.  libgit2
+// asks again for every pair when it gets no signature, so this stands in.
+static similarity_sig similarity_skipped = {NULL, false};
+
+static bool similarity_over_budget(similarity_ctx *ctx)
+{
+    if (!ctx->exceeded && ctx->deadline && egit_clock_ms() >= ctx->deadline)
+        ctx->exceeded = true;
+    return ctx->exceeded;
+}
+
+static int similarity_wrap(void **out, similarity_ctx *ctx, const git_diff_file *file,
+                           git_hashsig *sig, bool cached)
+{
+    similarity_sig *s = (similarity_sig*) malloc(sizeof(similarity_sig));
+    if (!s) {
+        if (!cached)
+            git_hashsig_free(sig);
+        giterr_set_oom();
+        return -1;
+    }
+    s->sig = sig;
+    s->owned = !cached;
+
+    if (!cached && (file->flags & GIT_DIFF_FLAG_VALID_ID)) {
+        void **slot = egit_oidmap_put(ctx->cache, &file->id, NULL);
+        if (slot && !*slot) {
+            *slot = sig;
+            s->owned = false;
+        }
+    }
+
+    *out = s;
+    return 0;
+}
+
+static int similarity_file_signature(
+    void **out, const git_diff_file *file, const char *fullpath, void *payload)
+{
+    similarity_ctx *ctx = (similarity_ctx*) payload;
+    *out = NULL;
+
+    git_hashsig *sig = NULL;
+    if (file->flags & GIT_DIFF_FLAG_VALID_ID)
+        sig = egit_oidmap_get(ctx->cache, &file->id);
+    if (sig)
+        return similarity_wrap(out, ctx, file, sig, true);
+    if (similarity_over_budget(ctx)) {
+        *out = &similarity_skipped;
+        return 0;
+    }
+
+    int retval = git_hashsig_create_fromfile(&sig, fullpath, ctx->opts);
+    if (retval == GIT_EBUFS) {
+        giterr_clear();
+        *out = &similarity_skipped;
+        return 0;
+    }
+    if (retval)
+        return retval;
+    return similarity_wrap(out, ctx, file, sig, false);
+}
+
+static int similarity_buffer_signature(
+    void **out, const git_diff_file *file, const char *buf, size_t buflen, void *payload)
+{
+    similarity_ctx *ctx = (similarity_ctx*) payload;
+    *out = NULL;
+
+    git_hashsig *sig = NULL;
+    if (file->flags & GIT_DIFF_FLAG_VALID_ID)
+        sig = egit_oidmap_get(ctx->cache, &file->id);
+    if (sig)
+        return similarity_wrap(out, ctx, file, sig, true);
+    if (similarity_over_budget(ctx)) {
+        *out = &similarity_skipped;
+        return 0;
+    }
+
+    int retval = git_hashsig_create(&sig, buf, buflen, ctx->opts);
+    if (retval == GIT_EBUFS) {
+        giterr_clear();
+        *out = &similarity_skipped;
+        return 0;
+    }
+    if (retval)
+        return retval;
+    return similarity_wrap(out, ctx, file, sig, false);
+}
+
+static void similarity_free_signature(void *_sig, __attribute__((unused)) void *payload)
+{
+    similarity_sig *sig = (similarity_sig*) _sig;
+    if (!sig || sig == &similarity_skipped)
+        return;
+    if (sig->owned)
+        git_hashsig_free(sig->sig);
+    free(sig);
+}
+
+static int similarity_compare(int *score, void *siga, void *sigb, void *payload)
+{
+    similarity_ctx *ctx = (similarity_ctx*) payload;
+
+    // Past the budget, only exact OID matches (scored by libgit2) remain
+    similarity_sig *a = (similarity_sig*) siga, *b = (similarity_sig*) sigb;
+    if (a == &similarity_skipped || b == &similarity_skipped || similarity_over_budget(ctx)) {
+        *score = 0;
+        return 0;
+    }
+
+    int result = git_hashsig_compare(a->sig, b->sig);
+    if (result < 0)
+        return result;
+    *score = result;
+    return 0;
+}
+
+/**
+ * Return the signature cache for the find FLAGS, and set OPTS to the
+ * matching hashsig options.
+ */
+static egit_oidmap *signature_cache_get(git_hashsig_option_t *opts, uint32_t flags)
+{
+    // Same whitespace handling as the default libgit2 metric
+    if (flags & GIT_DIFF_FIND_IGNORE_WHITESPACE)
+        *opts = GIT_HASHSIG_IGNORE_WHITESPACE;
+    else if (flags & GIT_DIFF_FIND_DONT_IGNORE_WHITESPACE)
+        *opts = GIT_HASHSIG_NORMAL;
+    else
+        *opts = GIT_HASHSIG_SMART_WHITESPACE;
+    *opts |= GIT_HASHSIG_ALLOW_SMALL_FILES;
+
+    egit_oidmap *cache = &signature_cache[*opts % SIGNATURE_CACHE_MAPS];
+    if (cache->count > SIGNATURE_CACHE_LIMIT)
+        signature_cache_flush(cache);
+    return cache;
+}
+
+int egit_diff_find_similar_cached(git_diff *diff, git_diff_find_options *opts)
+{
+    if (opts->flags & GIT_DIFF_FIND_EXACT_MATCH_ONLY)
+        return git_diff_find_similar(diff, opts);
+
+    similarity_ctx ctx = {NULL, 0, 0, false};
+    ctx.cache = signature_cache_get(&ctx.opts, opts->flags);
+    git_diff_similarity_metric metric = {
+        &similarity_file_signature,
+        &similarity_buffer_signature,
+        &similarity_free_signature,
+        &similarity_compare,
+        &ctx
+    };
+
+    opts->metric = &metric;
+    int retval = git_diff_find_similar(diff, opts);
+    opts->metric = NULL;
+    return retval;
+}
+
+typedef struct {
+    const char *repo_path;
+    git_oid *ids;
+    git_hashsig **sigs;
+    git_hashsig_option_t opts;
+    uint64_t deadline;
+} precompute_ctx;
+
+// Each worker thread has its own repository handle.
+static void *precompute_init(void *payload)
+{
+    precompute_ctx *ctx = (precompute_ctx*) payload;
+    git_repository *repo;
+    if (git_repository_open(&repo, ctx->repo_path))
+        return NULL;
+    return repo;
+}
+
+static void precompute_cleanup(void *state, __attribute__((unused)) void *payload)
+{
+    git_repository_free(state);
+}
+
+static int precompute_one(size_t index, void *state, void *payload)
+{
+    precompute_ctx *ctx = (precompute_ctx*) payload;
+    if (!state || (ctx->deadline && egit_clock_ms() >= ctx->deadline))
+        return 1;
+
+    // Errors are not reported from here; the signature is then computed
+    // again on the main thread, where errors can be signaled
+    git_blob *blob;
+    if (git_blob_lookup(&blob, state, &ctx->ids[index]))
+        return 0;
+    if (git_hashsig_create(&ctx->sigs[index], git_blob_rawcontent(blob),
+                           git_blob_rawsize(blob), ctx->opts))
+        ctx->sigs[index] = NULL;
+    git_blob_free(blob);
+    return 0;
+}
+
+static void precompute_add(egit_oidmap *seen, git_oid **ids, size_t *nids, size_t *alloc,
+                           const egit_oidmap *cache, const git_diff_file *file)
+{
+    if (!(file->flags & GIT_DIFF_FLAG_VALID_ID) || (file->mode & 0170000) != 0100000)
+        return;
+    if (egit_oidmap_get(cache, &file->id))
+        return;
+
+    bool existed;
+    void **slot = egit_oidmap_put(seen, &file->id, &existed);
+    if (!slot || existed)
+        return;
+
+    if (*nids == *alloc) {
+        size_t new_alloc = *alloc ? 2 * *alloc : 64;
+        git_oid *new_ids = (git_oid*) realloc(*ids, new_alloc * sizeof(git_oid));
+        if (!new_ids)
+            return;
+        *ids = new_ids;
+        *alloc = new_alloc;
+    }
+    git_oid_cpy(&(*ids)[(*nids)++], &file->id);
+}
+
+/**
+ * Compute the signatures of the blobs in DIFF that may take part in
+ * rename or copy detection, using NTHREADS threads, and store them in the
+ * cache of CTX.  Stops at the deadline of CTX.
+ */
+static void precompute_signatures(git_diff *diff, const char *repo_path, size_t nthreads,
+                                  similarity_ctx *ctx)
+{
+    egit_oidmap seen = {0};
+    git_oid *ids = NULL;
+    size_t nids = 0, alloc = 0;
+
+    size_t ndeltas = git_diff_num_deltas(diff);
+    for (size_t i = 0; i < ndeltas; i++) {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        if (delta->status == GIT_DELTA_DELETED || delta->status == GIT_DELTA_MODIFIED)
+            precompute_add(&seen, &ids, &nids, &alloc, ctx->cache, &delta->old_file);
+        if (delta->status == GIT_DELTA_ADDED || delta->status == GIT_DELTA_MODIFIED)
+            precompute_add(&seen, &ids, &nids, &alloc, ctx->cache, &delta->new_file);
+    }
+    egit_oidmap_dispose(&seen);
+
+    git_hashsig **sigs = nids ? (git_hashsig**) calloc(nids, sizeof(git_hashsig*)) : NULL;
+    if (sigs) {
+        precompute_ctx pctx = {repo_path, ids, sigs, ctx->opts, ctx->deadline};
+        egit_parallel_for(nids, nthreads, &precompute_init, &precompute_cleanup,
+                          &precompute_one, &pctx);
+
+        for (size_t i = 0; i < nids; i++) {
+            if (!sigs[i])
+                continue;
+            void **slot = egit_oidmap_put(ctx->cache, &ids[i], NULL);
+            if (slot && !*slot)
+                *slot = sigs[i];
+            else
+                git_hashsig_free(sigs[i]);
+        }
+    }
+
+    free(sigs);
+    free(ids);
+}
+
+
 // =============================================================================
 // Constructors
 
@@ -183,7 +744,8 @@ static void egit_diff_options_release(git_diff_options *opts)
         if (retval == GIT_EUSER)                             \
             return esym_nil;                                   \
         EGIT_CHECK_ERROR(retval);                            \
-        return egit_wrap(env, EGIT_DIFF, diff, NULL);        \
+        return egit_wrap(env, EGIT_DIFF, diff,               \
+                         EM_EXTRACT_USER_PTR(_repo));        \
     } while(0)
 
 EGIT_DOC(diff_index_to_index, "REPO OLD-INDEX NEW-INDEX &optional OPTS",
@@ -319,7 +881,11 @@ emacs_value egit_diff_tree_to_index(
 EGIT_DOC(diff_tree_to_tree, "REPO &optional OLD-TREE NEW-TREE OPTS",
          "Create a diff between two trees belonging to REPO.\n"
          "If OLD-TREE or NEW-TREE are nil, they default to the empty tree.\n"
-         "See `libgit-diff-index-to-index' for explanation of OPTS.");
+         "See `libgit-diff-index-to-index' for explanation of OPTS.\n\n"
+         "Unless OPTS contains callbacks, the result is cached and shared with\n"
+         "later calls with the same trees and options.  Modifying it with\n"
+         "`libgit-diff-find-similar' first makes a private copy.  See\n"
+         "`libgit-diff-cache-set-budget'.");
 emacs_value egit_diff_tree_to_tree(
     emacs_env *env, emacs_value _repo, emacs_value _old_tree,
     emacs_value _new_tree, emacs_value opts)
@@ -334,9 +900,48 @@ emacs_value egit_diff_tree_to_tree(
     git_diff_options options;
     PARSE_OPTIONS();
 
+    // Diffs with callbacks have side effects, so they bypass the cache
+    bool cacheable = diff_cache.budget > 0 && !options.notify_cb && !options.progress_cb;
+    const char *repo_path = git_repository_path(repo);
+    git_oid old_id = {{0}}, new_id = {{0}};
+    uint64_t options_hash = 0;
+
+    if (cacheable) {
+        if (old_tree)
+            git_oid_cpy(&old_id, git_tree_id(old_tree));
+        if (new_tree)
+            git_oid_cpy(&new_id, git_tree_id(new_tree));
+        options_hash = diff_cache_hash_options(&options);
+
+        diff_cache_entry *entry = diff_cache_lookup(
+            repo_path, &old_id, &new_id, options_hash, &options);
+        if (entry) {
+            diff_cache.hits++;
+            egit_diff_options_release(&options);
+            egit_object *owner = entry->diff_wrapper;
+            return egit_wrap(env, EGIT_DIFF, owner->ptr, owner);
+        }
+        diff_cache.misses++;
+    }
+
     git_diff *diff;
     int retval = git_diff_tree_to_tree(&diff, repo, old_tree, new_tree, &options);
-    FINALIZE_AND_RETURN();
+    if (retval) {
+        egit_diff_options_release(&options);
+        EM_RETURN_NIL_IF_NLE();
+        if (retval == GIT_EUSER)
+            return esym_nil;
+        EGIT_CHECK_ERROR(retval);
+    }
+
+    egit_object *owner = NULL;
+    if (cacheable)
+        owner = diff_cache_insert(repo_path, &old_id, &new_id, options_hash,
+                                  &options, diff, EM_EXTRACT_USER_PTR(_repo));
+    if (owner)
+        return egit_wrap(env, EGIT_DIFF, diff, owner);
+    egit_diff_options_release(&options);
+    return egit_wrap(env, EGIT_DIFF, diff, EM_EXTRACT_USER_PTR(_repo));
 }
 
 EGIT_DOC(diff_tree_to_workdir, "REPO &optional OLD-TREE OPTS",
@@ -821,6 +1426,19 @@ EGIT_DOC(diff_find_similar, "DIFF &optional OPTIONS",
          "    The `metric` option allows you to plug in a custom similarity\n"
          "    metric.\n"
          "\n"
+         "  - `parallel' is the number of threads used to compute file\n"
+         "    signatures for similarity scoring, at least 1, or t for one\n"
+         "    per CPU.\n"
+         "\n"
+         "  - `budget' is a non-negative time limit in milliseconds.  Once it\n"
+         "    has passed, remaining pairs of files are only matched if their\n"
+         "    contents are identical.  With a budget of 0, only identical\n"
+         "    files are matched.\n"
+         "\n"
+         "If `parallel' or `budget' is given, file signatures are cached by\n"
+         "object ID and reused by later calls.  The return value is then\n"
+         "`budget-exceeded' if the budget ran out, and t otherwise.\n"
+         "\n"
          "\n"
          "FLAGS is a list that should consists of a combination\n"
          "of the following flags:\n"
@@ -878,13 +1496,676 @@ emacs_value egit_diff_find_similar(emacs_env *env, emacs_value _diff,
                                    emacs_value _options)
 {
     EGIT_ASSERT_DIFF(_diff);
-    git_diff *diff = EGIT_EXTRACT(_diff);
+    egit_object *wrapper = EM_EXTRACT_USER_PTR(_diff);
 
     git_diff_find_options opts;
     egit_diff_find_options_parse(env, _options, &opts);
     EM_RETURN_NIL_IF_NLE();
 
-    int retval = git_diff_find_similar(diff, &opts);
+    emacs_value parallel = em_cdr(env, em_assq(env, esym_parallel, _options));
+    emacs_value budget = em_cdr(env, em_assq(env, esym_budget, _options));
+    if (!EM_EQ(parallel, esym_t))
+        EM_ASSERT_INTEGER_OR_NIL(parallel);
+    EM_ASSERT_INTEGER_OR_NIL(budget);
+    intmax_t nthreads = EM_EQ(parallel, esym_t) ? (intmax_t) egit_parallel_default_threads()
+        : EM_EXTRACT_INTEGER_OR_DEFAULT(parallel, 1);
+    intmax_t budget_ms = EM_EXTRACT_INTEGER_OR_DEFAULT(budget, 0);
+    if (nthreads < 1) {
+        em_signal_args_out_of_range(env, nthreads);
+        return esym_nil;
+    }
+    if (budget_ms < 0) {
+        em_signal_args_out_of_range(env, budget_ms);
+        return esym_nil;
+    }
+
+    // The diff is modified in place, so it may no longer be shared
+    int retval = diff_cache_unshare(wrapper);
+    EGIT_CHECK_ERROR(retval);
+    git_diff *diff = wrapper->ptr;
+
+    bool custom = EM_EXTRACT_BOOLEAN(parallel) || EM_EXTRACT_BOOLEAN(budget);
+    if (!custom || (opts.flags & GIT_DIFF_FIND_EXACT_MATCH_ONLY)) {
+        retval = git_diff_find_similar(diff, &opts);
+        EGIT_CHECK_ERROR(retval);
+        return esym_t;
+    }
+
+    git_hashsig_option_t hashsig_opts;
+    egit_oidmap *cache = signature_cache_get(&hashsig_opts, opts.flags);
+
+    // A budget of zero has run out before the first comparison
+    similarity_ctx ctx = {cache, hashsig_opts, 0, false};
+    if (budget_ms > 0)
+        ctx.deadline = egit_clock_ms() + budget_ms;
+    else if (EM_EXTRACT_BOOLEAN(budget))
+        ctx.exceeded = true;
+
+    // Diffs from the cache are owned by a private wrapper of the cache
+    egit_object *parent = wrapper->parent;
+    if (parent && parent->type == EGIT_DIFF)
+        parent = parent->parent;
+    if (nthreads > 1 && !ctx.exceeded && parent && parent->type == EGIT_REPOSITORY)
+        precompute_signatures(diff, git_repository_path(parent->ptr), nthreads, &ctx);
+
+    git_diff_similarity_metric metric = {
+        &similarity_file_signature,
+        &similarity_buffer_signature,
+        &similarity_free_signature,
+        &similarity_compare,
+        &ctx
+    };
+    opts.metric = &metric;
+
+    retval = git_diff_find_similar(diff, &opts);
     EGIT_CHECK_ERROR(retval);
-    return esym_t;
+    return similarity_over_budget(&ctx) ? esym_budget_exceeded : esym_t;
+}
+
+
+// =============================================================================
+// Refinement
+
+// A token in a refined side of a hunk, with character offsets in its line.
+typedef struct {
+    size_t line;
+    size_t start;
+    size_t end;
+    bool newline;
+    bool changed;
+} refine_token;
+
+// One side (old or new) of a change block being refined.
+typedef struct {
+    refine_token *tokens;
+    size_t ntokens;
+    size_t tokens_alloc;
+    char *text;
+    size_t text_size;
+    size_t text_alloc;
+} refine_side;
+
+static bool refine_is_word_byte(unsigned char c)
+{
+    return c >= 0x80 || c == '_' || (c >= '0' && c <= '9') ||
+        (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool refine_is_space_byte(unsigned char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool refine_push(refine_side *side, size_t line, size_t start, size_t end, bool newline,
+                        const char *text, size_t len)
+{
+    if (side->ntokens == side->tokens_alloc) {
+        size_t alloc = side->tokens_alloc ? 2 * side->tokens_alloc : 64;
+        refine_token *tokens = (refine_token*) realloc(side->tokens, alloc * sizeof(refine_token));
+        if (!tokens)
+            return false;
+        side->tokens = tokens;
+        side->tokens_alloc = alloc;
+    }
+    if (side->text_size + len + 1 > side->text_alloc) {
+        size_t alloc = side->text_alloc ? 2 * side->text_alloc : 1024;
+        while (alloc < side->text_size + len + 1)
+            alloc *= 2;
+        char *buf = (char*) realloc(side->text, alloc);
+        if (!buf)
+            return false;
+        side->text = buf;
+        side->text_alloc = alloc;
+    }
+
+    refine_token *token = &side->tokens[side->ntokens++];
+    token->line = line;
+    token->start = start;
+    token->end = end;
+    token->newline = newline;
+    token->changed = false;
+
+    // Each token becomes one line of input to xdiff
+    memcpy(side->text + side->text_size, text, len);
+    side->text_size += len;
+    side->text[side->text_size++] = '\n';
+    return true;
+}
+
+/**
+ * Split the content of a line into tokens and append them to SIDE.
+ * In word mode, a token is a run of word characters, a run of whitespace or
+ * a single other character.  In character mode, every character is a token.
+ * The line terminator is a separate token, so that changes in line structure
+ * are seen by the diff, but it is never reported as a change range.
+ */
+static bool refine_tokenize(refine_side *side, size_t line, const char *content, size_t len, bool words)
+{
+    bool eol = len > 0 && content[len-1] == '\n';
+    if (eol)
+        len--;
+
+    size_t pos = 0, chars = 0;
+    while (pos < len) {
+        const unsigned char *p = (const unsigned char*) content;
+        size_t end = pos + 1;
+
+        if (!words)
+            while (end < len && (p[end] & 0xC0) == 0x80)
+                end++;
+        else if (refine_is_word_byte(p[pos]))
+            while (end < len && refine_is_word_byte(p[end]))
+                end++;
+        else if (refine_is_space_byte(p[pos]))
+            while (end < len && refine_is_space_byte(p[end]))
+                end++;
+
+        size_t nchars = 0;
+        for (size_t i = pos; i < end; i++)
+            if ((p[i] & 0xC0) != 0x80)
+                nchars++;
+
+        if (!refine_push(side, line, chars, chars + nchars, false, content + pos, end - pos))
+            return false;
+        pos = end;
+        chars += nchars;
+    }
+
+    // The escaped form can never be produced by the tokenizer from real text
+    if (eol && !refine_push(side, line, chars, chars, true, "\\n", 2))
+        return false;
+    return true;
+}
+
+static void refine_side_reset(refine_side *side)
+{
+    side->ntokens = 0;
+    side->text_size = 0;
+}
+
+static void refine_side_dispose(refine_side *side)
+{
+    free(side->tokens);
+    free(side->text);
+}
+
+typedef struct {
+    refine_side old_side;
+    refine_side new_side;
+} refine_ctx;
+
+static int refine_line_callback(
+    __attribute__((unused)) const git_diff_delta *delta,
+    __attribute__((unused)) const git_diff_hunk *hunk,
+    const git_diff_line *line, void *payload)
+{
+    refine_ctx *ctx = (refine_ctx*) payload;
+    if (line->origin == GIT_DIFF_LINE_DELETION && line->old_lineno > 0 &&
+        (size_t) line->old_lineno <= ctx->old_side.ntokens)
+        ctx->old_side.tokens[line->old_lineno - 1].changed = true;
+    else if (line->origin == GIT_DIFF_LINE_ADDITION && line->new_lineno > 0 &&
+             (size_t) line->new_lineno <= ctx->new_side.ntokens)
+        ctx->new_side.tokens[line->new_lineno - 1].changed = true;
+    return 0;
+}
+
+/**
+ * Append the changed ranges of SIDE to OUT.
+ * Adjacent changed tokens on the same line are merged into one range.
+ * If DELTA_IDX is non-negative, every range is prefixed by DELTA_IDX and HUNK_IDX.
+ */
+static bool refine_emit(egit_intbuf *out, refine_side *side, intmax_t delta_idx, intmax_t hunk_idx)
+{
+    size_t i = 0;
+    while (i < side->ntokens) {
+        refine_token *first = &side->tokens[i];
+        if (!first->changed || first->newline) {
+            i++;
+            continue;
+        }
+
+        size_t end = first->end;
+        for (i++; i < side->ntokens; i++) {
+            refine_token *token = &side->tokens[i];
+            if (!token->changed || token->newline || token->line != first->line)
+                break;
+            end = token->end;
+        }
+
+        if (delta_idx >= 0 &&
+            (!egit_intbuf_push(out, delta_idx) || !egit_intbuf_push(out, hunk_idx)))
+            return false;
+        if (!egit_intbuf_push(out, first->line) ||
+            !egit_intbuf_push(out, first->start) ||
+            !egit_intbuf_push(out, end))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Diff the two sides of a change block token by token and emit the result.
+ */
+static int refine_block(egit_intbuf *out, refine_ctx *ctx, intmax_t delta_idx, intmax_t hunk_idx)
+{
+    if (ctx->old_side.ntokens == 0 || ctx->new_side.ntokens == 0)
+        return 0;
+
+    git_diff_options opts;
+    git_diff_init_options(&opts, GIT_DIFF_OPTIONS_VERSION);
+    opts.flags |= GIT_DIFF_FORCE_TEXT;
+    opts.context_lines = 0;
+    opts.interhunk_lines = 0;
+
+    int retval = git_diff_buffers(
+        ctx->old_side.text, ctx->old_side.text_size, NULL,
+        ctx->new_side.text, ctx->new_side.text_size, NULL,
+        &opts, NULL, NULL, NULL, &refine_line_callback, ctx);
+    if (retval)
+        return retval;
+
+    if (!refine_emit(out, &ctx->old_side, delta_idx, hunk_idx) ||
+        !refine_emit(out, &ctx->new_side, delta_idx, hunk_idx))
+        return -1;
+    return 0;
+}
+
+/**
+ * Refine a hunk of a patch, appending changed ranges to OUT.
+ * A change block is a maximal run of removed and added lines.  Blocks are
+ * refined independently, so that tokens never match across context lines.
+ */
+static int refine_hunk(egit_intbuf *out, refine_ctx *ctx, git_patch *patch, size_t hunk_idx,
+                       size_t nlines, bool words, intmax_t delta_idx)
+{
+    refine_side_reset(&ctx->old_side);
+    refine_side_reset(&ctx->new_side);
+
+    for (size_t i = 0; i < nlines; i++) {
+        const git_diff_line *line;
+        int retval = git_patch_get_line_in_hunk(&line, patch, hunk_idx, i);
+        if (retval)
+            return retval;
+
+        refine_side *side = NULL;
+        if (line->origin == GIT_DIFF_LINE_DELETION)
+            side = &ctx->old_side;
+        else if (line->origin == GIT_DIFF_LINE_ADDITION)
+            side = &ctx->new_side;
+        else if (line->origin == GIT_DIFF_LINE_CONTEXT) {
+            retval = refine_block(out, ctx, delta_idx, hunk_idx);
+            if (retval)
+                return retval;
+            refine_side_reset(&ctx->old_side);
+            refine_side_reset(&ctx->new_side);
+        }
+
+        if (side && !refine_tokenize(side, i, line->content, line->content_len, words)) {
+            giterr_set_oom();
+            return -1;
+        }
+    }
+
+    return refine_block(out, ctx, delta_idx, hunk_idx);
+}
+
+static bool refine_granularity(bool *words, emacs_env *env, emacs_value granularity)
+{
+    if (!EM_EXTRACT_BOOLEAN(granularity) || EM_EQ(granularity, esym_word))
+        *words = true;
+    else if (EM_EQ(granularity, esym_char))
+        *words = false;
+    else {
+        em_signal_wrong_value(env, granularity);
+        return false;
+    }
+    return true;
+}
+
+EGIT_DOC(diff_hunk_refine, "DELTA HUNK &optional GRANULARITY",
+         "Compute the changed ranges within the lines of HUNK.\n"
+         "DELTA and HUNK must be as passed to a hunk callback of `libgit-diff-foreach'.\n"
+         "\n"
+         "Removed and added lines are split into tokens, which are diffed\n"
+         "against each other natively.  GRANULARITY may be `word' (the default),\n"
+         "where a token is a word, a run of whitespace or a punctuation character,\n"
+         "or `char', where every character is a token.\n"
+         "\n"
+         "The return value is a flat vector of integers LINE START END ...,\n"
+         "where LINE is the zero-based index of a line in the hunk, in the order\n"
+         "given to the line callback, and START and END are character offsets\n"
+         "in its content.\n"
+         "\n"
+         "This regenerates the patch of DELTA, so to refine many hunks, use\n"
+         "`libgit-diff-refine' instead.");
+emacs_value egit_diff_hunk_refine(emacs_env *env, emacs_value _delta, emacs_value _hunk,
+                                  emacs_value _granularity)
+{
+    EGIT_ASSERT_DIFF_DELTA(_delta);
+    EGIT_ASSERT_DIFF_HUNK(_hunk);
+    bool words;
+    if (!refine_granularity(&words, env, _granularity))
+        return esym_nil;
+
+    egit_object *wrapper = EM_EXTRACT_USER_PTR(_delta);
+    if (!wrapper->parent || wrapper->parent->type != EGIT_DIFF) {
+        em_signal_wrong_value(env, _delta);
+        return esym_nil;
+    }
+    git_diff *diff = wrapper->parent->ptr;
+    git_diff_delta *delta = wrapper->ptr;
+    git_diff_hunk *hunk = EGIT_EXTRACT(_hunk);
+
+    size_t ndeltas = git_diff_num_deltas(diff), delta_idx;
+    for (delta_idx = 0; delta_idx < ndeltas; delta_idx++)
+        if (git_diff_get_delta(diff, delta_idx) == delta)
+            break;
+    if (delta_idx == ndeltas) {
+        em_signal_wrong_value(env, _delta);
+        return esym_nil;
+    }
+
+    git_patch *patch;
+    int retval = git_patch_from_diff(&patch, diff, delta_idx);
+    EGIT_CHECK_ERROR(retval);
+    if (!patch)
+        return em_integer_vector(env, NULL, 0);
+
+    egit_intbuf out = {0};
+    refine_ctx ctx;
+    memset(&ctx, 0, sizeof(refine_ctx));
+    size_t nhunks = git_patch_num_hunks(patch);
+    retval = 0;
+    bool found = false;
+
+    for (size_t i = 0; i < nhunks && !retval && !found; i++) {
+        const git_diff_hunk *h;
+        size_t nlines;
+        retval = git_patch_get_hunk(&h, &nlines, patch, i);
+        if (retval || h->old_start != hunk->old_start || h->new_start != hunk->new_start)
+            continue;
+        found = true;
+        retval = refine_hunk(&out, &ctx, patch, i, nlines, words, -1);
+    }
+
+    refine_side_dispose(&ctx.old_side);
+    refine_side_dispose(&ctx.new_side);
+    git_patch_free(patch);
+
+    if (!retval && !found) {
+        egit_intbuf_dispose(&out);
+        em_signal_wrong_value(env, _hunk);
+        return esym_nil;
+    }
+    if (retval)
+        egit_intbuf_dispose(&out);
+    EGIT_CHECK_ERROR(retval);
+
+    emacs_value ret = em_integer_vector(env, out.ptr, out.size);
+    egit_intbuf_dispose(&out);
+    return ret;
+}
+
+EGIT_DOC(diff_refine, "DIFF &optional GRANULARITY",
+         "Compute the changed ranges within the lines of every hunk in DIFF.\n"
+         "GRANULARITY is as in `libgit-diff-hunk-refine'.\n"
+         "\n"
+         "The return value is a flat vector of integers\n"
+         "DELTA HUNK LINE START END ..., where DELTA is the index of a delta\n"
+         "in DIFF, HUNK the index of a hunk in that delta, and LINE, START and\n"
+         "END are as in `libgit-diff-hunk-refine'.  Binary and unchanged\n"
+         "deltas produce no entries.");
+emacs_value egit_diff_refine(emacs_env *env, emacs_value _diff, emacs_value _granularity)
+{
+    EGIT_ASSERT_DIFF(_diff);
+    bool words;
+    if (!refine_granularity(&words, env, _granularity))
+        return esym_nil;
+    git_diff *diff = EGIT_EXTRACT(_diff);
+
+    egit_intbuf out = {0};
+    refine_ctx ctx;
+    memset(&ctx, 0, sizeof(refine_ctx));
+    size_t ndeltas = git_diff_num_deltas(diff);
+    int retval = 0;
+
+    for (size_t d = 0; d < ndeltas && !retval; d++) {
+        git_patch *patch;
+        retval = git_patch_from_diff(&patch, diff, d);
+        if (retval || !patch)
+            continue;
+
+        size_t nhunks = git_patch_num_hunks(patch);
+        for (size_t h = 0; h < nhunks && !retval; h++) {
+            const git_diff_hunk *hunk;
+            size_t nlines;
+            retval = git_patch_get_hunk(&hunk, &nlines, patch, h);
+            if (!retval)
+                retval = refine_hunk(&out, &ctx, patch, h, nlines, words, d);
+        }
+        git_patch_free(patch);
+    }
+
+    refine_side_dispose(&ctx.old_side);
+    refine_side_dispose(&ctx.new_side);
+    if (retval)
+        egit_intbuf_dispose(&out);
+    EGIT_CHECK_ERROR(retval);
+
+    emacs_value ret = em_integer_vector(env, out.ptr, out.size);
+    egit_intbuf_dispose(&out);
+    return ret;
+}
+
+
+// =============================================================================
+// Buffers
+
+static int buffer_hunk_callback(
+    __attribute__((unused)) const git_diff_delta *delta,
+    const git_diff_hunk *hunk, void *payload)
+{
+    egit_intbuf *out = (egit_intbuf*) payload;
+    char type = hunk->old_lines == 0 ? '+' : hunk->new_lines == 0 ? '-' : '!';
+    if (!egit_intbuf_push(out, type) ||
+        !egit_intbuf_push(out, hunk->old_start) ||
+        !egit_intbuf_push(out, hunk->old_lines) ||
+        !egit_intbuf_push(out, hunk->new_start) ||
+        !egit_intbuf_push(out, hunk->new_lines))
+        return -1;
+    return 0;
+}
+
+/**
+ * Diff BLOB against the text of TEXT and return the changed line ranges.
+ * BLOB may be NULL, in which case all the text is added.  If PATH is
+ * given and BLOB is not binary, the filters for PATH are applied to BLOB
+ * first, so that it matches the text as saved.
+ */
+static emacs_value buffer_diff(emacs_env *env, git_blob *blob, const char *path, emacs_value text)
+{
+    ptrdiff_t size;
+    char *buffer = em_get_text_with_size(env, text, &size, true);
+    if (!buffer)
+        return esym_nil;
+
+    // Binary blobs are compared as stored, since libgit2 would filter
+    // them to nothing
+    git_buf filtered = {NULL, 0, 0};
+    int retval = blob && path && !git_blob_is_binary(blob) ?
+        git_blob_filtered_content(&filtered, blob, path, 0) : 0;
+    if (retval) {
+        free(buffer);
+        EGIT_CHECK_ERROR(retval);
+    }
+
+    // Diff binary files line by line too, rather than reporting no changes
+    git_diff_options opts;
+    git_diff_init_options(&opts, GIT_DIFF_OPTIONS_VERSION);
+    opts.flags |= GIT_DIFF_FORCE_TEXT;
+    opts.context_lines = 0;
+    opts.interhunk_lines = 0;
+
+    egit_intbuf out = {0};
+    if (filtered.ptr)
+        retval = git_diff_buffers(filtered.ptr, filtered.size, path, buffer, size, path, &opts,
+                                  NULL, NULL, &buffer_hunk_callback, NULL, &out);
+    else
+        retval = git_diff_blob_to_buffer(blob, path, buffer, size, path, &opts,
+                                         NULL, NULL, &buffer_hunk_callback, NULL, &out);
+    git_buf_dispose(&filtered);
+    free(buffer);
+    if (retval)
+        egit_intbuf_dispose(&out);
+    EGIT_CHECK_ERROR(retval);
+
+    emacs_value ret = em_integer_vector(env, out.ptr, out.size);
+    egit_intbuf_dispose(&out);
+    return ret;
+}
+
+EGIT_DOC(diff_buffer_to_blob, "BLOB STRING-OR-BUFFER &optional PATH",
+         "Compute the changed line ranges between BLOB and STRING-OR-BUFFER.\n"
+         "If STRING-OR-BUFFER is a buffer, its accessible portion is used,\n"
+         "encoded with its `buffer-file-coding-system' as it would be saved.\n"
+         "A string is compared as UTF-8.  Nothing is written to disk.\n"
+         "\n"
+         "If PATH is given, the filters for that path, such as conversion of\n"
+         "line endings, are applied to BLOB first, as on checkout.  Otherwise\n"
+         "BLOB is compared as stored.  Binary blobs are never filtered, and\n"
+         "are compared as text.\n"
+         "\n"
+         "The return value is a flat vector of integers\n"
+         "TYPE OLD-START OLD-LINES NEW-START NEW-LINES ..., with one entry per\n"
+         "changed region.  TYPE is ?+ for added lines, ?- for removed lines\n"
+         "and ?! for modified lines.  For added and removed regions, the start\n"
+         "on the empty side is the line after which the change occurs.");
+emacs_value egit_diff_buffer_to_blob(emacs_env *env, emacs_value _blob, emacs_value text,
+                                     emacs_value _path)
+{
+    EGIT_ASSERT_BLOB(_blob);
+    EM_ASSERT_STRING_OR_NIL(_path);
+    git_blob *blob = EGIT_EXTRACT(_blob);
+    char *path = EM_EXTRACT_STRING_OR_NULL(_path);
+    emacs_value ret = buffer_diff(env, blob, path, text);
+    free(path);
+    return ret;
+}
+
+EGIT_DOC(diff_buffer_to_index, "REPO PATH STRING-OR-BUFFER",
+         "Compute the changed line ranges between PATH in the index and STRING-OR-BUFFER.\n"
+         "PATH is relative to the repository root.  If PATH is not in the\n"
+         "index, return nil.  Otherwise this is like `libgit-diff-buffer-to-blob'\n"
+         "with the blob of PATH in the index, and the filters for PATH.");
+emacs_value egit_diff_buffer_to_index(emacs_env *env, emacs_value _repo, emacs_value _path,
+                                      emacs_value text)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_path);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    git_index *index;
+    int retval = git_repository_index(&index, repo);
+    EGIT_CHECK_ERROR(retval);
+
+    char *path = EM_EXTRACT_STRING(_path);
+    const git_index_entry *entry = git_index_get_bypath(index, path, 0);
+    if (!entry) {
+        free(path);
+        git_index_free(index);
+        return esym_nil;
+    }
+
+    git_blob *blob;
+    retval = git_blob_lookup(&blob, repo, &entry->id);
+    git_index_free(index);
+    if (retval)
+        free(path);
+    EGIT_CHECK_ERROR(retval);
+
+    emacs_value ret = buffer_diff(env, blob, path, text);
+    git_blob_free(blob);
+    free(path);
+    return ret;
+}
+
+
+// =============================================================================
+// Cache
+
+EGIT_DOC(diff_to_string, "DIFF &optional FORMAT",
+         "Return the text of DIFF as a string.\n"
+         "FORMAT is as in `libgit-diff-print'.  If DIFF is cached, the text\n"
+         "in the default `patch' format is cached along with it.");
+emacs_value egit_diff_to_string(emacs_env *env, emacs_value _diff, emacs_value _format)
+{
+    EGIT_ASSERT_DIFF(_diff);
+    git_diff_format_t format;
+    if (!em_findsym_diff_format(&format, env, _format, true))
+        return esym_nil;
+    git_diff *diff = EGIT_EXTRACT(_diff);
+
+    diff_cache_entry *entry = format == GIT_DIFF_FORMAT_PATCH ? diff_cache_find_diff(diff) : NULL;
+    if (entry && entry->patch)
+        return env->make_string(env, entry->patch, entry->patch_size);
+
+    git_buf buf = {NULL, 0, 0};
+    int retval = git_diff_to_buf(&buf, diff, format);
+    EGIT_CHECK_ERROR(retval);
+
+    if (entry && entry->cost + buf.size <= diff_cache.budget) {
+        entry->patch = (char*) malloc(buf.size + 1);
+        if (entry->patch) {
+            memcpy(entry->patch, buf.ptr, buf.size);
+            entry->patch_size = buf.size;
+            entry->cost += buf.size;
+            diff_cache.size += buf.size;
+        }
+    }
+
+    emacs_value ret = env->make_string(env, buf.ptr, buf.size);
+    git_buf_dispose(&buf);
+
+    // This entry is at the front, so it is evicted last
+    diff_cache_trim(diff_cache.budget);
+    return ret;
+}
+
+EGIT_DOC(diff_cache_flush, "", "Remove all entries from the diff cache.");
+emacs_value egit_diff_cache_flush(__attribute__((unused)) emacs_env *env)
+{
+    diff_cache_trim(0);
+    return esym_nil;
+}
+
+EGIT_DOC(diff_cache_set_budget, "BYTES",
+         "Set the approximate memory budget of the diff cache to BYTES.\n"
+         "Least recently used entries are evicted to stay within the budget.\n"
+         "A budget of zero disables the cache.  The default is 32 MiB.");
+emacs_value egit_diff_cache_set_budget(emacs_env *env, emacs_value _budget)
+{
+    EM_ASSERT_INTEGER(_budget);
+    intmax_t budget = EM_EXTRACT_INTEGER(_budget);
+    if (budget < 0) {
+        em_signal_wrong_value(env, _budget);
+        return esym_nil;
+    }
+    diff_cache.budget = budget;
+    diff_cache_trim(diff_cache.budget);
+    return esym_nil;
+}
+
+EGIT_DOC(diff_cache_stats, "",
+         "Return statistics about the diff cache.\n"
+         "This is an alist with the keys `hits', `misses', `entries', `size'\n"
+         "and `budget'.  Sizes are in bytes.");
+emacs_value egit_diff_cache_stats(emacs_env *env)
+{
+    emacs_value stats[5];
+    stats[0] = em_cons(env, esym_hits, EM_INTEGER(diff_cache.hits));
+    stats[1] = em_cons(env, esym_misses, EM_INTEGER(diff_cache.misses));
+    stats[2] = em_cons(env, esym_entries, EM_INTEGER(diff_cache.nentries));
+    stats[3] = em_cons(env, esym_size, EM_INTEGER(diff_cache.size));
+    stats[4] = em_cons(env, esym_budget, EM_INTEGER(diff_cache.budget));
+    return em_list(env, stats, 5);
 }
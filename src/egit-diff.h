@@ -3,6 +3,12 @@
 #ifndef EGIT_DIFF_H
 #define EGIT_DIFF_H
 
+/**
+ * Like git_diff_find_similar, but blob signatures are taken from and added
+ * to the cache shared with `libgit-diff-find-similar'.
+ */
+int egit_diff_find_similar_cached(git_diff *diff, git_diff_find_options *opts);
+
 EGIT_DEFUN(diff_index_to_index, emacs_value _repo, emacs_value _old_index,
            emacs_value _new_index, emacs_value _opts);
 EGIT_DEFUN(diff_index_to_workdir, emacs_value _repo, emacs_value _index,
@@ -30,6 +36,7 @@ EGIT_DEFUN(diff_delta_file_exists_p, emacs_value _delta, emacs_value side);
 EGIT_DEFUN(diff_hunk_header, emacs_value _hunk);
 EGIT_DEFUN(diff_hunk_lines, emacs_value _hunk, emacs_value side);
 EGIT_DEFUN(diff_hunk_start, emacs_value _hunk, emacs_value side);
+EGIT_DEFUN(diff_hunk_refine, emacs_value _delta, emacs_value _hunk, emacs_value _granularity);
 
 EGIT_DEFUN(diff_line_origin, emacs_value _line);
 EGIT_DEFUN(diff_line_lineno, emacs_value _line, emacs_value side);
@@ -39,5 +46,14 @@ EGIT_DEFUN(diff_get_delta, emacs_value _delta, emacs_value _index);
 EGIT_DEFUN(diff_num_deltas, emacs_value _diff, emacs_value _type);
 
 EGIT_DEFUN(diff_find_similar, emacs_value _diff, emacs_value _options);
+EGIT_DEFUN(diff_refine, emacs_value _diff, emacs_value _granularity);
+
+EGIT_DEFUN(diff_buffer_to_blob, emacs_value _blob, emacs_value text, emacs_value _path);
+EGIT_DEFUN(diff_buffer_to_index, emacs_value _repo, emacs_value _path, emacs_value text);
+
+EGIT_DEFUN(diff_to_string, emacs_value _diff, emacs_value _format);
+EGIT_DEFUN_0(diff_cache_flush);
+EGIT_DEFUN(diff_cache_set_budget, emacs_value _budget);
+EGIT_DEFUN_0(diff_cache_stats);
 
 #endif /* EGIT_DIFF_H */
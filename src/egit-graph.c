@@ -1,8 +1,11 @@
+#include <stdio.h>
 #include <string.h>
 
 #include "git2.h"
 
 #include "egit.h"
+#include "egit-commit-graph.h"
+#include "egit-util.h"
 #include "interface.h"
 #include "egit-graph.h"
 
@@ -24,7 +27,14 @@ emacs_value egit_graph_ahead_behind(
     git_repository *repo = EGIT_EXTRACT(_repo);
 
     size_t ahead, behind;
-    int retval = git_graph_ahead_behind(&ahead, &behind, repo, &local, &upstream);
+    int retval;
+    egit_commit_graph *graph = egit_commit_graph_get(repo);
+    uint32_t local_pos, upstream_pos;
+    if (graph && egit_commit_graph_find(graph, &local, &local_pos) &&
+        egit_commit_graph_find(graph, &upstream, &upstream_pos))
+        retval = egit_commit_graph_ahead_behind(&ahead, &behind, graph, local_pos, upstream_pos);
+    else
+        retval = git_graph_ahead_behind(&ahead, &behind, repo, &local, &upstream);
     EGIT_CHECK_ERROR(retval);
 
     return em_cons(env, EM_INTEGER(ahead), EM_INTEGER(behind));
@@ -44,7 +54,572 @@ emacs_value egit_graph_descendant_p(
     EGIT_EXTRACT_OID(_ancestor, ancestor);
     git_repository *repo = EGIT_EXTRACT(_repo);
 
-    int retval = git_graph_descendant_of(repo, &commit, &ancestor);
+    int retval;
+    egit_commit_graph *graph = egit_commit_graph_get(repo);
+    uint32_t commit_pos, ancestor_pos;
+    if (graph && egit_commit_graph_find(graph, &commit, &commit_pos) &&
+        egit_commit_graph_find(graph, &ancestor, &ancestor_pos))
+        retval = egit_commit_graph_descendant_of(graph, commit_pos, ancestor_pos);
+    else
+        retval = git_graph_descendant_of(repo, &commit, &ancestor);
     EGIT_CHECK_ERROR(retval);
     return retval ? esym_t : esym_nil;
 }
+
+static void free_marks(egit_oidmap *marks)
+{
+    for (size_t i = 0; i < marks->alloc; i++)
+        if (marks->used[i])
+            free(marks->values[i]);
+    egit_oidmap_dispose(marks);
+}
+
+/**
+ * The same walk as egit_commit_graph_ahead_behind_many, without a commit
+ * graph.  A topological walk stands in for generation numbers, since it
+ * returns commits after all their children.
+ */
+static int ahead_behind_many_walk(size_t *ahead, size_t *behind, git_repository *repo,
+                                  const git_oid *tips, size_t ntips,
+                                  const size_t *pairs, size_t npairs)
+{
+    size_t size = (ntips + 7) / 8;
+    egit_oidmap marks = {0};
+    git_revwalk *walk = NULL;
+    unsigned char *full = calloc(size, 1);
+    int retval = 0;
+    if (!full)
+        goto oom;
+    for (size_t i = 0; i < ntips; i++)
+        full[i / 8] |= 1 << (i % 8);
+
+    for (size_t i = 0; i < ntips; i++) {
+        void **slot = egit_oidmap_put(&marks, &tips[i], NULL);
+        if (!slot || (!*slot && !(*slot = calloc(size, 1))))
+            goto oom;
+        ((unsigned char*) *slot)[i / 8] |= 1 << (i % 8);
+    }
+
+    size_t active = 0;
+    for (size_t i = 0; i < marks.alloc; i++)
+        if (marks.used[i] && memcmp(marks.values[i], full, size))
+            active++;
+
+    if ((retval = git_revwalk_new(&walk, repo)))
+        goto cleanup;
+    git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL);
+    for (size_t i = 0; i < ntips && !retval; i++)
+        retval = git_revwalk_push(walk, &tips[i]);
+
+    git_oid id;
+    while (!retval && active && !(retval = git_revwalk_next(&id, walk))) {
+        void **slot = egit_oidmap_put(&marks, &id, NULL);
+        if (!slot)
+            goto oom;
+        unsigned char *mark = (unsigned char*) *slot;
+        if (!mark)
+            continue;
+        *slot = NULL;
+
+        bool mark_full = !memcmp(mark, full, size);
+        if (!mark_full) {
+            egit_commit_graph_count_pairs(ahead, behind, mark, pairs, npairs);
+            active--;
+        }
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, repo, &id))) {
+            free(mark);
+            break;
+        }
+        unsigned int nparents = git_commit_parentcount(commit);
+        for (unsigned int i = 0; i < nparents; i++) {
+            slot = egit_oidmap_put(&marks, git_commit_parent_id(commit, i), NULL);
+            if (!slot) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            unsigned char *old = (unsigned char*) *slot;
+            if (!old) {
+                if (!(*slot = malloc(size))) {
+                    giterr_set_oom();
+                    retval = GIT_ERROR;
+                    break;
+                }
+                memcpy(*slot, mark, size);
+                if (!mark_full)
+                    active++;
+                continue;
+            }
+
+            bool was_full = !memcmp(old, full, size);
+            for (size_t j = 0; j < size; j++)
+                old[j] |= mark[j];
+            if (!was_full && !memcmp(old, full, size))
+                active--;
+        }
+        git_commit_free(commit);
+        free(mark);
+    }
+    if (retval == GIT_ITEROVER)
+        retval = 0;
+    goto cleanup;
+
+oom:
+    giterr_set_oom();
+    retval = GIT_ERROR;
+
+cleanup:
+    git_revwalk_free(walk);
+    free_marks(&marks);
+    free(full);
+    return retval;
+}
+
+static int graph_ahead_behind_many(size_t *ahead, size_t *behind, git_repository *repo,
+                                   const git_oid *tips, size_t ntips,
+                                   const size_t *pairs, size_t npairs)
+{
+    memset(ahead, 0, npairs * sizeof(size_t));
+    memset(behind, 0, npairs * sizeof(size_t));
+    if (!ntips)
+        return 0;
+
+    egit_commit_graph *graph = egit_commit_graph_get(repo);
+    uint32_t *positions = graph ? malloc(ntips * sizeof(uint32_t)) : NULL;
+    if (graph && !positions) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+
+    size_t i = 0;
+    while (graph && i < ntips && egit_commit_graph_find(graph, &tips[i], &positions[i]))
+        i++;
+
+    int retval;
+    if (graph && i == ntips)
+        retval = egit_commit_graph_ahead_behind_many(ahead, behind, graph, positions, ntips, pairs, npairs);
+    else
+        retval = ahead_behind_many_walk(ahead, behind, repo, tips, ntips, pairs, npairs);
+    free(positions);
+    return retval;
+}
+
+typedef struct {
+    char **names;
+    size_t count;
+    size_t alloc;
+} ref_names;
+
+static int collect_ref_name(const char *refname, void *payload)
+{
+    ref_names *names = (ref_names*) payload;
+    if (names->count == names->alloc) {
+        size_t alloc = names->alloc ? 2 * names->alloc : 64;
+        char **grown = (char**) realloc(names->names, alloc * sizeof(char*));
+        if (!grown) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        names->names = grown;
+        names->alloc = alloc;
+    }
+    if (!(names->names[names->count] = strdup(refname))) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+    names->count++;
+    return 0;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/**
+ * Find the commit that the reference named REFNAME, or its upstream if
+ * UPSTREAM is set, points to.
+ * @return 0, GIT_ENOTFOUND if there is no such commit, or an error code.
+ */
+static int ref_commit(git_oid *out, git_repository *repo, const char *refname, bool upstream)
+{
+    git_reference *ref, *target;
+    int retval = git_reference_lookup(&ref, repo, refname);
+    if (retval)
+        return retval;
+    if (upstream) {
+        retval = git_branch_upstream(&target, ref);
+        git_reference_free(ref);
+        if (retval)
+            return retval;
+        ref = target;
+    }
+
+    git_object *commit;
+    retval = git_reference_peel(&commit, ref, GIT_OBJ_COMMIT);
+    git_reference_free(ref);
+    if (retval)
+        return retval == GIT_EINVALIDSPEC || retval == GIT_EPEEL ? GIT_ENOTFOUND : retval;
+    git_oid_cpy(out, git_object_id(commit));
+    git_object_free(commit);
+    return 0;
+}
+
+/**
+ * Add ID to TIPS unless it is there already, and store its index in OUT.
+ */
+static int add_tip(size_t *out, egit_oidmap *index, git_oid **tips, size_t *ntips, const git_oid *id)
+{
+    bool existed;
+    void **slot = egit_oidmap_put(index, id, &existed);
+    if (!slot)
+        return GIT_ERROR;
+    if (!existed) {
+        git_oid *grown = (git_oid*) realloc(*tips, (*ntips + 1) * sizeof(git_oid));
+        if (!grown) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        *tips = grown;
+        git_oid_cpy(&grown[*ntips], id);
+        *slot = (void*) (uintptr_t) ++*ntips;
+    }
+    *out = (uintptr_t) *slot - 1;
+    return 0;
+}
+
+EGIT_DOC(branches_ahead_behind, "REPO &optional GLOB BASE",
+         "Return ahead/behind counts for the local branches of REPO.\n"
+         "The value is a list of elements (NAME AHEAD . BEHIND), sorted by the\n"
+         "branch NAME.  AHEAD is the number of commits on the branch that are\n"
+         "not on its upstream, and BEHIND the number of commits on the upstream\n"
+         "that are not on the branch.  Branches without an upstream are listed\n"
+         "as (NAME).\n\n"
+         "If GLOB is given, only the branches matching it are listed, as in\n"
+         "`libgit-revwalk-push-glob' relative to refs/heads/.  If BASE is\n"
+         "given, it is a revision that every branch is compared to instead of\n"
+         "its upstream.\n\n"
+         "All counts come from one walk of the history.  With a commit-graph\n"
+         "file the walk stops once the remaining commits are on every branch\n"
+         "and upstream; without one, the whole history is read first.");
+emacs_value egit_branches_ahead_behind(emacs_env *env, emacs_value _repo, emacs_value _glob,
+                                       emacs_value _base)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING_OR_NIL(_glob);
+    EM_ASSERT_STRING_OR_NIL(_base);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    git_oid base;
+    bool has_base = EM_EXTRACT_BOOLEAN(_base);
+    int retval = 0;
+    if (has_base) {
+        char *spec = EM_EXTRACT_STRING(_base);
+        git_object *obj, *commit;
+        retval = git_revparse_single(&obj, repo, spec);
+        free(spec);
+        EGIT_CHECK_ERROR(retval);
+        retval = git_object_peel(&commit, obj, GIT_OBJ_COMMIT);
+        git_object_free(obj);
+        EGIT_CHECK_ERROR(retval);
+        git_oid_cpy(&base, git_object_id(commit));
+        git_object_free(commit);
+    }
+
+    ref_names names = {0};
+    {
+        char *glob = EM_EXTRACT_STRING_OR_NULL(_glob);
+        char *pattern = (char*) malloc(strlen("refs/heads/") + (glob ? strlen(glob) : 1) + 1);
+        if (pattern) {
+            sprintf(pattern, "refs/heads/%s", glob ? glob : "*");
+            retval = git_reference_foreach_glob(repo, pattern, &collect_ref_name, &names);
+        }
+        else {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+        }
+        free(pattern);
+        free(glob);
+    }
+    qsort(names.names, names.count, sizeof(char*), &compare_names);
+
+    // Each branch has a pair of indices into the distinct tips, or none
+    egit_oidmap index = {0};
+    git_oid *tips = NULL;
+    size_t ntips = 0, npairs = 0;
+    size_t *pairs = (size_t*) malloc((2 * names.count + 1) * sizeof(size_t));
+    ptrdiff_t *pair_of = (ptrdiff_t*) malloc((names.count + 1) * sizeof(ptrdiff_t));
+    size_t *ahead = (size_t*) malloc((names.count + 1) * sizeof(size_t));
+    size_t *behind = (size_t*) malloc((names.count + 1) * sizeof(size_t));
+    if (!retval && (!pairs || !pair_of || !ahead || !behind)) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+    }
+
+    for (size_t i = 0; i < names.count && !retval; i++) {
+        git_oid local, upstream;
+        pair_of[i] = -1;
+        retval = ref_commit(&local, repo, names.names[i], false);
+        if (!retval) {
+            if (has_base)
+                git_oid_cpy(&upstream, &base);
+            else
+                retval = ref_commit(&upstream, repo, names.names[i], true);
+        }
+        if (retval == GIT_ENOTFOUND) {
+            giterr_clear();
+            retval = 0;
+            continue;
+        }
+        if (!retval)
+            retval = add_tip(&pairs[2*npairs], &index, &tips, &ntips, &local);
+        if (!retval)
+            retval = add_tip(&pairs[2*npairs + 1], &index, &tips, &ntips, &upstream);
+        if (!retval)
+            pair_of[i] = npairs++;
+    }
+
+    if (!retval)
+        retval = graph_ahead_behind_many(ahead, behind, repo, tips, ntips, pairs, npairs);
+
+    emacs_value ret = esym_nil;
+    for (size_t i = names.count; i > 0 && !retval; i--) {
+        const char *name = names.names[i-1] + strlen("refs/heads/");
+        ptrdiff_t pair = pair_of[i-1];
+        emacs_value counts = pair < 0 ? esym_nil :
+            em_cons(env, EM_INTEGER(ahead[pair]), EM_INTEGER(behind[pair]));
+        ret = em_cons(env, em_cons(env, EM_STRING(name), counts), ret);
+    }
+
+    for (size_t i = 0; i < names.count; i++)
+        free(names.names[i]);
+    free(names.names);
+    egit_oidmap_dispose(&index);
+    free(tips);
+    free(pairs);
+    free(pair_of);
+    free(ahead);
+    free(behind);
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+#define CONTAINS_YES ((void*) 1)
+#define CONTAINS_NO ((void*) 2)
+
+typedef struct {
+    git_oid id;
+    size_t next;
+} contains_frame;
+
+/**
+ * State shared by the searches from all references, so that every commit
+ * is only decided once.
+ */
+typedef struct {
+    git_repository *repo;
+    egit_commit_graph *graph;
+    git_oid target;
+    bool target_in_graph;
+    uint32_t target_level;
+    egit_oidmap marks;
+    contains_frame *stack;
+    size_t size;
+    size_t alloc;
+} contains_ctx;
+
+/**
+ * Check whether the commit ID can't reach the target without looking at
+ * its parents.  The commit graph holds every ancestor of its commits, so
+ * a commit in it can only reach a target that is in it as well, and only
+ * one with a lower generation number.
+ */
+static bool contains_pruned(contains_ctx *ctx, const git_oid *id)
+{
+    uint32_t pos;
+    if (!ctx->graph || !egit_commit_graph_find(ctx->graph, id, &pos))
+        return false;
+    return !ctx->target_in_graph || egit_commit_graph_level(ctx->graph, pos) <= ctx->target_level;
+}
+
+/**
+ * Find the parent number I of the commit ID.
+ * @return 0, GIT_ITEROVER if it has no such parent, or an error code.
+ */
+static int contains_parent(git_oid *out, contains_ctx *ctx, const git_oid *id, size_t i)
+{
+    uint32_t pos;
+    if (ctx->graph && egit_commit_graph_find(ctx->graph, id, &pos)) {
+        uint32_t parents[i + 1];
+        if (egit_commit_graph_parents(ctx->graph, pos, parents, i + 1) <= i)
+            return GIT_ITEROVER;
+        egit_commit_graph_id(out, ctx->graph, parents[i]);
+        return 0;
+    }
+
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, ctx->repo, id);
+    if (retval)
+        return retval;
+    if (i < git_commit_parentcount(commit))
+        git_oid_cpy(out, git_commit_parent_id(commit, i));
+    else
+        retval = GIT_ITEROVER;
+    git_commit_free(commit);
+    return retval;
+}
+
+static int contains_push(contains_ctx *ctx, const git_oid *id)
+{
+    if (ctx->size == ctx->alloc) {
+        size_t alloc = ctx->alloc ? 2 * ctx->alloc : 64;
+        contains_frame *grown = (contains_frame*) realloc(ctx->stack, alloc * sizeof(contains_frame));
+        if (!grown) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        ctx->stack = grown;
+        ctx->alloc = alloc;
+    }
+    git_oid_cpy(&ctx->stack[ctx->size].id, id);
+    ctx->stack[ctx->size++].next = 0;
+    return 0;
+}
+
+static int contains_mark(contains_ctx *ctx, const git_oid *id, void *mark)
+{
+    void **slot = egit_oidmap_put(&ctx->marks, id, NULL);
+    if (!slot)
+        return GIT_ERROR;
+    *slot = mark;
+    return 0;
+}
+
+/**
+ * Decide whether the commit TIP reaches the target, like the memoized
+ * search of `git tag --contains'.  A commit contains the target if one of
+ * its parents does, and the parents are decided depth first.
+ */
+static int contains_commit(bool *out, contains_ctx *ctx, const git_oid *tip)
+{
+    int retval = 0;
+    void *mark = egit_oidmap_get(&ctx->marks, tip);
+    if (!mark && !(retval = contains_push(ctx, tip))) {
+        while (ctx->size && !retval) {
+            contains_frame *frame = &ctx->stack[ctx->size - 1];
+            if (git_oid_equal(&frame->id, &ctx->target))
+                mark = CONTAINS_YES;
+            else if (frame->next == 0 && contains_pruned(ctx, &frame->id))
+                mark = CONTAINS_NO;
+            else {
+                git_oid parent;
+                retval = contains_parent(&parent, ctx, &frame->id, frame->next);
+                if (retval == GIT_ITEROVER) {
+                    retval = 0;
+                    mark = CONTAINS_NO;
+                }
+                else if (!retval) {
+                    mark = egit_oidmap_get(&ctx->marks, &parent);
+                    if (!mark) {
+                        // Come back to the same parent once it is decided
+                        retval = contains_push(ctx, &parent);
+                        continue;
+                    }
+                    if (mark == CONTAINS_NO) {
+                        frame->next++;
+                        mark = NULL;
+                        continue;
+                    }
+                }
+            }
+
+            if (!retval) {
+                retval = contains_mark(ctx, &frame->id, mark);
+                ctx->size--;
+            }
+        }
+        ctx->size = 0;
+        mark = egit_oidmap_get(&ctx->marks, tip);
+    }
+
+    *out = mark == CONTAINS_YES;
+    return retval;
+}
+
+EGIT_DOC(refs_containing, "REPO OID &optional GLOB",
+         "Return the names of the references in REPO that contain commit OID.\n"
+         "A reference contains OID if the commit it points to is OID or one\n"
+         "of its descendants, as with `git branch --contains' and\n"
+         "`git tag --contains'.  The names are sorted, and references that\n"
+         "don't point to commits are left out.\n\n"
+         "If GLOB is given, only the references whose full names match it are\n"
+         "considered, e.g. \"refs/tags/*\".\n\n"
+         "The answers for all references come from one search, which decides\n"
+         "every commit at most once.  With a commit graph, commits with a lower\n"
+         "generation number than OID are not searched further.");
+emacs_value egit_refs_containing(emacs_env *env, emacs_value _repo, emacs_value _oid, emacs_value _glob)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_oid);
+    EM_ASSERT_STRING_OR_NIL(_glob);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    contains_ctx ctx = {.repo = repo};
+    EGIT_EXTRACT_OID(_oid, ctx.target);
+
+    // Only commits can be contained
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, repo, &ctx.target);
+    EGIT_CHECK_ERROR(retval);
+    git_commit_free(commit);
+
+    uint32_t pos;
+    ctx.graph = egit_commit_graph_get(repo);
+    if (ctx.graph && egit_commit_graph_find(ctx.graph, &ctx.target, &pos)) {
+        ctx.target_in_graph = true;
+        ctx.target_level = egit_commit_graph_level(ctx.graph, pos);
+    }
+
+    ref_names names = {0};
+    {
+        char *glob = EM_EXTRACT_STRING_OR_NULL(_glob);
+        retval = git_reference_foreach_glob(repo, glob ? glob : "*", &collect_ref_name, &names);
+        free(glob);
+    }
+    qsort(names.names, names.count, sizeof(char*), &compare_names);
+
+    bool *contains = (bool*) malloc((names.count + 1) * sizeof(bool));
+    if (!retval && !contains) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+    }
+    for (size_t i = 0; i < names.count && !retval; i++) {
+        git_oid id;
+        contains[i] = false;
+        retval = ref_commit(&id, repo, names.names[i], false);
+        if (retval == GIT_ENOTFOUND) {
+            giterr_clear();
+            retval = 0;
+        }
+        else if (!retval)
+            retval = contains_commit(&contains[i], &ctx, &id);
+    }
+
+    emacs_value ret = esym_nil;
+    for (size_t i = names.count; i > 0 && !retval; i--)
+        if (contains[i-1])
+            ret = em_cons(env, EM_STRING(names.names[i-1]), ret);
+
+    for (size_t i = 0; i < names.count; i++)
+        free(names.names[i]);
+    free(names.names);
+    free(contains);
+    egit_oidmap_dispose(&ctx.marks);
+    free(ctx.stack);
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
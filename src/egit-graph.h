@@ -3,7 +3,9 @@
 #ifndef EGIT_GRAPH_H
 #define EGIT_GRAPH_H
 
+EGIT_DEFUN(branches_ahead_behind, emacs_value _repo, emacs_value _glob, emacs_value _base);
 EGIT_DEFUN(graph_ahead_behind, emacs_value _repo, emacs_value _local, emacs_value _upstream);
 EGIT_DEFUN(graph_descendant_p, emacs_value _repo, emacs_value _commit, emacs_value _ancestor);
+EGIT_DEFUN(refs_containing, emacs_value _repo, emacs_value _oid, emacs_value _glob);
 
 #endif /* EGIT_GRAPH_H */
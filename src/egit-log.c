@@ -0,0 +1,2316 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <regex.h>
+#endif
+
+#include "git2.h"
+
+#include "egit.h"
+#include "egit-commit-graph.h"
+#include "egit-diff.h"
+#include "egit-revwalk.h"
+#include "egit-util.h"
+#include "interface.h"
+#include "egit-log.h"
+
+
+// =============================================================================
+// Revision specs
+
+/**
+ * Push a single revision SPEC to REVWALK.
+ * "A..B" pushes a range, "^A" hides A and anything else is pushed.
+ */
+static int push_spec(git_revwalk *revwalk, git_repository *repo, const char *spec)
+{
+    if (strstr(spec, ".."))
+        return git_revwalk_push_range(revwalk, spec);
+
+    bool hide = spec[0] == '^';
+    git_object *obj, *commit;
+    int retval = git_revparse_single(&obj, repo, hide ? spec + 1 : spec);
+    if (retval)
+        return retval;
+    retval = git_object_peel(&commit, obj, GIT_OBJ_COMMIT);
+    git_object_free(obj);
+    if (retval)
+        return retval;
+
+    if (hide)
+        retval = git_revwalk_hide(revwalk, git_object_id(commit));
+    else
+        retval = git_revwalk_push(revwalk, git_object_id(commit));
+    git_object_free(commit);
+    return retval;
+}
+
+/**
+ * Push SPEC to REVWALK.  SPEC is a revision string, a list of them, or nil for HEAD.
+ * Signals an error and returns false on failure.
+ */
+static bool push_specs(emacs_env *env, git_revwalk *revwalk, git_repository *repo, emacs_value spec)
+{
+    int retval = 0;
+
+    if (!EM_EXTRACT_BOOLEAN(spec))
+        retval = git_revwalk_push_head(revwalk);
+    else if (em_listp(env, spec)) {
+        git_strarray specs;
+        if (!egit_strarray_from_list(&specs, env, spec))
+            return false;
+        for (size_t i = 0; i < specs.count && !retval; i++)
+            retval = push_spec(revwalk, repo, specs.strings[i]);
+        egit_strarray_dispose(&specs);
+    }
+    else {
+        if (!em_assert(env, esym_stringp, spec))
+            return false;
+        char *str = EM_EXTRACT_STRING(spec);
+        retval = push_spec(revwalk, repo, str);
+        free(str);
+    }
+
+    return !egit_dispatch_error(env, retval);
+}
+
+
+// =============================================================================
+// Records
+
+typedef enum {
+    LOG_ID,
+    LOG_TREE,
+    LOG_PARENTS,
+    LOG_AUTHOR_NAME,
+    LOG_AUTHOR_EMAIL,
+    LOG_AUTHOR_TIME,
+    LOG_COMMITTER_NAME,
+    LOG_COMMITTER_EMAIL,
+    LOG_COMMITTER_TIME,
+    LOG_SUMMARY,
+    LOG_MESSAGE,
+    LOG_REFS
+} log_field;
+
+static const struct {
+    emacs_value *symbol;
+    log_field field;
+} log_fields[] = {
+    {&esym_id, LOG_ID},
+    {&esym_tree, LOG_TREE},
+    {&esym_parents, LOG_PARENTS},
+    {&esym_author_name, LOG_AUTHOR_NAME},
+    {&esym_author_email, LOG_AUTHOR_EMAIL},
+    {&esym_author_time, LOG_AUTHOR_TIME},
+    {&esym_committer_name, LOG_COMMITTER_NAME},
+    {&esym_committer_email, LOG_COMMITTER_EMAIL},
+    {&esym_committer_time, LOG_COMMITTER_TIME},
+    {&esym_summary, LOG_SUMMARY},
+    {&esym_message, LOG_MESSAGE},
+    {&esym_refs, LOG_REFS},
+};
+
+#define LOG_NFIELDS (sizeof(log_fields) / sizeof(log_fields[0]))
+
+/**
+ * Names of the references pointing to one commit.
+ */
+typedef struct ref_name {
+    char *name;
+    struct ref_name *next;
+} ref_name;
+
+typedef struct {
+    log_field *fields;
+    size_t nfields;
+    egit_oidmap refs;
+} log_format;
+
+static void log_format_dispose(log_format *format)
+{
+    for (size_t i = 0; i < format->refs.alloc; i++) {
+        if (!format->refs.used[i])
+            continue;
+        ref_name *node = (ref_name*) format->refs.values[i];
+        while (node) {
+            ref_name *next = node->next;
+            free(node->name);
+            free(node);
+            node = next;
+        }
+    }
+    egit_oidmap_dispose(&format->refs);
+    free(format->fields);
+}
+
+static int add_ref_name(egit_oidmap *refs, const git_oid *id, const char *name)
+{
+    void **slot = egit_oidmap_put(refs, id, NULL);
+    ref_name *node = slot ? (ref_name*) malloc(sizeof(ref_name)) : NULL;
+    if (!node) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+    node->name = strdup(name);
+    node->next = (ref_name*) *slot;
+    *slot = node;
+    return 0;
+}
+
+/**
+ * Map each commit that a reference (or HEAD) points to, to the reference names.
+ * References that don't point to commits are skipped.
+ */
+static int collect_refs(egit_oidmap *refs, git_repository *repo)
+{
+    git_reference *ref;
+    git_object *commit;
+    int retval;
+
+    if (!git_repository_head(&ref, repo)) {
+        if (!git_reference_peel(&commit, ref, GIT_OBJ_COMMIT)) {
+            retval = add_ref_name(refs, git_object_id(commit), "HEAD");
+            git_object_free(commit);
+            if (retval) {
+                git_reference_free(ref);
+                return retval;
+            }
+        }
+        git_reference_free(ref);
+    }
+
+    git_reference_iterator *iter;
+    retval = git_reference_iterator_new(&iter, repo);
+    if (retval)
+        return retval;
+
+    while (!(retval = git_reference_next(&ref, iter))) {
+        if (!git_reference_peel(&commit, ref, GIT_OBJ_COMMIT)) {
+            retval = add_ref_name(refs, git_object_id(commit), git_reference_name(ref));
+            git_object_free(commit);
+        }
+        git_reference_free(ref);
+        if (retval)
+            break;
+    }
+    git_reference_iterator_free(iter);
+
+    giterr_clear();
+    return retval == GIT_ITEROVER ? 0 : retval;
+}
+
+/**
+ * Parse the list of field symbols FIELDS into FORMAT.
+ * Signals an error and returns false on failure.
+ */
+static bool log_format_parse(emacs_env *env, log_format *format, git_repository *repo, emacs_value fields)
+{
+    memset(format, 0, sizeof(log_format));
+
+    ptrdiff_t nfields = em_assert_list(env, esym_symbolp, fields);
+    if (nfields < 0)
+        return false;
+
+    format->fields = (log_field*) malloc((nfields + 1) * sizeof(log_field));
+    if (!format->fields) {
+        giterr_set_oom();
+        egit_dispatch_error(env, GIT_ERROR);
+        return false;
+    }
+
+    bool refs = false;
+    for (; em_consp(env, fields); fields = em_cdr(env, fields)) {
+        emacs_value field = em_car(env, fields);
+        size_t i;
+        for (i = 0; i < LOG_NFIELDS; i++)
+            if (EM_EQ(field, *log_fields[i].symbol))
+                break;
+        if (i == LOG_NFIELDS) {
+            em_signal_wrong_value(env, field);
+            log_format_dispose(format);
+            return false;
+        }
+        format->fields[format->nfields++] = log_fields[i].field;
+        refs = refs || log_fields[i].field == LOG_REFS;
+    }
+
+    // Ref decorations are only collected when asked for
+    if (refs && egit_dispatch_error(env, collect_refs(&format->refs, repo))) {
+        log_format_dispose(format);
+        return false;
+    }
+
+    return true;
+}
+
+static emacs_value log_field_value(emacs_env *env, const log_format *format,
+                                   git_commit *commit, log_field field)
+{
+    switch (field) {
+    case LOG_ID:
+        return EM_STRING(git_oid_tostr_s(git_commit_id(commit)));
+    case LOG_TREE:
+        return EM_STRING(git_oid_tostr_s(git_commit_tree_id(commit)));
+    case LOG_PARENTS: {
+        unsigned int nparents = git_commit_parentcount(commit);
+        emacs_value ret = esym_nil;
+        for (unsigned int i = nparents; i > 0; i--)
+            ret = em_cons(env, EM_STRING(git_oid_tostr_s(git_commit_parent_id(commit, i-1))), ret);
+        return ret;
+    }
+    case LOG_AUTHOR_NAME:
+        return EM_STRING(git_commit_author(commit)->name);
+    case LOG_AUTHOR_EMAIL:
+        return EM_STRING(git_commit_author(commit)->email);
+    case LOG_AUTHOR_TIME:
+        return EM_INTEGER(git_commit_author(commit)->when.time);
+    case LOG_COMMITTER_NAME:
+        return EM_STRING(git_commit_committer(commit)->name);
+    case LOG_COMMITTER_EMAIL:
+        return EM_STRING(git_commit_committer(commit)->email);
+    case LOG_COMMITTER_TIME:
+        return EM_INTEGER(git_commit_time(commit));
+    case LOG_SUMMARY: {
+        const char *summary = git_commit_summary(commit);
+        return summary ? EM_STRING(summary) : esym_nil;
+    }
+    case LOG_MESSAGE:
+        return EM_STRING(git_commit_message(commit));
+    case LOG_REFS: {
+        emacs_value ret = esym_nil;
+        ref_name *node = (ref_name*) egit_oidmap_get(&format->refs, git_commit_id(commit));
+        for (; node; node = node->next)
+            ret = em_cons(env, EM_STRING(node->name), ret);
+        return ret;
+    }
+    }
+    return esym_nil;
+}
+
+/**
+ * Build the record vector for COMMIT with the fields in FORMAT.
+ * SCRATCH must have room for one value per field.
+ */
+static emacs_value log_record(emacs_env *env, const log_format *format, git_commit *commit,
+                              emacs_value *scratch)
+{
+    for (size_t i = 0; i < format->nfields; i++)
+        scratch[i] = log_field_value(env, format, commit, format->fields[i]);
+    return em_vector(env, scratch, format->nfields);
+}
+
+
+// =============================================================================
+// Log
+
+EGIT_DOC(log, "REPOSITORY SPEC FIELDS &optional LIMIT OFFSET",
+         "Return a vector of records for the commits of SPEC in REPOSITORY.\n"
+         "SPEC is a revision such as \"HEAD\", a range \"A..B\", a revision\n"
+         "\"^A\" to exclude, or a list of these.  If nil, it is HEAD.\n"
+         "Commits are listed newest first.\n\n"
+         "FIELDS is a list of symbols, and each record is a vector with the\n"
+         "corresponding values in the same order:\n"
+         "- `id', `tree': the commit and tree IDs\n"
+         "- `parents': a list of the parent IDs\n"
+         "- `author-name', `author-email', `committer-name', `committer-email'\n"
+         "- `author-time', `committer-time': seconds since the Unix epoch\n"
+         "- `summary', `message': the first paragraph and the full message\n"
+         "- `refs': a list of the names of references pointing to the commit,\n"
+         "     including HEAD\n\n"
+         "If OFFSET is given, skip that many commits first.  If LIMIT is given,\n"
+         "return at most that many records.");
+emacs_value egit_log(emacs_env *env, emacs_value _repo, emacs_value spec, emacs_value fields,
+                     emacs_value _limit, emacs_value _offset)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_INTEGER_OR_NIL(_limit);
+    EM_ASSERT_INTEGER_OR_NIL(_offset);
+
+    git_repository *repo = EGIT_EXTRACT(_repo);
+    intmax_t limit = EM_EXTRACT_INTEGER_OR_DEFAULT(_limit, -1);
+    intmax_t offset = EM_EXTRACT_INTEGER_OR_DEFAULT(_offset, 0);
+
+    git_revwalk *revwalk;
+    int retval = git_revwalk_new(&revwalk, repo);
+    EGIT_CHECK_ERROR(retval);
+    git_revwalk_sorting(revwalk, GIT_SORT_TIME);
+
+    log_format format;
+    if (!push_specs(env, revwalk, repo, spec) || !log_format_parse(env, &format, repo, fields)) {
+        git_revwalk_free(revwalk);
+        return esym_nil;
+    }
+
+    emacs_value *records = NULL;
+    emacs_value *scratch = (emacs_value*) malloc((format.nfields + 1) * sizeof(emacs_value));
+    size_t nrecords = 0, alloc = 0;
+    git_oid oid;
+    if (!scratch) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+    }
+
+    for (intmax_t skipped = 0; !retval && skipped < offset; skipped++)
+        if ((retval = git_revwalk_next(&oid, revwalk)))
+            break;
+
+    while (!retval && (limit < 0 || (intmax_t) nrecords < limit)) {
+        if ((retval = git_revwalk_next(&oid, revwalk)))
+            break;
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, repo, &oid)))
+            break;
+
+        if (nrecords == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(records, alloc * sizeof(emacs_value));
+            if (!grown) {
+                git_commit_free(commit);
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            records = grown;
+        }
+
+        records[nrecords++] = log_record(env, &format, commit, scratch);
+        git_commit_free(commit);
+        if (env->non_local_exit_check(env))
+            break;
+    }
+
+    git_revwalk_free(revwalk);
+    log_format_dispose(&format);
+    free(scratch);
+
+    emacs_value ret = esym_nil;
+    if ((retval == 0 || retval == GIT_ITEROVER) && !env->non_local_exit_check(env)) {
+        retval = 0;
+        ret = em_vector(env, records, nrecords);
+    }
+    free(records);
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Cursors
+
+struct egit_log_cursor {
+    git_revwalk *walk;
+    log_format format;
+    unsigned char fingerprint[GIT_OID_RAWSZ];
+    unsigned char stamp[GIT_OID_RAWSZ];
+    bool stamped;
+    bool done;
+};
+
+void egit_log_cursor_free(egit_log_cursor *cursor)
+{
+    if (!cursor)
+        return;
+    git_revwalk_free(cursor->walk);
+    log_format_dispose(&cursor->format);
+    free(cursor);
+}
+
+/**
+ * Mix the name and target of REF into the fingerprint OUT.
+ * The digests of all references are combined with xor, so the order in
+ * which they are listed doesn't matter.
+ */
+static void fingerprint_ref(unsigned char *out, const git_reference *ref)
+{
+    egit_sha1_ctx ctx;
+    egit_sha1_init(&ctx);
+    const char *name = git_reference_name(ref);
+    egit_sha1_update(&ctx, name, strlen(name) + 1);
+    if (git_reference_type(ref) == GIT_REF_SYMBOLIC) {
+        const char *target = git_reference_symbolic_target(ref);
+        egit_sha1_update(&ctx, target, strlen(target));
+    }
+    else
+        egit_sha1_update(&ctx, git_reference_target(ref)->id, GIT_OID_RAWSZ);
+
+    unsigned char digest[GIT_OID_RAWSZ];
+    egit_sha1_final(digest, &ctx);
+    for (size_t i = 0; i < GIT_OID_RAWSZ; i++)
+        out[i] ^= digest[i];
+}
+
+/**
+ * Compute a fingerprint of HEAD and all references of REPO, which
+ * changes when any of them is created, deleted or moved.
+ */
+static int refs_fingerprint(unsigned char *out, git_repository *repo)
+{
+    memset(out, 0, GIT_OID_RAWSZ);
+
+    git_reference *ref;
+    if (!git_reference_lookup(&ref, repo, "HEAD")) {
+        fingerprint_ref(out, ref);
+        git_reference_free(ref);
+    }
+
+    git_reference_iterator *iter;
+    int retval = git_reference_iterator_new(&iter, repo);
+    if (retval)
+        return retval;
+    while (!(retval = git_reference_next(&ref, iter))) {
+        fingerprint_ref(out, ref);
+        git_reference_free(ref);
+    }
+    git_reference_iterator_free(iter);
+
+    giterr_clear();
+    return retval == GIT_ITEROVER ? 0 : retval;
+}
+
+#ifndef _WIN32
+/**
+ * Mix the file metadata of PATH into the stamp OUT, and if PATH is a
+ * directory, that of everything under it.  Like fingerprint_ref, the
+ * digests are combined with xor.  NEWEST is raised to the latest
+ * modification time seen.
+ * @return Whether all files could be examined.
+ */
+static bool stamp_path(unsigned char *out, time_t *newest, const char *path)
+{
+    egit_sha1_ctx ctx;
+    egit_sha1_init(&ctx);
+    egit_sha1_update(&ctx, path, strlen(path) + 1);
+
+    struct stat st;
+    bool exists = !lstat(path, &st);
+    if (!exists && errno != ENOENT)
+        return false;
+    if (exists) {
+        int64_t meta[5] = {st.st_mtime, st.st_ctime, st.st_size, st.st_ino, st.st_mode};
+        egit_sha1_update(&ctx, meta, sizeof(meta));
+        if (st.st_mtime > *newest)
+            *newest = st.st_mtime;
+        if (st.st_ctime > *newest)
+            *newest = st.st_ctime;
+    }
+
+    unsigned char digest[GIT_OID_RAWSZ];
+    egit_sha1_final(digest, &ctx);
+    for (size_t i = 0; i < GIT_OID_RAWSZ; i++)
+        out[i] ^= digest[i];
+    if (!exists || !S_ISDIR(st.st_mode))
+        return true;
+
+    DIR *dir = opendir(path);
+    if (!dir)
+        return false;
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir))) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+        char *child = malloc(strlen(path) + strlen(entry->d_name) + 2);
+        if (!child) {
+            ok = false;
+            break;
+        }
+        sprintf(child, "%s/%s", path, entry->d_name);
+        ok = stamp_path(out, newest, child);
+        free(child);
+    }
+    closedir(dir);
+    return ok;
+}
+#endif
+
+/**
+ * Compute a stamp from the metadata of the files that hold HEAD and the
+ * references of REPO, which is much cheaper than refs_fingerprint.  Git
+ * writes references by renaming a new file into place, so any change
+ * shows up in the stamp, but other changes such as packing references do
+ * as well.
+ * @return Whether the stamp can be trusted.  It can't on Windows, or when
+ *         a file was modified so recently that a later change could keep
+ *         the same time.
+ */
+static bool refs_stamp(unsigned char *out, git_repository *repo)
+{
+#ifdef _WIN32
+    (void) out;
+    (void) repo;
+    return false;
+#else
+    static const char *const files[] = {"HEAD", "packed-refs", "refs"};
+    memset(out, 0, GIT_OID_RAWSZ);
+    time_t newest = 0, now = time(NULL);
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        const char *dir = i ? git_repository_commondir(repo) : git_repository_path(repo);
+        char *path = malloc(strlen(dir) + strlen(files[i]) + 1);
+        if (!path)
+            return false;
+        strcpy(path, dir);
+        strcat(path, files[i]);
+        bool ok = stamp_path(out, &newest, path);
+        free(path);
+        if (!ok)
+            return false;
+    }
+    return newest < now - 1;
+#endif
+}
+
+EGIT_DOC(log_cursor_new, "REPOSITORY SPEC FIELDS &optional SORTING",
+         "Create a cursor over the commits of SPEC in REPOSITORY.\n"
+         "SPEC and FIELDS are as in `libgit-log', and `libgit-log-cursor-next'\n"
+         "returns the records page by page.  SORTING is a list of the symbols\n"
+         "`topological', `time' and `reverse', as in `libgit-revwalk-sorting'.\n\n"
+         "If SORTING is nil, commits come newest first by commit time, and each\n"
+         "page only reads as much history as it needs.  The other orders read\n"
+         "the whole history for the first page, and later pages continue from\n"
+         "the same sorted queues.\n\n"
+         "The cursor stays valid until a reference of REPOSITORY, or HEAD,\n"
+         "changes.  See `libgit-log-cursor-valid-p'.  The references are only\n"
+         "read again when the files that hold them have changed.");
+emacs_value egit_log_cursor_new(emacs_env *env, emacs_value _repo, emacs_value spec,
+                                emacs_value fields, emacs_value _sorting)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    git_sort_t sorting = GIT_SORT_NONE;
+    if (!em_setflags_list(&sorting, env, _sorting, true, em_setflag_sort))
+        return esym_nil;
+
+    egit_log_cursor *cursor = (egit_log_cursor*) calloc(1, sizeof(egit_log_cursor));
+    if (!cursor) {
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+
+    int retval = git_revwalk_new(&cursor->walk, repo);
+    if (retval) {
+        free(cursor);
+        EGIT_CHECK_ERROR(retval);
+    }
+    git_revwalk_sorting(cursor->walk, sorting);
+
+    // The fingerprint is taken first, so that a reference moving while
+    // the specs are resolved invalidates the cursor.  The stamp is taken
+    // before that, so a reference moving in between shows in the stamp.
+    cursor->stamped = refs_stamp(cursor->stamp, repo);
+    retval = refs_fingerprint(cursor->fingerprint, repo);
+    if (retval) {
+        git_revwalk_free(cursor->walk);
+        free(cursor);
+        EGIT_CHECK_ERROR(retval);
+    }
+
+    if (!push_specs(env, cursor->walk, repo, spec)) {
+        git_revwalk_free(cursor->walk);
+        free(cursor);
+        return esym_nil;
+    }
+    if (!log_format_parse(env, &cursor->format, repo, fields)) {
+        git_revwalk_free(cursor->walk);
+        free(cursor);
+        return esym_nil;
+    }
+
+    return egit_wrap(env, EGIT_LOG_CURSOR, cursor, EM_EXTRACT_USER_PTR(_repo));
+}
+
+/**
+ * Check whether the references of REPO are still those CURSOR was made for.
+ * The references are only read when the files holding them have changed.
+ */
+static int log_cursor_check(bool *valid, egit_log_cursor *cursor, git_repository *repo)
+{
+    unsigned char stamp[GIT_OID_RAWSZ];
+    bool stamped = refs_stamp(stamp, repo);
+    if (stamped && cursor->stamped && !memcmp(stamp, cursor->stamp, GIT_OID_RAWSZ)) {
+        *valid = true;
+        return 0;
+    }
+
+    unsigned char fingerprint[GIT_OID_RAWSZ];
+    int retval = refs_fingerprint(fingerprint, repo);
+    if (retval)
+        return retval;
+    *valid = !memcmp(fingerprint, cursor->fingerprint, GIT_OID_RAWSZ);
+    if (*valid) {
+        memcpy(cursor->stamp, stamp, GIT_OID_RAWSZ);
+        cursor->stamped = stamped;
+    }
+    return 0;
+}
+
+EGIT_DOC(log_cursor_valid_p, "CURSOR",
+         "Return non-nil if no reference has changed since CURSOR was created.");
+emacs_value egit_log_cursor_valid_p(emacs_env *env, emacs_value _cursor)
+{
+    EGIT_ASSERT_LOG_CURSOR(_cursor);
+    egit_log_cursor *cursor = EGIT_EXTRACT(_cursor);
+    git_repository *repo = git_revwalk_repository(cursor->walk);
+
+    bool valid;
+    int retval = log_cursor_check(&valid, cursor, repo);
+    EGIT_CHECK_ERROR(retval);
+    return valid ? esym_t : esym_nil;
+}
+
+EGIT_DOC(log_cursor_next, "CURSOR N",
+         "Return a vector of records for the next N commits of CURSOR.\n"
+         "The records are as in `libgit-log'.  The vector is shorter than N\n"
+         "at the end of the history, and empty after it.  Each call costs\n"
+         "about as much as the commits it returns.\n\n"
+         "Signals an error if a reference has changed since CURSOR was\n"
+         "created.  Make a new cursor to see the new history.");
+emacs_value egit_log_cursor_next(emacs_env *env, emacs_value _cursor, emacs_value _n)
+{
+    EGIT_ASSERT_LOG_CURSOR(_cursor);
+    EM_ASSERT_INTEGER(_n);
+
+    egit_log_cursor *cursor = EGIT_EXTRACT(_cursor);
+    git_repository *repo = git_revwalk_repository(cursor->walk);
+    intmax_t n = EM_EXTRACT_INTEGER(_n);
+
+    bool valid;
+    int retval = log_cursor_check(&valid, cursor, repo);
+    EGIT_CHECK_ERROR(retval);
+    if (!valid) {
+        giterr_set_str(GITERR_INVALID, "References have changed since the log cursor was created");
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+
+    emacs_value *records = NULL;
+    emacs_value *scratch = (emacs_value*) malloc((cursor->format.nfields + 1) * sizeof(emacs_value));
+    size_t nrecords = 0, alloc = 0;
+    if (!scratch) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+    }
+
+    // libgit2 resets a walk that ends, so the end is remembered here
+    while (!retval && !cursor->done && (intmax_t) nrecords < n) {
+        git_oid oid;
+        if ((retval = git_revwalk_next(&oid, cursor->walk))) {
+            if (retval == GIT_ITEROVER) {
+                cursor->done = true;
+                retval = 0;
+            }
+            break;
+        }
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, repo, &oid)))
+            break;
+
+        if (nrecords == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(records, alloc * sizeof(emacs_value));
+            if (!grown) {
+                git_commit_free(commit);
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            records = grown;
+        }
+
+        records[nrecords++] = log_record(env, &cursor->format, commit, scratch);
+        git_commit_free(commit);
+        if (env->non_local_exit_check(env))
+            break;
+    }
+
+    free(scratch);
+    emacs_value ret = esym_nil;
+    if (!retval && !env->non_local_exit_check(env))
+        ret = em_vector(env, records, nrecords);
+    free(records);
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Graph layout
+
+/**
+ * The commits that the lanes of a graph lead to, from left to right.
+ */
+typedef struct {
+    git_oid *ids;
+    size_t size;
+    size_t alloc;
+} graph_lanes;
+
+static bool graph_lanes_push(graph_lanes *lanes, const git_oid *id)
+{
+    if (lanes->size == lanes->alloc) {
+        size_t alloc = lanes->alloc ? 2 * lanes->alloc : 16;
+        git_oid *ids = (git_oid*) realloc(lanes->ids, alloc * sizeof(git_oid));
+        if (!ids) {
+            giterr_set_oom();
+            return false;
+        }
+        lanes->ids = ids;
+        lanes->alloc = alloc;
+    }
+    git_oid_cpy(&lanes->ids[lanes->size++], id);
+    return true;
+}
+
+static ptrdiff_t graph_lanes_find(const graph_lanes *lanes, const git_oid *id)
+{
+    for (size_t i = 0; i < lanes->size; i++)
+        if (git_oid_equal(&lanes->ids[i], id))
+            return i;
+    return -1;
+}
+
+/**
+ * Lay out the row of COMMIT.  LANES holds the lanes above the row, and is
+ * replaced by the lanes below it, using NEXT as scratch space.  COLUMN is
+ * set to the lane of the commit, which is a new lane on the right if none
+ * leads to it, and the pairs FROM TO of lanes that connect the row to the
+ * next one are appended to EDGES.
+ *
+ * The commit's lane goes on to its first parent, and other parents get new
+ * lanes right after it.  A parent that already has a lane is not given
+ * another one, so each commit has at most one lane leading to it.
+ */
+static bool graph_row(size_t *column, egit_intbuf *edges, graph_lanes *lanes, graph_lanes *next,
+                      const git_commit *commit)
+{
+    ptrdiff_t found = graph_lanes_find(lanes, git_commit_id(commit));
+    if (found < 0 && !graph_lanes_push(lanes, git_commit_id(commit)))
+        return false;
+    size_t col = found < 0 ? lanes->size - 1 : (size_t) found;
+
+    // Parents without a lane take the place of the commit
+    unsigned int nparents = git_commit_parentcount(commit);
+    next->size = 0;
+    for (size_t i = 0; i < col; i++)
+        if (!graph_lanes_push(next, &lanes->ids[i]))
+            return false;
+    for (unsigned int i = 0; i < nparents; i++) {
+        const git_oid *parent = git_commit_parent_id(commit, i);
+        if (graph_lanes_find(lanes, parent) < 0 && graph_lanes_find(next, parent) < 0 &&
+            !graph_lanes_push(next, parent))
+            return false;
+    }
+    size_t inserted = next->size - col;
+    for (size_t i = col + 1; i < lanes->size; i++)
+        if (!graph_lanes_push(next, &lanes->ids[i]))
+            return false;
+
+    // Lanes right of the commit move by the number of lanes it opened
+    for (size_t i = 0; i < lanes->size; i++) {
+        if (i != col) {
+            size_t to = i < col ? i : i + inserted - 1;
+            if (!egit_intbuf_push(edges, i) || !egit_intbuf_push(edges, to))
+                return false;
+            continue;
+        }
+        for (unsigned int j = 0; j < nparents; j++) {
+            const git_oid *parent = git_commit_parent_id(commit, j);
+            ptrdiff_t to = graph_lanes_find(lanes, parent);
+            if (to >= 0)
+                to = (size_t) to < col ? to : to + (ptrdiff_t) inserted - 1;
+            else
+                to = graph_lanes_find(next, parent);
+            if (!egit_intbuf_push(edges, i) || !egit_intbuf_push(edges, to))
+                return false;
+        }
+    }
+
+    graph_lanes tmp = *lanes;
+    *lanes = *next;
+    *next = tmp;
+    *column = col;
+    return true;
+}
+
+EGIT_DOC(log_graph, "REVWALK N FIELDS &optional LANES",
+         "Return the next N commits of REVWALK as records with a graph layout.\n"
+         "The value is a cons (ROWS . LANES).  ROWS is a vector with a row for\n"
+         "each commit, which is its record as in `libgit-log' for FIELDS, with\n"
+         "two more elements:\n"
+         "- COLUMN: the lane of the commit, counting from 0 on the left\n"
+         "- EDGES: a vector [FROM TO FROM TO ...] of the lines from the lanes\n"
+         "     of this row to the lanes of the next one\n\n"
+         "LANES is a list of the IDs of the commits that the lanes lead to after\n"
+         "the last row.  To continue the graph with the next commits of REVWALK,\n"
+         "pass it back as LANES.  Like `libgit-revwalk-next-n', fewer than N rows\n"
+         "means the walk is over.  REVWALK should sort topologically, so that\n"
+         "every commit comes before its parents.");
+emacs_value egit_log_graph(emacs_env *env, emacs_value _revwalk, emacs_value _n, emacs_value fields,
+                           emacs_value _lanes)
+{
+    EGIT_ASSERT_REVWALK(_revwalk);
+    EM_ASSERT_INTEGER(_n);
+
+    egit_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_repository *repo = git_revwalk_repository(egit_revwalk_walker(revwalk));
+    intmax_t n = EM_EXTRACT_INTEGER(_n);
+    if (n < 0) {
+        em_signal_args_out_of_range(env, n);
+        return esym_nil;
+    }
+
+    git_strarray lane_ids;
+    if (!egit_strarray_from_list(&lane_ids, env, _lanes))
+        return esym_nil;
+
+    graph_lanes lanes = {0}, next = {0};
+    int retval = 0;
+    for (size_t i = 0; i < lane_ids.count && !retval; i++) {
+        git_oid id;
+        if (!(retval = git_oid_fromstr(&id, lane_ids.strings[i])) && !graph_lanes_push(&lanes, &id))
+            retval = GIT_ERROR;
+    }
+    egit_strarray_dispose(&lane_ids);
+
+    log_format format;
+    if (retval || !log_format_parse(env, &format, repo, fields)) {
+        free(lanes.ids);
+        EM_RETURN_NIL_IF_NLE();
+        EGIT_CHECK_ERROR(retval);
+        return esym_nil;
+    }
+
+    emacs_value *rows = NULL;
+    emacs_value *scratch = (emacs_value*) malloc((format.nfields + 2) * sizeof(emacs_value));
+    egit_intbuf edges = {0};
+    intmax_t nrows = 0;
+    size_t alloc = 0;
+    git_oid oid;
+    if (!scratch) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+    }
+
+    while (!retval && nrows < n) {
+        if ((retval = egit_revwalk_next(&oid, revwalk)))
+            break;
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, repo, &oid)))
+            break;
+
+        if ((size_t) nrows == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(rows, alloc * sizeof(emacs_value));
+            if (!grown) {
+                git_commit_free(commit);
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            rows = grown;
+        }
+
+        size_t column;
+        edges.size = 0;
+        if (!graph_row(&column, &edges, &lanes, &next, commit)) {
+            git_commit_free(commit);
+            retval = GIT_ERROR;
+            break;
+        }
+
+        for (size_t i = 0; i < format.nfields; i++)
+            scratch[i] = log_field_value(env, &format, commit, format.fields[i]);
+        scratch[format.nfields] = EM_INTEGER(column);
+        scratch[format.nfields + 1] = em_integer_vector(env, edges.ptr, edges.size);
+        rows[nrows++] = em_vector(env, scratch, format.nfields + 2);
+        git_commit_free(commit);
+        if (env->non_local_exit_check(env))
+            break;
+    }
+
+    emacs_value ret = esym_nil;
+    if ((retval == 0 || retval == GIT_ITEROVER) && !env->non_local_exit_check(env)) {
+        retval = 0;
+        ret = esym_nil;
+        for (size_t i = lanes.size; i > 0; i--)
+            ret = em_cons(env, EM_STRING(git_oid_tostr_s(&lanes.ids[i-1])), ret);
+        ret = em_cons(env, em_vector(env, rows, nrows), ret);
+    }
+
+    log_format_dispose(&format);
+    egit_intbuf_dispose(&edges);
+    free(lanes.ids);
+    free(next.ids);
+    free(scratch);
+    free(rows);
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Path-limited history
+
+typedef struct {
+    emacs_value revisions;
+    intmax_t limit;
+    bool full_history;
+    bool follow;
+    size_t threads;
+} log_path_options;
+
+// Optional keys of the options of path-limited history functions
+#define LOG_OPTIONS_SIMPLIFY (1 << 0)  // full-history and follow
+#define LOG_OPTIONS_PARALLEL (1 << 1)  // parallel
+
+/**
+ * Parse the options of `libgit-log-path' and the functions built like it.
+ * Besides revisions and limit, only the keys in ALLOWED are accepted.
+ */
+static emacs_value extract_log_path_options(emacs_env *env, emacs_value eopts, log_path_options *opts,
+                                            int allowed)
+{
+    opts->revisions = esym_nil;
+    opts->limit = -1;
+    opts->full_history = false;
+    opts->follow = false;
+    opts->threads = egit_parallel_default_threads();
+
+    {
+        emacs_value car, cdr;
+        EM_DOLIST(option, eopts, loop);
+        EM_ASSERT_CONS(option);
+
+        car = em_car(env, option);
+        cdr = em_cdr(env, option);
+
+        if (EM_EQ(car, esym_revisions))
+            opts->revisions = cdr;
+        else if (EM_EQ(car, esym_limit)) {
+            EM_ASSERT_INTEGER(cdr);
+            opts->limit = EM_EXTRACT_INTEGER(cdr);
+        }
+        else if ((allowed & LOG_OPTIONS_SIMPLIFY) && EM_EQ(car, esym_full_history))
+            opts->full_history = EM_EXTRACT_BOOLEAN(cdr);
+        else if ((allowed & LOG_OPTIONS_SIMPLIFY) && EM_EQ(car, esym_follow))
+            opts->follow = EM_EXTRACT_BOOLEAN(cdr);
+        else if ((allowed & LOG_OPTIONS_PARALLEL) && EM_EQ(car, esym_parallel)) {
+            if (!EM_EQ(cdr, esym_t)) {
+                EM_ASSERT_INTEGER_OR_NIL(cdr);
+                intmax_t threads = EM_EXTRACT_INTEGER_OR_DEFAULT(cdr, 1);
+                if (threads < 1) {
+                    em_signal_args_out_of_range(env, threads);
+                    return esym_nil;
+                }
+                opts->threads = threads;
+            }
+        }
+        else {
+            em_signal_wrong_value(env, car);
+            return esym_nil;
+        }
+
+        EM_DOLIST_END(loop);
+    }
+
+    return esym_t;
+}
+
+/**
+ * Normalize PATH in place to the form git uses for tree paths, without
+ * leading, trailing or repeated slashes.  The Bloom filters of the commit
+ * graph hash paths in exactly this form.
+ */
+static void normalize_path(char *path)
+{
+    char *out = path;
+    for (const char *in = path; *in; in++) {
+        if (*in == '/' && (out == path || out[-1] == '/'))
+            continue;
+        *out++ = *in;
+    }
+    if (out > path && out[-1] == '/')
+        out--;
+    *out = '\0';
+}
+
+/**
+ * Check whether PATH is the same in the trees A and B, either of which may
+ * be NULL for a missing tree.  PATH must be normalized.  Only the subtrees along PATH are read, and
+ * the comparison stops at the first entry whose ID is the same on both sides.
+ */
+static int path_treesame(bool *same, git_repository *repo, const git_tree *a, const git_tree *b,
+                         const char *path)
+{
+    git_tree *owned_a = NULL, *owned_b = NULL;
+    int retval = 0;
+    *same = true;
+
+    while (a || b) {
+        if (a && b && git_oid_equal(git_tree_id(a), git_tree_id(b)))
+            break;
+        if (!*path) {
+            *same = false;
+            break;
+        }
+
+        const char *slash = strchr(path, '/');
+        size_t len = slash ? (size_t) (slash - path) : strlen(path);
+        char name[len + 1];
+        memcpy(name, path, len);
+        name[len] = '\0';
+        path += len + (slash != NULL);
+
+        const git_tree_entry *entry_a = a ? git_tree_entry_byname(a, name) : NULL;
+        const git_tree_entry *entry_b = b ? git_tree_entry_byname(b, name) : NULL;
+        if (!entry_a && !entry_b)
+            break;
+        if (entry_a && entry_b && git_tree_entry_filemode(entry_a) == git_tree_entry_filemode(entry_b) &&
+            git_oid_equal(git_tree_entry_id(entry_a), git_tree_entry_id(entry_b)))
+            break;
+        if (!*path) {
+            *same = false;
+            break;
+        }
+
+        // Continue into whichever sides have a subtree here
+        git_tree *next_a = NULL, *next_b = NULL;
+        if (entry_a && git_tree_entry_type(entry_a) == GIT_OBJ_TREE)
+            retval = git_tree_lookup(&next_a, repo, git_tree_entry_id(entry_a));
+        if (!retval && entry_b && git_tree_entry_type(entry_b) == GIT_OBJ_TREE)
+            retval = git_tree_lookup(&next_b, repo, git_tree_entry_id(entry_b));
+        git_tree_free(owned_a);
+        git_tree_free(owned_b);
+        a = owned_a = next_a;
+        b = owned_b = next_b;
+        if (retval)
+            break;
+    }
+
+    git_tree_free(owned_a);
+    git_tree_free(owned_b);
+    return retval;
+}
+
+typedef struct {
+    git_repository *repo;
+    const egit_commit_graph *graph;
+    git_strarray paths;
+    bool full_history;
+    bool follow;
+    egit_oidmap marks;
+
+    // Earlier names of a followed file, owned by the walk
+    char **names;
+    size_t nnames;
+    size_t alloc_names;
+} path_walk;
+
+static void path_walk_dispose(path_walk *walk)
+{
+    for (size_t i = 0; i < walk->nnames; i++)
+        free(walk->names[i]);
+    free(walk->names);
+    egit_oidmap_dispose(&walk->marks);
+    egit_strarray_dispose(&walk->paths);
+}
+
+static int pathspec_treesame(bool *same, const path_walk *walk, const git_strarray *paths,
+                             const git_tree *a, const git_tree *b)
+{
+    int retval = 0;
+    *same = true;
+    for (size_t i = 0; i < paths->count && *same && !retval; i++)
+        retval = path_treesame(same, walk->repo, a, b, paths->strings[i]);
+    return retval;
+}
+
+/**
+ * Check the changed-path Bloom filter of COMMIT for all PATHS.
+ * @return Whether the filter shows the paths are the same as in the first parent.
+ */
+static bool pathspec_bloom_same(const path_walk *walk, const git_strarray *paths, const git_commit *commit)
+{
+    uint32_t pos;
+    if (!walk->graph || !egit_commit_graph_find(walk->graph, git_commit_id(commit), &pos))
+        return false;
+    for (size_t i = 0; i < paths->count; i++)
+        if (egit_commit_graph_maybe_changed(walk->graph, pos, paths->strings[i]))
+            return false;
+    return true;
+}
+
+static int commit_parent_tree(git_tree **out, const path_walk *walk, const git_commit *commit, unsigned int n)
+{
+    // The commit graph has the tree IDs, which saves parsing the parent
+    uint32_t pos;
+    const git_oid *id = git_commit_parent_id(commit, n);
+    if (walk->graph && egit_commit_graph_find(walk->graph, id, &pos)) {
+        git_oid tree_id;
+        egit_commit_graph_tree_id(&tree_id, walk->graph, pos);
+        return git_tree_lookup(out, walk->repo, &tree_id);
+    }
+
+    git_commit *parent;
+    int retval = git_commit_parent(&parent, commit, n);
+    if (retval)
+        return retval;
+    retval = git_commit_tree(out, parent);
+    git_commit_free(parent);
+    return retval;
+}
+
+/**
+ * Decide whether COMMIT is shown in the history of PATHS, and which of its
+ * parents the walk goes on to.  FOLLOW is set to the index of the only
+ * parent to follow, or to -1 to follow all of them.
+ */
+static int commit_simplify(bool *show, int *follow, const path_walk *walk, const git_strarray *paths,
+                           const git_commit *commit)
+{
+    unsigned int nparents = git_commit_parentcount(commit);
+    git_tree *tree = NULL, *parent_tree = NULL;
+    bool same = false, any_same = false, any_different = false;
+    int retval = 0;
+
+    *follow = -1;
+    if (!nparents) {
+        if (!(retval = git_commit_tree(&tree, commit)))
+            retval = pathspec_treesame(&same, walk, paths, tree, NULL);
+        any_different = !same;
+    }
+
+    for (unsigned int i = 0; i < nparents && !retval; i++) {
+        if (i == 0 && pathspec_bloom_same(walk, paths, commit))
+            same = true;
+        else {
+            if (!tree && (retval = git_commit_tree(&tree, commit)))
+                break;
+            if ((retval = commit_parent_tree(&parent_tree, walk, commit, i)))
+                break;
+            retval = pathspec_treesame(&same, walk, paths, tree, parent_tree);
+            git_tree_free(parent_tree);
+        }
+
+        if (same && !walk->full_history) {
+            // TREESAME to this parent, so the history comes from there
+            *follow = i;
+            any_same = true;
+            break;
+        }
+        any_same = any_same || same;
+        any_different = any_different || !same;
+    }
+
+    git_tree_free(tree);
+    *show = walk->full_history || !nparents ? any_different : !any_same;
+    return retval;
+}
+
+static int tree_has_path(bool *found, const git_tree *tree, const char *path)
+{
+    git_tree_entry *entry;
+    int retval = git_tree_entry_bypath(&entry, tree, path);
+    if (retval == GIT_ENOTFOUND) {
+        giterr_clear();
+        *found = false;
+        return 0;
+    }
+    if (retval)
+        return retval;
+    git_tree_entry_free(entry);
+    *found = true;
+    return 0;
+}
+
+/**
+ * Find the name of the followed file PATH in the parent N of COMMIT.
+ * Renames are only looked for if PATH is missing in the parent, and OUT
+ * is left as PATH if there is none.
+ */
+static int follow_rename(const char **out, path_walk *walk, const git_commit *commit, unsigned int n,
+                         const char *path)
+{
+    git_tree *tree = NULL, *parent_tree = NULL;
+    git_diff *diff = NULL;
+    bool found;
+    *out = path;
+
+    int retval = commit_parent_tree(&parent_tree, walk, commit, n);
+    if (!retval)
+        retval = tree_has_path(&found, parent_tree, path);
+    if (retval || found)
+        goto cleanup;
+
+    // Renames are found among all the files that changed, so this needs the
+    // whole diff; signatures of blobs that were seen before come from the cache
+    git_diff_options diff_opts;
+    git_diff_find_options find_opts;
+    if ((retval = git_commit_tree(&tree, commit)) ||
+        (retval = git_diff_init_options(&diff_opts, GIT_DIFF_OPTIONS_VERSION)) ||
+        (retval = git_diff_tree_to_tree(&diff, walk->repo, parent_tree, tree, &diff_opts)) ||
+        (retval = git_diff_find_init_options(&find_opts, GIT_DIFF_FIND_OPTIONS_VERSION)))
+        goto cleanup;
+    find_opts.flags = GIT_DIFF_FIND_RENAMES;
+    if ((retval = egit_diff_find_similar_cached(diff, &find_opts)))
+        goto cleanup;
+
+    size_t ndeltas = git_diff_num_deltas(diff);
+    for (size_t i = 0; i < ndeltas; i++) {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        if (delta->status != GIT_DELTA_RENAMED || strcmp(delta->new_file.path, path))
+            continue;
+
+        if (walk->nnames == walk->alloc_names) {
+            size_t alloc = walk->alloc_names ? 2 * walk->alloc_names : 16;
+            char **names = (char**) realloc(walk->names, alloc * sizeof(char*));
+            if (!names) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            walk->names = names;
+            walk->alloc_names = alloc;
+        }
+        char *name = strdup(delta->old_file.path);
+        if (!name) {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+            break;
+        }
+        walk->names[walk->nnames++] = name;
+        *out = name;
+        break;
+    }
+
+cleanup:
+    git_diff_free(diff);
+    git_tree_free(tree);
+    git_tree_free(parent_tree);
+    return retval;
+}
+
+// Marks of commits that a walked child reached.  Commits on the simplified
+// history are marked with PATH_WALK_WANTED instead, or with the name of the
+// followed file in that commit.
+#define PATH_WALK_REACHED ((void*) 1)
+#define PATH_WALK_WANTED ((void*) 2)
+
+/**
+ * Mark the parent N of COMMIT as reached from a walked child.  WANTED is
+ * its mark if the simplified history goes through it, or NULL.
+ */
+static bool path_walk_mark(egit_oidmap *marks, const git_commit *commit, unsigned int n, void *wanted)
+{
+    void **slot = egit_oidmap_put(marks, git_commit_parent_id(commit, n), NULL);
+    if (!slot)
+        return false;
+    if (wanted && (!*slot || *slot == PATH_WALK_REACHED))
+        *slot = wanted;
+    else if (!*slot)
+        *slot = PATH_WALK_REACHED;
+    return true;
+}
+
+/**
+ * Find the next commit in REVWALK to show in the simplified history of the
+ * paths in WALK.  REVWALK must sort children before their parents.
+ * @param path Set to the name of the followed file in the commit, if WALK
+ *             follows renames, and otherwise to NULL.
+ * @return 0, GIT_ITEROVER at the end of the walk, or an error code.
+ */
+static int path_walk_next(git_oid *out, const char **path, path_walk *walk, git_revwalk *revwalk)
+{
+    int retval;
+    bool show = false;
+
+    while (!show) {
+        if ((retval = git_revwalk_next(out, revwalk)))
+            return retval;
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, walk->repo, out)))
+            return retval;
+
+        // A commit no walked child reached is a tip, and always wanted
+        void *mark = egit_oidmap_get(&walk->marks, out);
+        bool wanted = mark != PATH_WALK_REACHED, ok = true;
+        const char *current = walk->paths.strings[0];
+        git_strarray paths = walk->paths;
+        if (walk->follow) {
+            if (mark && wanted)
+                current = (const char*) mark;
+            paths.strings = (char**) &current;
+        }
+
+        int follow = -1;
+        if (wanted)
+            retval = commit_simplify(&show, &follow, walk, &paths, commit);
+
+        unsigned int nparents = git_commit_parentcount(commit);
+        for (unsigned int i = 0; !retval && ok && i < nparents; i++) {
+            void *value = NULL;
+            bool simplified = wanted && (follow < 0 || (unsigned int) follow == i);
+            if (simplified && walk->follow) {
+                // Only a commit that changed the file can have renamed it
+                const char *name = current;
+                if (show && follow < 0)
+                    retval = follow_rename(&name, walk, commit, i, current);
+                value = (void*) name;
+            }
+            else if (simplified)
+                value = PATH_WALK_WANTED;
+            if (!retval)
+                ok = path_walk_mark(&walk->marks, commit, i, value);
+        }
+        git_commit_free(commit);
+
+        if (!retval && !ok) {
+            giterr_set_oom();
+            retval = GIT_ERROR;
+        }
+        if (retval)
+            return retval;
+        *path = walk->follow ? current : NULL;
+    }
+
+    return 0;
+}
+
+EGIT_DOC(log_path, "REPOSITORY PATHSPEC &optional OPTIONS",
+         "Return a vector of the IDs of the commits that changed PATHSPEC, newest first.\n"
+         "PATHSPEC is a path or a list of paths, each of which covers the file or\n"
+         "directory at that path.  Wildcards are not supported.\n\n"
+         "History is simplified like `git log': a merge with a parent in which\n"
+         "PATHSPEC is the same is not listed, and only that parent is followed.\n"
+         "OPTIONS is an alist with the following allowed keys:\n"
+         "- `revisions': the commits to walk, like SPEC in `libgit-log' (default HEAD)\n"
+         "- `limit': the maximum number of commits to return\n"
+         "- `full-history': if non-nil, follow all parents of merges, and list\n"
+         "     every commit that differs from at least one parent\n"
+         "- `follow': if non-nil, PATHSPEC must be a single file, which is followed\n"
+         "     across renames; the elements of the vector are then conses\n"
+         "     (ID . PATH), where PATH is the name of the file in that commit\n\n"
+         "Trees are only read along the paths in PATHSPEC.  If the commit-graph file\n"
+         "of REPOSITORY has changed-path Bloom filters (see `libgit-commit-graph-write'),\n"
+         "commits they rule out are not compared to their first parent at all.\n"
+         "When following renames, rename detection only runs on commits that add\n"
+         "the file, and shares its cache of file signatures with\n"
+         "`libgit-diff-find-similar'.");
+emacs_value egit_log_path(emacs_env *env, emacs_value _repo, emacs_value pathspec, emacs_value options)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    log_path_options opts;
+    extract_log_path_options(env, options, &opts, LOG_OPTIONS_SIMPLIFY);
+    EM_RETURN_NIL_IF_NLE();
+
+    path_walk walk;
+    memset(&walk, 0, sizeof(path_walk));
+    walk.repo = repo;
+    walk.graph = egit_commit_graph_get(repo);
+    walk.full_history = opts.full_history;
+    walk.follow = opts.follow;
+    if (!em_listp(env, pathspec)) {
+        EM_ASSERT_STRING(pathspec);
+        pathspec = em_cons(env, pathspec, esym_nil);
+    }
+    if (!egit_strarray_from_list(&walk.paths, env, pathspec))
+        return esym_nil;
+    for (size_t i = 0; i < walk.paths.count; i++)
+        normalize_path(walk.paths.strings[i]);
+    if (walk.follow && walk.paths.count != 1) {
+        egit_strarray_dispose(&walk.paths);
+        em_signal_wrong_value(env, pathspec);
+        return esym_nil;
+    }
+
+    // Children come before parents, so the marks of a commit are final when
+    // it comes out of the walk
+    git_revwalk *revwalk;
+    int retval = git_revwalk_new(&revwalk, repo);
+    if (egit_dispatch_error(env, retval)) {
+        path_walk_dispose(&walk);
+        return esym_nil;
+    }
+    git_revwalk_sorting(revwalk, GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+    if (!push_specs(env, revwalk, repo, opts.revisions)) {
+        git_revwalk_free(revwalk);
+        path_walk_dispose(&walk);
+        return esym_nil;
+    }
+
+    emacs_value *ids = NULL;
+    size_t nids = 0, alloc = 0;
+    git_oid oid;
+    const char *path;
+
+    while (opts.limit < 0 || (intmax_t) nids < opts.limit) {
+        if ((retval = path_walk_next(&oid, &path, &walk, revwalk)))
+            break;
+
+        if (nids == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(ids, alloc * sizeof(emacs_value));
+            if (!grown) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            ids = grown;
+        }
+        emacs_value id = EM_STRING(git_oid_tostr_s(&oid));
+        ids[nids++] = path ? em_cons(env, id, EM_STRING(path)) : id;
+        if (env->non_local_exit_check(env))
+            break;
+    }
+
+    git_revwalk_free(revwalk);
+    path_walk_dispose(&walk);
+
+    emacs_value ret = esym_nil;
+    if ((retval == 0 || retval == GIT_ITEROVER) && !env->non_local_exit_check(env)) {
+        retval = 0;
+        ret = em_vector(env, ids, nids);
+    }
+    free(ids);
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Line-range history
+
+/**
+ * A commit waiting in the line-range walk, with the lines of the file at
+ * PATH that are tracked in its version.
+ */
+typedef struct {
+    const char *path;
+    egit_rangebuf ranges;
+} line_origin;
+
+static int tree_blob_id(git_oid *out, bool *found, const git_tree *tree, const char *path)
+{
+    git_tree_entry *entry;
+    int retval = git_tree_entry_bypath(&entry, tree, path);
+    if (retval == GIT_ENOTFOUND) {
+        giterr_clear();
+        *found = false;
+        return 0;
+    }
+    if (retval)
+        return retval;
+
+    *found = git_tree_entry_type(entry) == GIT_OBJ_BLOB;
+    if (*found)
+        git_oid_cpy(out, git_tree_entry_id(entry));
+    git_tree_entry_free(entry);
+    return 0;
+}
+
+/**
+ * Sort the ranges in BUF and merge the ones that overlap or touch.
+ * The final line numbers are not used here.
+ */
+static void line_ranges_normalize(egit_rangebuf *buf)
+{
+    egit_rangebuf_sort(buf);
+    if (buf->size < 2)
+        return;
+
+    size_t out = 0;
+    for (size_t i = 1; i < buf->size; i++) {
+        egit_line_range *last = &buf->ptr[out];
+        egit_line_range *next = &buf->ptr[i];
+        if (next->start <= last->start + last->lines) {
+            size_t end = next->start + next->lines;
+            if (end > last->start + last->lines)
+                last->lines = end - last->start;
+        }
+        else
+            buf->ptr[++out] = *next;
+    }
+    buf->size = out + 1;
+}
+
+/**
+ * Map LINE on the new side of HUNKS to the old side.  A line inside a hunk
+ * maps to the first or, if END is set, the last old line of that hunk, so
+ * that a range keeps the old version of everything it covers.
+ */
+static intmax_t line_to_parent(const egit_intbuf *hunks, intmax_t line, bool end)
+{
+    intmax_t delta = 0;
+    for (size_t i = 0; i + 4 <= hunks->size; i += 4) {
+        const intmax_t *h = &hunks->ptr[i];
+        intmax_t old_start = h[0], old_lines = h[1], new_start = h[2], new_lines = h[3];
+
+        if (new_lines > 0 && new_start <= line && line < new_start + new_lines) {
+            // A hunk that only adds lines has OLD-START set to the line before
+            if (old_lines == 0)
+                return end ? old_start : old_start + 1;
+            return end ? old_start + old_lines - 1 : old_start;
+        }
+        if (new_lines == 0 ? new_start >= line : new_start > line)
+            break;
+        delta += old_lines - new_lines;
+    }
+    return line + delta;
+}
+
+/**
+ * Map RANGES through HUNKS into OUT, on the old side.  TOUCHED is set to
+ * whether some hunk changes, adds or removes lines inside the ranges.
+ */
+static bool line_ranges_to_parent(egit_rangebuf *out, bool *touched, const egit_rangebuf *ranges,
+                                  const egit_intbuf *hunks)
+{
+    *touched = false;
+    for (size_t i = 0; i < ranges->size; i++) {
+        intmax_t start = ranges->ptr[i].start, end = start + ranges->ptr[i].lines - 1;
+
+        for (size_t j = 0; j + 4 <= hunks->size && !*touched; j += 4) {
+            intmax_t new_start = hunks->ptr[j + 2], new_lines = hunks->ptr[j + 3];
+            if (new_lines > 0)
+                *touched = new_start <= end && new_start + new_lines > start;
+            else
+                *touched = start <= new_start && new_start < end;
+        }
+
+        intmax_t old_start = line_to_parent(hunks, start, false);
+        intmax_t old_end = line_to_parent(hunks, end, true);
+        if (old_end >= old_start &&
+            !egit_rangebuf_push(out, old_start, old_start, old_end - old_start + 1))
+            return false;
+    }
+
+    line_ranges_normalize(out);
+    return true;
+}
+
+typedef struct {
+    path_walk base;
+    const char *path;
+    size_t start;
+    size_t end;
+} line_walk;
+
+/**
+ * Hand RANGES of the file at PATH over to the parent N of COMMIT.  A parent
+ * that already has lines from another child adds these to them.
+ */
+static int line_walk_pass(line_walk *walk, const git_commit *commit, unsigned int n, const char *path,
+                          egit_rangebuf *ranges)
+{
+    void **slot = egit_oidmap_put(&walk->base.marks, git_commit_parent_id(commit, n), NULL);
+    if (!slot) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+    if (ranges->size == 0) {
+        if (!*slot)
+            *slot = PATH_WALK_REACHED;
+        return 0;
+    }
+
+    line_origin *origin = (line_origin*) *slot;
+    if (!origin || *slot == PATH_WALK_REACHED) {
+        origin = (line_origin*) calloc(1, sizeof(line_origin));
+        if (!origin) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        origin->path = path;
+        origin->ranges = *ranges;
+        memset(ranges, 0, sizeof(egit_rangebuf));
+        *slot = origin;
+        return 0;
+    }
+
+    // The same commit seen through two children keeps the first name
+    for (size_t i = 0; i < ranges->size && !strcmp(origin->path, path); i++) {
+        const egit_line_range *r = &ranges->ptr[i];
+        if (!egit_rangebuf_push(&origin->ranges, r->start, r->start, r->lines))
+            return GIT_ERROR;
+    }
+    line_ranges_normalize(&origin->ranges);
+    return 0;
+}
+
+/**
+ * Start tracking the lines of WALK in the tip COMMIT.
+ */
+static int line_walk_tip(line_origin **out, line_walk *walk, const git_commit *commit)
+{
+    git_tree *tree;
+    git_tree_entry *entry;
+    git_blob *blob;
+    int retval = git_commit_tree(&tree, commit);
+    if (retval)
+        return retval;
+    retval = git_tree_entry_bypath(&entry, tree, walk->path);
+    git_tree_free(tree);
+    if (retval)
+        return retval;
+    retval = git_blob_lookup(&blob, walk->base.repo, git_tree_entry_id(entry));
+    git_tree_entry_free(entry);
+    if (retval)
+        return retval;
+
+    size_t nlines = egit_count_lines(git_blob_rawcontent(blob), git_blob_rawsize(blob));
+    git_blob_free(blob);
+    if (walk->end > nlines) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "File has only %lu lines", (unsigned long) nlines);
+        giterr_set_str(GITERR_INVALID, msg);
+        return GIT_EINVALID;
+    }
+
+    line_origin *origin = (line_origin*) calloc(1, sizeof(line_origin));
+    if (!origin) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+    origin->path = walk->path;
+    if (!egit_rangebuf_push(&origin->ranges, walk->start, walk->start, walk->end - walk->start + 1)) {
+        free(origin);
+        return GIT_ERROR;
+    }
+    *out = origin;
+    return 0;
+}
+
+/**
+ * Pass the lines of ORIGIN on to the parents of COMMIT.
+ * @param show Set to whether COMMIT changed some of the lines.
+ */
+static int line_walk_step(bool *show, line_walk *walk, const git_commit *commit, line_origin *origin)
+{
+    unsigned int nparents = git_commit_parentcount(commit);
+    git_tree *tree = NULL, *parent_tree = NULL;
+    git_blob *blob = NULL, *parent_blob = NULL;
+    egit_rangebuf *mapped = NULL;
+    const char **names = NULL;
+    egit_intbuf hunks = {0};
+    git_oid blob_id, parent_id;
+    bool found;
+    int retval;
+
+    *show = true;
+    if ((retval = git_commit_tree(&tree, commit)) ||
+        (retval = tree_blob_id(&blob_id, &found, tree, origin->path)))
+        goto cleanup;
+    if (!found || !nparents)
+        goto cleanup;
+    if ((retval = git_blob_lookup(&blob, walk->base.repo, &blob_id)))
+        goto cleanup;
+
+    names = (const char**) calloc(nparents, sizeof(const char*));
+    mapped = (egit_rangebuf*) calloc(nparents, sizeof(egit_rangebuf));
+    if (!names || !mapped) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+        goto cleanup;
+    }
+
+    // Map the lines into every parent that has the file, possibly under an
+    // earlier name.  A parent where none of them changed takes them all.
+    int only = -1;
+    for (unsigned int i = 0; i < nparents && only < 0; i++) {
+        if ((retval = commit_parent_tree(&parent_tree, &walk->base, commit, i)) ||
+            (retval = follow_rename(&names[i], &walk->base, commit, i, origin->path)) ||
+            (retval = tree_blob_id(&parent_id, &found, parent_tree, names[i])))
+            break;
+        git_tree_free(parent_tree);
+        parent_tree = NULL;
+        if (!found)
+            continue;
+
+        bool touched = false;
+        if (git_oid_equal(&parent_id, &blob_id)) {
+            for (size_t j = 0; j < origin->ranges.size && !retval; j++) {
+                const egit_line_range *r = &origin->ranges.ptr[j];
+                if (!egit_rangebuf_push(&mapped[i], r->start, r->start, r->lines))
+                    retval = GIT_ERROR;
+            }
+        }
+        else {
+            hunks.size = 0;
+            if (!(retval = git_blob_lookup(&parent_blob, walk->base.repo, &parent_id)))
+                retval = egit_diff_blob_hunks(&hunks, parent_blob, blob);
+            git_blob_free(parent_blob);
+            if (!retval && !line_ranges_to_parent(&mapped[i], &touched, &origin->ranges, &hunks))
+                retval = GIT_ERROR;
+        }
+        if (retval)
+            break;
+        if (!touched)
+            only = i;
+    }
+
+    for (unsigned int i = 0; i < nparents && !retval; i++) {
+        if (only >= 0 && (unsigned int) only != i)
+            mapped[i].size = 0;
+        retval = line_walk_pass(walk, commit, i, names[i] ? names[i] : origin->path, &mapped[i]);
+    }
+    *show = only < 0;
+
+cleanup:
+    free(names);
+    if (mapped) {
+        for (unsigned int i = 0; i < nparents; i++)
+            egit_rangebuf_dispose(&mapped[i]);
+        free(mapped);
+    }
+    egit_intbuf_dispose(&hunks);
+    git_blob_free(blob);
+    git_tree_free(tree);
+    git_tree_free(parent_tree);
+    return retval;
+}
+
+/**
+ * Find the next commit in REVWALK that changed the lines of WALK, and move
+ * those lines, in that commit, into RANGES.  REVWALK must sort children
+ * before their parents.
+ * @return 0, GIT_ITEROVER at the end of the walk, or an error code.
+ */
+static int line_walk_next(git_oid *out, egit_rangebuf *ranges, line_walk *walk, git_revwalk *revwalk)
+{
+    int retval;
+    bool show = false;
+
+    while (!show) {
+        if ((retval = git_revwalk_next(out, revwalk)))
+            return retval;
+
+        void **slot = egit_oidmap_put(&walk->base.marks, out, NULL);
+        if (!slot) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        line_origin *origin = *slot == PATH_WALK_REACHED ? NULL : (line_origin*) *slot;
+        bool tip = !*slot;
+
+        git_commit *commit;
+        if ((retval = git_commit_lookup(&commit, walk->base.repo, out)))
+            return retval;
+        if (tip)
+            retval = line_walk_tip(&origin, walk, commit);
+
+        if (!retval && origin)
+            retval = line_walk_step(&show, walk, commit, origin);
+        else {
+            unsigned int nparents = git_commit_parentcount(commit);
+            egit_rangebuf none = {0};
+            for (unsigned int i = 0; !retval && i < nparents; i++)
+                retval = line_walk_pass(walk, commit, i, walk->path, &none);
+        }
+        git_commit_free(commit);
+
+        // The map may have grown, so the slot is looked up again
+        if (origin) {
+            if (show && !retval) {
+                *ranges = origin->ranges;
+                memset(&origin->ranges, 0, sizeof(egit_rangebuf));
+            }
+            egit_rangebuf_dispose(&origin->ranges);
+            free(origin);
+            *egit_oidmap_put(&walk->base.marks, out, NULL) = PATH_WALK_REACHED;
+        }
+        if (retval)
+            return retval;
+    }
+
+    return 0;
+}
+
+static void line_walk_dispose(line_walk *walk)
+{
+    egit_oidmap *marks = &walk->base.marks;
+    for (size_t i = 0; i < marks->alloc; i++) {
+        line_origin *origin = (line_origin*) marks->values[i];
+        if (!marks->used[i] || !origin || marks->values[i] == PATH_WALK_REACHED)
+            continue;
+        egit_rangebuf_dispose(&origin->ranges);
+        free(origin);
+    }
+    path_walk_dispose(&walk->base);
+}
+
+EGIT_DOC(log_line_range, "REPOSITORY PATH START END &optional OPTIONS",
+         "Return the history of lines START to END of the file at PATH, like `git log -L'.\n"
+         "The value is a vector of conses (ID . RANGES), newest first, for the\n"
+         "commits that changed some of the lines.  RANGES is a vector of the form\n"
+         "[START END START END ...] with the lines in that commit's version of\n"
+         "the file.  Line numbers are 1-based, and END is inclusive.\n\n"
+         "The lines are mapped through the diff of every commit to its parents.\n"
+         "The file is followed across renames, and a merge whose lines all come\n"
+         "from one parent is not listed.  OPTIONS is an alist that takes the\n"
+         "keys `revisions' and `limit', as in `libgit-log-path'.");
+emacs_value egit_log_line_range(emacs_env *env, emacs_value _repo, emacs_value _path,
+                                emacs_value _start, emacs_value _end, emacs_value options)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_path);
+    EM_ASSERT_INTEGER(_start);
+    EM_ASSERT_INTEGER(_end);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    intmax_t start = EM_EXTRACT_INTEGER(_start), end = EM_EXTRACT_INTEGER(_end);
+    if (start < 1) {
+        em_signal_args_out_of_range(env, start);
+        return esym_nil;
+    }
+    if (end < start) {
+        em_signal_args_out_of_range(env, end);
+        return esym_nil;
+    }
+
+    log_path_options opts;
+    extract_log_path_options(env, options, &opts, 0);
+    EM_RETURN_NIL_IF_NLE();
+
+    git_revwalk *revwalk;
+    int retval = git_revwalk_new(&revwalk, repo);
+    EGIT_CHECK_ERROR(retval);
+    git_revwalk_sorting(revwalk, GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+    if (!push_specs(env, revwalk, repo, opts.revisions)) {
+        git_revwalk_free(revwalk);
+        return esym_nil;
+    }
+
+    line_walk walk;
+    memset(&walk, 0, sizeof(line_walk));
+    walk.base.repo = repo;
+    walk.base.graph = egit_commit_graph_get(repo);
+    walk.path = EM_EXTRACT_STRING(_path);
+    walk.start = start;
+    walk.end = end;
+
+    emacs_value *commits = NULL;
+    size_t ncommits = 0, alloc = 0;
+    egit_rangebuf ranges = {0};
+    egit_intbuf lines = {0};
+    git_oid oid;
+
+    while (opts.limit < 0 || (intmax_t) ncommits < opts.limit) {
+        if ((retval = line_walk_next(&oid, &ranges, &walk, revwalk)))
+            break;
+
+        lines.size = 0;
+        for (size_t i = 0; i < ranges.size; i++) {
+            const egit_line_range *r = &ranges.ptr[i];
+            if (!egit_intbuf_push(&lines, r->start) || !egit_intbuf_push(&lines, r->start + r->lines - 1)) {
+                retval = GIT_ERROR;
+                break;
+            }
+        }
+        egit_rangebuf_dispose(&ranges);
+        if (retval)
+            break;
+
+        if (ncommits == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(commits, alloc * sizeof(emacs_value));
+            if (!grown) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            commits = grown;
+        }
+        commits[ncommits++] = em_cons(env, EM_STRING(git_oid_tostr_s(&oid)),
+                                      em_integer_vector(env, lines.ptr, lines.size));
+        if (env->non_local_exit_check(env))
+            break;
+    }
+
+    git_revwalk_free(revwalk);
+    line_walk_dispose(&walk);
+    free((char*) walk.path);
+    egit_intbuf_dispose(&lines);
+
+    emacs_value ret = esym_nil;
+    if ((retval == 0 || retval == GIT_ITEROVER) && !env->non_local_exit_check(env)) {
+        retval = 0;
+        ret = em_vector(env, commits, ncommits);
+    }
+    free(commits);
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Pickaxe
+
+typedef struct {
+    const char *needle;
+    size_t len;
+#ifndef _WIN32
+    regex_t regexp;
+#endif
+    bool has_regexp;
+    git_strarray paths;
+} pickaxe;
+
+/**
+ * Per-thread state of the pickaxe search.  Each worker opens its own
+ * repository, so objects are cached and packs are mapped per thread.
+ */
+typedef struct {
+    git_repository *repo;
+    char *text;
+    size_t alloc;
+} pickaxe_worker;
+
+/**
+ * Count the non-overlapping occurrences of the pickaxe in a blob, the way
+ * `git log -S' does.
+ */
+static int pickaxe_count(size_t *count, pickaxe_worker *worker, const pickaxe *px, const git_blob *blob)
+{
+    const char *data = (const char*) git_blob_rawcontent(blob);
+    size_t size = (size_t) git_blob_rawsize(blob);
+    *count = 0;
+
+    if (!px->has_regexp) {
+        const char *end = data + size, *p = data;
+        while ((p = egit_memmem(p, end - p, px->needle, px->len))) {
+            (*count)++;
+            p += px->len;
+        }
+        return 0;
+    }
+
+#ifndef _WIN32
+    // regexec needs a terminated string
+    if (size + 1 > worker->alloc) {
+        char *text = (char*) realloc(worker->text, size + 1);
+        if (!text) {
+            giterr_set_oom();
+            return GIT_ERROR;
+        }
+        worker->text = text;
+        worker->alloc = size + 1;
+    }
+    memcpy(worker->text, data, size);
+    worker->text[size] = '\0';
+
+    const char *p = worker->text;
+    int flags = 0;
+    regmatch_t match;
+    while (*p && !regexec(&px->regexp, p, 1, &match, flags)) {
+        flags = REG_NOTBOL;
+        (*count)++;
+        p += match.rm_eo;
+        if (*p && match.rm_so == match.rm_eo)
+            p++;
+    }
+#endif
+    return 0;
+}
+
+static int pickaxe_file_count(size_t *count, bool *binary, pickaxe_worker *worker, const pickaxe *px,
+                              const git_diff_file *file)
+{
+    *count = 0;
+    if (!(file->flags & GIT_DIFF_FLAG_EXISTS) || (file->mode & 0170000) != 0100000)
+        return 0;
+
+    git_blob *blob;
+    int retval = git_blob_lookup(&blob, worker->repo, &file->id);
+    if (retval)
+        return retval;
+    *binary = *binary || git_blob_is_binary(blob);
+    if (!*binary)
+        retval = pickaxe_count(count, worker, px, blob);
+    git_blob_free(blob);
+    return retval;
+}
+
+/**
+ * Check whether the commit ID changes the number of occurrences of the
+ * pickaxe in any file.  Like `git log', merges are not diffed, and root
+ * commits are diffed against the empty tree.  Binary files are skipped.
+ */
+static int pickaxe_commit(bool *match, pickaxe_worker *worker, const pickaxe *px, const git_oid *id)
+{
+    git_commit *commit = NULL, *parent = NULL;
+    git_tree *tree = NULL, *parent_tree = NULL;
+    git_diff *diff = NULL;
+    int retval;
+    *match = false;
+
+    if ((retval = git_commit_lookup(&commit, worker->repo, id)))
+        goto cleanup;
+    if (git_commit_parentcount(commit) > 1)
+        goto cleanup;
+    if (git_commit_parentcount(commit) == 1 &&
+        ((retval = git_commit_parent(&parent, commit, 0)) ||
+         (retval = git_commit_tree(&parent_tree, parent))))
+        goto cleanup;
+    if ((retval = git_commit_tree(&tree, commit)))
+        goto cleanup;
+
+    git_diff_options opts;
+    if ((retval = git_diff_init_options(&opts, GIT_DIFF_OPTIONS_VERSION)))
+        goto cleanup;
+    opts.pathspec = px->paths;
+    if ((retval = git_diff_tree_to_tree(&diff, worker->repo, parent_tree, tree, &opts)))
+        goto cleanup;
+
+    // Like in `git log', a renamed file is compared to its old version.
+    // The rename detection of libgit2 is used directly, since the signature
+    // cache of `libgit-diff-find-similar' may not be shared between threads.
+    size_t ndeltas = git_diff_num_deltas(diff);
+    if (git_diff_num_deltas_of_type(diff, GIT_DELTA_ADDED) &&
+        git_diff_num_deltas_of_type(diff, GIT_DELTA_DELETED)) {
+        git_diff_find_options find_opts;
+        if ((retval = git_diff_find_init_options(&find_opts, GIT_DIFF_FIND_OPTIONS_VERSION)))
+            goto cleanup;
+        find_opts.flags = GIT_DIFF_FIND_RENAMES;
+        if ((retval = git_diff_find_similar(diff, &find_opts)))
+            goto cleanup;
+        ndeltas = git_diff_num_deltas(diff);
+    }
+
+    for (size_t i = 0; i < ndeltas && !*match; i++) {
+        const git_diff_delta *delta = git_diff_get_delta(diff, i);
+        size_t old_count, new_count;
+        bool binary = false;
+        if ((retval = pickaxe_file_count(&old_count, &binary, worker, px, &delta->old_file)) ||
+            (retval = pickaxe_file_count(&new_count, &binary, worker, px, &delta->new_file)))
+            goto cleanup;
+        *match = !binary && old_count != new_count;
+    }
+
+cleanup:
+    git_diff_free(diff);
+    git_tree_free(parent_tree);
+    git_tree_free(tree);
+    git_commit_free(parent);
+    git_commit_free(commit);
+    return retval;
+}
+
+typedef struct {
+    const char *repo_path;
+    const pickaxe *px;
+    const git_oid *ids;
+    signed char *results;
+} pickaxe_ctx;
+
+// Each worker thread has its own repository handle.
+static void *pickaxe_init(void *payload)
+{
+    pickaxe_ctx *ctx = (pickaxe_ctx*) payload;
+    pickaxe_worker *worker = (pickaxe_worker*) calloc(1, sizeof(pickaxe_worker));
+    if (worker && git_repository_open(&worker->repo, ctx->repo_path)) {
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static void pickaxe_cleanup(void *state, __attribute__((unused)) void *payload)
+{
+    pickaxe_worker *worker = (pickaxe_worker*) state;
+    if (!worker)
+        return;
+    git_repository_free(worker->repo);
+    free(worker->text);
+    free(worker);
+}
+
+static int pickaxe_one(size_t index, void *state, void *payload)
+{
+    pickaxe_ctx *ctx = (pickaxe_ctx*) payload;
+    if (!state)
+        return 1;
+
+    // Failed commits are searched again on the main thread, where errors
+    // can be signaled
+    bool match;
+    if (!pickaxe_commit(&match, state, ctx->px, &ctx->ids[index]))
+        ctx->results[index] = match;
+    return 0;
+}
+
+// Number of commits handed to the threads at a time, per thread
+#define PICKAXE_BATCH 64
+
+EGIT_DOC(log_pickaxe, "REPOSITORY STRING &optional PATHSPEC REGEXP OPTIONS",
+         "Return a vector of the IDs of the commits that change the number of\n"
+         "occurrences of STRING in a file, newest first, like `git log -S'.\n"
+         "If REGEXP is non-nil, STRING is a POSIX extended regular expression\n"
+         "instead, like `git log -S --pickaxe-regex' (not available on Windows).\n\n"
+         "Like in `git log', merges are not searched, renamed files are compared\n"
+         "to their old version, and binary files are skipped.  PATHSPEC is a\n"
+         "path or a list of paths that limits the files that are searched.\n"
+         "OPTIONS is an alist with the following allowed keys:\n"
+         "- `revisions': the commits to walk, like SPEC in `libgit-log' (default HEAD)\n"
+         "- `limit': the maximum number of commits to return\n"
+         "- `parallel': the number of threads, at least 1, or t for the number\n"
+         "     of processors (the default)\n\n"
+         "Commits are searched in batches on all threads, and the results are\n"
+         "collected in walk order.  Each thread opens REPOSITORY again and has\n"
+         "its own object cache, since libgit2 repositories can't be shared\n"
+         "between threads.");
+emacs_value egit_log_pickaxe(emacs_env *env, emacs_value _repo, emacs_value _string,
+                             emacs_value pathspec, emacs_value regexp, emacs_value options)
+{
+    EGIT_ASSERT_REPOSITORY(_repo);
+    EM_ASSERT_STRING(_string);
+    git_repository *repo = EGIT_EXTRACT(_repo);
+
+    log_path_options opts;
+    extract_log_path_options(env, options, &opts, LOG_OPTIONS_PARALLEL);
+    EM_RETURN_NIL_IF_NLE();
+
+    if (EM_EXTRACT_BOOLEAN(pathspec) && !em_listp(env, pathspec)) {
+        EM_ASSERT_STRING(pathspec);
+        pathspec = em_cons(env, pathspec, esym_nil);
+    }
+
+    pickaxe px;
+    memset(&px, 0, sizeof(pickaxe));
+    char *needle = EM_EXTRACT_STRING(_string);
+    px.needle = needle;
+    px.len = strlen(needle);
+    if (px.len == 0) {
+        free(needle);
+        em_signal_wrong_value(env, _string);
+        return esym_nil;
+    }
+
+    if (EM_EXTRACT_BOOLEAN(regexp)) {
+#ifdef _WIN32
+        free(needle);
+        giterr_set_str(GITERR_INVALID, "Regular expressions are not supported on this platform");
+        EGIT_CHECK_ERROR(GIT_ERROR);
+#else
+        int retval = regcomp(&px.regexp, needle, REG_EXTENDED | REG_NEWLINE);
+        if (retval) {
+            char msg[256];
+            regerror(retval, &px.regexp, msg, sizeof(msg));
+            free(needle);
+            giterr_set_str(GITERR_INVALID, msg);
+            EGIT_CHECK_ERROR(GIT_ERROR);
+        }
+        px.has_regexp = true;
+#endif
+    }
+
+    git_revwalk *revwalk = NULL;
+    git_oid *batch = NULL;
+    signed char *results = NULL;
+    emacs_value *ids = NULL;
+    size_t nids = 0, alloc = 0;
+    pickaxe_worker main_worker = {repo, NULL, 0};
+
+    int retval = 0;
+    if (!egit_strarray_from_list(&px.paths, env, pathspec))
+        goto cleanup;
+
+    size_t batch_size = PICKAXE_BATCH * (opts.threads > 1 ? opts.threads : 1);
+    batch = (git_oid*) malloc(batch_size * sizeof(git_oid));
+    results = (signed char*) malloc(batch_size);
+    if (!batch || !results) {
+        giterr_set_oom();
+        retval = GIT_ERROR;
+        goto cleanup;
+    }
+
+    if ((retval = git_revwalk_new(&revwalk, repo)))
+        goto cleanup;
+    git_revwalk_sorting(revwalk, GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+    if (!push_specs(env, revwalk, repo, opts.revisions))
+        goto cleanup;
+
+    bool done = false;
+    while (!done && (opts.limit < 0 || (intmax_t) nids < opts.limit)) {
+        size_t nbatch = 0;
+        while (nbatch < batch_size && !(retval = git_revwalk_next(&batch[nbatch], revwalk)))
+            results[nbatch++] = -1;
+        if (retval == GIT_ITEROVER) {
+            retval = 0;
+            done = true;
+        }
+        if (retval)
+            break;
+
+        if (opts.threads > 1 && nbatch > 1) {
+            pickaxe_ctx ctx = {git_repository_path(repo), &px, batch, results};
+            egit_parallel_for(nbatch, opts.threads, &pickaxe_init, &pickaxe_cleanup, &pickaxe_one, &ctx);
+        }
+
+        for (size_t i = 0; i < nbatch && (opts.limit < 0 || (intmax_t) nids < opts.limit); i++) {
+            if (results[i] < 0) {
+                bool match;
+                if ((retval = pickaxe_commit(&match, &main_worker, &px, &batch[i])))
+                    goto cleanup;
+                results[i] = match;
+            }
+            if (!results[i])
+                continue;
+
+            if (nids == alloc) {
+                alloc = alloc ? 2 * alloc : 64;
+                emacs_value *grown = (emacs_value*) realloc(ids, alloc * sizeof(emacs_value));
+                if (!grown) {
+                    giterr_set_oom();
+                    retval = GIT_ERROR;
+                    goto cleanup;
+                }
+                ids = grown;
+            }
+            ids[nids++] = EM_STRING(git_oid_tostr_s(&batch[i]));
+        }
+    }
+
+cleanup:;
+    emacs_value ret = esym_nil;
+    if (!retval && !env->non_local_exit_check(env))
+        ret = em_vector(env, ids, nids);
+
+    free(ids);
+    free(results);
+    free(batch);
+    free(main_worker.text);
+    git_revwalk_free(revwalk);
+    egit_strarray_dispose(&px.paths);
+#ifndef _WIN32
+    if (px.has_regexp)
+        regfree(&px.regexp);
+#endif
+    free(needle);
+
+    EM_RETURN_NIL_IF_NLE();
+    EGIT_CHECK_ERROR(retval);
+    return ret;
+}
@@ -0,0 +1,25 @@
+#include "egit.h"
+
+#ifndef EGIT_LOG_H
+#define EGIT_LOG_H
+
+/**
+ * A revision walk over the commits of a log, kept between pages.
+ */
+typedef struct egit_log_cursor egit_log_cursor;
+void egit_log_cursor_free(egit_log_cursor *cursor);
+
+EGIT_DEFUN(log, emacs_value _repo, emacs_value spec, emacs_value fields, emacs_value _limit,
+           emacs_value _offset);
+EGIT_DEFUN(log_cursor_new, emacs_value _repo, emacs_value spec, emacs_value fields,
+           emacs_value _sorting);
+EGIT_DEFUN(log_cursor_next, emacs_value _cursor, emacs_value _n);
+EGIT_DEFUN(log_cursor_valid_p, emacs_value _cursor);
+EGIT_DEFUN(log_graph, emacs_value _revwalk, emacs_value _n, emacs_value fields, emacs_value _lanes);
+EGIT_DEFUN(log_path, emacs_value _repo, emacs_value _path, emacs_value options);
+EGIT_DEFUN(log_line_range, emacs_value _repo, emacs_value _path, emacs_value _start,
+           emacs_value _end, emacs_value options);
+EGIT_DEFUN(log_pickaxe, emacs_value _repo, emacs_value _string, emacs_value pathspec,
+           emacs_value regexp, emacs_value options);
+
+#endif /* EGIT_LOG_H */
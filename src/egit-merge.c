@@ -3,6 +3,7 @@
 #include "git2.h"
 
 #include "egit.h"
+#include "egit-commit-graph.h"
 #include "egit-options.h"
 #include "interface.h"
 #include "egit-merge.h"
@@ -135,12 +136,29 @@ emacs_value egit_merge_base(emacs_env *env, emacs_value _repo, emacs_value _ids)
         EM_DOLIST_END(get_ids);
     }
 
+    // Use the commit-graph file if all the commits are in it
+    egit_commit_graph *graph = nids >= 2 ? egit_commit_graph_get(repo) : NULL;
+    uint32_t positions[nids];
+    for (i = 0; graph && i < nids; i++)
+        if (!egit_commit_graph_find(graph, &ids[i], &positions[i]))
+            graph = NULL;
+
     git_oid out;
-    int retval;
-    if (nids == 2)
-        retval = git_merge_base(&out, repo, &ids[0], &ids[1]);
-    else
-        retval = git_merge_base_many(&out, repo, nids, ids);
+    int retval = 0;
+    if (graph) {
+        uint32_t base;
+        retval = egit_commit_graph_merge_base(&base, graph, positions, nids);
+        if (!retval)
+            egit_commit_graph_id(&out, graph, base);
+    }
+
+    // Leave the choice among several merge bases to libgit2
+    if (!graph || retval == GIT_EAMBIGUOUS) {
+        if (nids == 2)
+            retval = git_merge_base(&out, repo, &ids[0], &ids[1]);
+        else
+            retval = git_merge_base_many(&out, repo, nids, ids);
+    }
     EGIT_CHECK_ERROR(retval);
 
     const char *oid_s = git_oid_tostr_s(&out);
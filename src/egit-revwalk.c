@@ -1,13 +1,381 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <regex.h>
+#endif
+
 #include "git2.h"
 
 #include "egit.h"
+#include "egit-commit-graph.h"
+#include "egit-util.h"
 #include "interface.h"
 #include "egit-revwalk.h"
 
 
+// =============================================================================
+// Limited walks
+
+// Number of commits older than the `since' limit that may come out of a
+// time-sorted walk before it stops, to allow for clock skew
+#define SINCE_SLOP 5
+
+struct egit_revwalk {
+    git_revwalk *walk;
+    git_sort_t sorting;
+
+    // Limits set by `libgit-revwalk-limit'
+    bool has_since, has_until;
+    git_time_t since, until;
+    intmax_t max_count;
+    intmax_t skip;
+
+    // Hide specifications set by `libgit-revwalk-hide-where'
+    git_strarray hide_globs;
+    char *hide_author;
+    bool hide_merges;
+    intmax_t first_parent_below;
+
+    // Commits pushed in the current walk, resolved here since libgit2
+    // doesn't tell
+    egit_oidmap tips;
+
+    // Progress of the current walk
+    bool started;
+    intmax_t returned;
+    intmax_t skipped;
+    int slop;
+    egit_oidmap depths;
+
+    // Commit graph of the repository while a walk with date limits runs
+    egit_commit_graph *graph;
+};
+
+static void revwalk_hide_where_dispose(egit_revwalk *walk)
+{
+    egit_strarray_dispose(&walk->hide_globs);
+    walk->hide_globs.strings = NULL;
+    walk->hide_globs.count = 0;
+    free(walk->hide_author);
+    walk->hide_author = NULL;
+    walk->hide_merges = false;
+    walk->first_parent_below = -1;
+}
+
+void egit_revwalk_free(egit_revwalk *walk)
+{
+    if (!walk)
+        return;
+    git_revwalk_free(walk->walk);
+    revwalk_hide_where_dispose(walk);
+    egit_oidmap_dispose(&walk->tips);
+    egit_oidmap_dispose(&walk->depths);
+    egit_commit_graph_release(walk->graph);
+    free(walk);
+}
+
+git_revwalk *egit_revwalk_walker(egit_revwalk *walk)
+{
+    return walk->walk;
+}
+
+/**
+ * Forget the current walk, after libgit2 has reset it.
+ */
+static void revwalk_restart(egit_revwalk *walk)
+{
+    egit_oidmap_dispose(&walk->tips);
+    walk->started = false;
+    walk->returned = walk->skipped = 0;
+    walk->slop = 0;
+    egit_oidmap_dispose(&walk->depths);
+    egit_commit_graph_release(walk->graph);
+    walk->graph = NULL;
+}
+
+/**
+ * Add the commit that ID peels to to MAP.
+ */
+static int revwalk_note(egit_oidmap *map, git_repository *repo, const git_oid *id)
+{
+    git_object *obj, *commit;
+    int retval = git_object_lookup(&obj, repo, id, GIT_OBJ_ANY);
+    if (retval)
+        return retval;
+    retval = git_object_peel(&commit, obj, GIT_OBJ_COMMIT);
+    git_object_free(obj);
+    if (retval)
+        return retval;
+
+    void **slot = egit_oidmap_put(map, git_object_id(commit), NULL);
+    git_object_free(commit);
+    if (!slot)
+        return GIT_ERROR;
+    *slot = (void*) 1;
+    return 0;
+}
+
+static int revwalk_note_ref(egit_oidmap *map, git_repository *repo, const char *refname)
+{
+    git_oid id;
+    int retval = git_reference_name_to_id(&id, repo, refname);
+    return retval ? retval : revwalk_note(map, repo, &id);
+}
+
+typedef struct {
+    egit_oidmap *map;
+    git_repository *repo;
+} note_glob_ctx;
+
+static int revwalk_note_glob_callback(const char *refname, void *payload)
+{
+    // Like libgit2, skip references that aren't commits
+    note_glob_ctx *ctx = (note_glob_ctx*) payload;
+    int retval = revwalk_note_ref(ctx->map, ctx->repo, refname);
+    if (retval && retval != GIT_ERROR)
+        giterr_clear();
+    return retval == GIT_ERROR ? retval : 0;
+}
+
+/**
+ * Add the commits of the references matching GLOB to MAP.  GLOB is
+ * completed the way git_revwalk_push_glob does.
+ */
+static int revwalk_note_glob(egit_oidmap *map, git_repository *repo, const char *glob)
+{
+    bool prefixed = !strncmp(glob, "refs/", 5);
+    bool wildcard = strpbrk(glob, "?*[") != NULL;
+    size_t len = strlen(glob);
+
+    char *pattern = (char*) malloc(len + 8);
+    if (!pattern) {
+        giterr_set_oom();
+        return GIT_ERROR;
+    }
+    sprintf(pattern, "%s%s%s%s", prefixed ? "" : "refs/", glob,
+            wildcard || (len > 0 && glob[len-1] == '/') ? "" : "/",
+            wildcard ? "" : "*");
+
+    note_glob_ctx ctx = {map, repo};
+    int retval = git_reference_foreach_glob(repo, pattern, &revwalk_note_glob_callback, &ctx);
+    free(pattern);
+    return retval;
+}
+
+/**
+ * Record the end of RANGE, as pushed by git_revwalk_push_range.
+ */
+static int revwalk_note_range(egit_revwalk *walk, const char *range)
+{
+    git_repository *repo = git_revwalk_repository(walk->walk);
+    git_revspec revspec;
+    int retval = git_revparse(&revspec, repo, range);
+    if (retval)
+        return retval;
+
+    retval = revwalk_note(&walk->tips, repo, git_object_id(revspec.to));
+    git_object_free(revspec.from);
+    git_object_free(revspec.to);
+    return retval;
+}
+
+static void revwalk_reset(egit_revwalk *walk)
+{
+    git_revwalk_reset(walk->walk);
+    revwalk_restart(walk);
+}
+
+static int commit_time(git_time_t *out, const egit_revwalk *walk, const git_oid *id)
+{
+    uint32_t pos;
+    if (walk->graph && egit_commit_graph_find(walk->graph, id, &pos)) {
+        *out = egit_commit_graph_time(walk->graph, pos);
+        return 0;
+    }
+
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, git_revwalk_repository(walk->walk), id);
+    if (retval)
+        return retval;
+    *out = git_commit_time(commit);
+    git_commit_free(commit);
+    return 0;
+}
+
+/**
+ * Pass the depth of COMMIT on to the parents that `first-parent-below'
+ * follows.  VALUE is the depth of COMMIT plus one, as in the depths map.
+ */
+static int revwalk_follow_first_parents(egit_revwalk *walk, const git_commit *commit, uintptr_t value)
+{
+    unsigned int nparents = git_commit_parentcount(commit);
+    if (nparents > 1 && (intmax_t) value - 1 >= walk->first_parent_below)
+        nparents = 1;
+
+    for (unsigned int i = 0; i < nparents; i++) {
+        bool existed;
+        void **slot = egit_oidmap_put(&walk->depths, git_commit_parent_id(commit, i), &existed);
+        if (!slot)
+            return GIT_ERROR;
+        if (!existed || (uintptr_t) *slot > value + 1)
+            *slot = (void*) (value + 1);
+    }
+    return 0;
+}
+
+static bool strarray_equal(const git_strarray *a, const git_strarray *b)
+{
+    if (a->count != b->count)
+        return false;
+    for (size_t i = 0; i < a->count; i++)
+        if (strcmp(a->strings[i], b->strings[i]))
+            return false;
+    return true;
+}
+
+/**
+ * Apply the hide specifications of WALK to the commits pushed so far.
+ * Globs are hidden again in every walk, since a reset forgets them.
+ */
+static int revwalk_start(egit_revwalk *walk)
+{
+    for (size_t i = 0; i < walk->hide_globs.count; i++) {
+        int retval = git_revwalk_hide_glob(walk->walk, walk->hide_globs.strings[i]);
+        if (retval)
+            return retval;
+    }
+
+    // The pushed commits have depth 0; the others get theirs from their
+    // children as they come out of the walk
+    egit_oidmap_dispose(&walk->depths);
+    for (size_t i = 0; walk->first_parent_below >= 0 && i < walk->tips.alloc; i++) {
+        if (!walk->tips.used[i])
+            continue;
+        void **slot = egit_oidmap_put(&walk->depths, &walk->tips.keys[i], NULL);
+        if (!slot)
+            return GIT_ERROR;
+        *slot = (void*) 1;
+    }
+
+    // Date limits look up the time of every commit, so find the graph once
+    if (walk->has_since || walk->has_until) {
+        git_repository *repo = git_revwalk_repository(walk->walk);
+        walk->graph = egit_commit_graph_retain(egit_commit_graph_get(repo));
+    }
+
+    walk->started = true;
+    return 0;
+}
+
+/**
+ * Check whether the hide specifications of WALK hide the commit ID, which
+ * just came out of the walk.
+ *
+ * A commit is kept by `first-parent-below' if a kept child passed it a
+ * depth.  In topological order all children come out first, so that depth
+ * is final.  In time order, clock skew can make a commit come out before
+ * one of its children, and then only the children seen so far count.
+ */
+static int revwalk_hidden(bool *hide, egit_revwalk *walk, const git_oid *id)
+{
+    bool depths = walk->first_parent_below >= 0;
+    uintptr_t depth = depths ? (uintptr_t) egit_oidmap_get(&walk->depths, id) : 0;
+    *hide = depths && !depth;
+    if (*hide || (!depths && !walk->hide_author && !walk->hide_merges))
+        return 0;
+
+    git_commit *commit;
+    int retval = git_commit_lookup(&commit, git_revwalk_repository(walk->walk), id);
+    if (retval)
+        return retval;
+
+    // Parents of hidden merges and authors are still walked
+    if (depths && (retval = revwalk_follow_first_parents(walk, commit, depth))) {
+        git_commit_free(commit);
+        return retval;
+    }
+
+    if (walk->hide_merges)
+        *hide = git_commit_parentcount(commit) > 1;
+    if (!*hide && walk->hide_author) {
+        const git_signature *author = git_commit_author(commit);
+        size_t len = strlen(walk->hide_author);
+        *hide = egit_memmem(author->name, strlen(author->name), walk->hide_author, len) ||
+            egit_memmem(author->email, strlen(author->email), walk->hide_author, len);
+    }
+
+    git_commit_free(commit);
+    return retval;
+}
+
+int egit_revwalk_next(git_oid *out, egit_revwalk *walk)
+{
+    bool dates = walk->has_since || walk->has_until;
+    bool hiding = walk->hide_globs.count || walk->hide_author || walk->hide_merges ||
+        walk->first_parent_below >= 0;
+    if (!dates && !hiding && walk->max_count < 0 && walk->skip == 0) {
+        walk->started = true;
+        int retval = git_revwalk_next(out, walk->walk);
+        if (retval == GIT_ITEROVER)
+            revwalk_restart(walk);
+        return retval;
+    }
+
+    if (!walk->started) {
+        int retval = revwalk_start(walk);
+        if (retval)
+            return retval;
+    }
+
+    // Old commits only come last in the default order, which is by commit
+    // time like in `git log', or if the walk is sorted by time alone
+    bool cutoff = walk->has_since &&
+        (walk->sorting == GIT_SORT_NONE || walk->sorting == GIT_SORT_TIME);
+
+    while (walk->max_count < 0 || walk->returned < walk->max_count) {
+        int retval = git_revwalk_next(out, walk->walk);
+        if (retval) {
+            if (retval == GIT_ITEROVER)
+                revwalk_reset(walk);
+            return retval;
+        }
+
+        bool hide;
+        if ((retval = revwalk_hidden(&hide, walk, out)))
+            return retval;
+        if (hide)
+            continue;
+
+        if (dates) {
+            git_time_t time;
+            if ((retval = commit_time(&time, walk, out)))
+                return retval;
+            if (walk->has_since && time < walk->since) {
+                if (cutoff && ++walk->slop > SINCE_SLOP)
+                    break;
+                continue;
+            }
+            walk->slop = 0;
+            if (walk->has_until && time > walk->until)
+                continue;
+        }
+
+        if (walk->skipped < walk->skip) {
+            walk->skipped++;
+            continue;
+        }
+
+        walk->returned++;
+        return 0;
+    }
+
+    // Stopped early, so end the walk like libgit2 would
+    revwalk_reset(walk);
+    return GIT_ITEROVER;
+}
+
+
 // =============================================================================
 // Constructors
 
@@ -16,10 +384,18 @@ emacs_value egit_revwalk_new(emacs_env *env, emacs_value _repo)
 {
     EGIT_ASSERT_REPOSITORY(_repo);
     git_repository *repo = EGIT_EXTRACT(_repo);
-    git_revwalk *revwalk;
-    int retval = git_revwalk_new(&revwalk, repo);
+    egit_revwalk *walk = (egit_revwalk*) calloc(1, sizeof(egit_revwalk));
+    if (!walk) {
+        giterr_set_oom();
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+    int retval = git_revwalk_new(&walk->walk, repo);
+    if (retval)
+        free(walk);
     EGIT_CHECK_ERROR(retval);
-    return egit_wrap(env, EGIT_REVWALK, revwalk, EM_EXTRACT_USER_PTR(_repo));
+    walk->max_count = -1;
+    walk->first_parent_below = -1;
+    return egit_wrap(env, EGIT_REVWALK, walk, EM_EXTRACT_USER_PTR(_repo));
 }
 
 
@@ -46,7 +422,7 @@ emacs_value egit_revwalk_hide(emacs_env *env, emacs_value _revwalk, emacs_value
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_oid);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = egit_revwalk_walker(EGIT_EXTRACT(_revwalk));
     git_oid oid;
     EGIT_EXTRACT_OID(_oid, oid);
 
@@ -61,7 +437,7 @@ emacs_value egit_revwalk_hide_glob(emacs_env *env, emacs_value _revwalk, emacs_v
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_glob);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = egit_revwalk_walker(EGIT_EXTRACT(_revwalk));
     char *glob = EM_EXTRACT_STRING(_glob);
 
     int retval = git_revwalk_hide_glob(revwalk, glob);
@@ -74,7 +450,7 @@ EGIT_DOC(revwalk_hide_head, "REVWALK", "Hide the repository HEAD in REVWALK.");
 emacs_value egit_revwalk_hide_head(emacs_env *env, emacs_value _revwalk)
 {
     EGIT_ASSERT_REVWALK(_revwalk);
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = egit_revwalk_walker(EGIT_EXTRACT(_revwalk));
     int retval = git_revwalk_hide_head(revwalk);
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
@@ -86,7 +462,7 @@ emacs_value egit_revwalk_hide_ref(emacs_env *env, emacs_value _revwalk, emacs_va
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_refname);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = egit_revwalk_walker(EGIT_EXTRACT(_revwalk));
     char *refname = EM_EXTRACT_STRING(_refname);
 
     int retval = git_revwalk_hide_ref(revwalk, refname);
@@ -101,11 +477,14 @@ emacs_value egit_revwalk_push(emacs_env *env, emacs_value _revwalk, emacs_value
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_oid);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
     git_oid oid;
     EGIT_EXTRACT_OID(_oid, oid);
 
     int retval = git_revwalk_push(revwalk, &oid);
+    if (!retval)
+        retval = revwalk_note(&walk->tips, git_revwalk_repository(revwalk), &oid);
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
 }
@@ -116,10 +495,13 @@ emacs_value egit_revwalk_push_glob(emacs_env *env, emacs_value _revwalk, emacs_v
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_glob);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
     char *glob = EM_EXTRACT_STRING(_glob);
 
     int retval = git_revwalk_push_glob(revwalk, glob);
+    if (!retval)
+        retval = revwalk_note_glob(&walk->tips, git_revwalk_repository(revwalk), glob);
     free(glob);
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
@@ -129,8 +511,11 @@ EGIT_DOC(revwalk_push_head, "REVWALK", "Push the repository HEAD to REVWALK.");
 emacs_value egit_revwalk_push_head(emacs_env *env, emacs_value _revwalk)
 {
     EGIT_ASSERT_REVWALK(_revwalk);
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
     int retval = git_revwalk_push_head(revwalk);
+    if (!retval)
+        retval = revwalk_note_ref(&walk->tips, git_revwalk_repository(revwalk), "HEAD");
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
 }
@@ -144,10 +529,13 @@ emacs_value egit_revwalk_push_range(emacs_env *env, emacs_value _revwalk, emacs_
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_range);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
     char *range = EM_EXTRACT_STRING(_range);
 
     int retval = git_revwalk_push_range(revwalk, range);
+    if (!retval)
+        retval = revwalk_note_range(walk, range);
     free(range);
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
@@ -159,10 +547,13 @@ emacs_value egit_revwalk_push_ref(emacs_env *env, emacs_value _revwalk, emacs_va
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_STRING(_refname);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
     char *refname = EM_EXTRACT_STRING(_refname);
 
     int retval = git_revwalk_push_ref(revwalk, refname);
+    if (!retval)
+        retval = revwalk_note_ref(&walk->tips, git_revwalk_repository(revwalk), refname);
     free(refname);
     EGIT_CHECK_ERROR(retval);
     return esym_nil;
@@ -176,8 +567,8 @@ EGIT_DOC(revwalk_reset, "REVWALK", "Reset REVWALK.");
 emacs_value egit_revwalk_reset(emacs_env *env, emacs_value _revwalk)
 {
     EGIT_ASSERT_REVWALK(_revwalk);
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
-    git_revwalk_reset(revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    revwalk_reset(walk);
     return esym_nil;
 }
 
@@ -186,7 +577,7 @@ EGIT_DOC(revwalk_simplify_first_parent, "REVWALK",
 emacs_value egit_revwalk_simplify_first_parent(emacs_env *env, emacs_value _revwalk)
 {
     EGIT_ASSERT_REVWALK(_revwalk);
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = egit_revwalk_walker(EGIT_EXTRACT(_revwalk));
     git_revwalk_simplify_first_parent(revwalk);
     return esym_nil;
 }
@@ -197,17 +588,494 @@ EGIT_DOC(revwalk_sorting, "REVWALK &optional MODE",
 emacs_value egit_revwalk_sorting(emacs_env *env, emacs_value _revwalk, emacs_value _mode)
 {
     EGIT_ASSERT_REVWALK(_revwalk);
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
 
     git_sort_t mode = GIT_SORT_NONE;
     if (!em_setflags_list(&mode, env, _mode, true, em_setflag_sort))
         return esym_nil;
 
-    git_revwalk_sorting(revwalk, mode);
+    // This also resets the walk
+    git_revwalk_sorting(walk->walk, mode);
+    walk->sorting = mode;
+    // libgit2 resets a walk that has started
+    if (walk->started)
+        revwalk_restart(walk);
+    return esym_nil;
+}
+
+EGIT_DOC(revwalk_limit, "REVWALK LIMITS",
+         "Limit the commits that come out of REVWALK, like the options of `git log'.\n"
+         "LIMITS is an alist with the following allowed keys, and replaces\n"
+         "any earlier limits.  If it is nil, REVWALK is no longer limited.\n"
+         "- `since': skip commits with an older committer time, in seconds\n"
+         "     since the epoch\n"
+         "- `until': skip commits with a newer committer time\n"
+         "- `skip': skip this many commits that pass `since' and `until'\n"
+         "- `max-count': end the walk after this many commits\n\n"
+         "In the default order, the walk ends once a few commits in a row are\n"
+         "older than `since', so only the recent part of the history is read,\n"
+         "as in `git log'.  This also holds when sorting by `time' alone, but\n"
+         "libgit2 then reads all of the history before the first commit.  In\n"
+         "other orders, `since' only skips commits.  The limits apply to `libgit-revwalk-foreach',\n"
+         "`libgit-revwalk-next-n', `libgit-revwalk-search' and\n"
+         "`libgit-log-graph', and the counts start over when the walk ends or\n"
+         "is reset.");
+emacs_value egit_revwalk_limit(emacs_env *env, emacs_value _revwalk, emacs_value limits)
+{
+    EGIT_ASSERT_REVWALK(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+
+    egit_revwalk parsed = {0};
+    parsed.max_count = -1;
+    {
+        emacs_value car, cdr;
+        EM_DOLIST(limit, limits, loop);
+        EM_ASSERT_CONS(limit);
+
+        car = em_car(env, limit);
+        cdr = em_cdr(env, limit);
+        EM_ASSERT_INTEGER(cdr);
+        intmax_t value = EM_EXTRACT_INTEGER(cdr);
+
+        if (EM_EQ(car, esym_since)) {
+            parsed.has_since = true;
+            parsed.since = value;
+        }
+        else if (EM_EQ(car, esym_until)) {
+            parsed.has_until = true;
+            parsed.until = value;
+        }
+        else if (EM_EQ(car, esym_skip) && value >= 0)
+            parsed.skip = value;
+        else if (EM_EQ(car, esym_max_count) && value >= 0)
+            parsed.max_count = value;
+        else {
+            em_signal_wrong_value(env, limit);
+            return esym_nil;
+        }
+
+        EM_DOLIST_END(loop);
+    }
+
+    walk->has_since = parsed.has_since;
+    walk->since = parsed.since;
+    walk->has_until = parsed.has_until;
+    walk->until = parsed.until;
+    walk->skip = parsed.skip;
+    walk->max_count = parsed.max_count;
+    return esym_nil;
+}
+
+EGIT_DOC(revwalk_hide_where, "REVWALK SPECS",
+         "Hide commits from REVWALK as described by SPECS, natively.\n"
+         "SPECS is an alist with the following allowed keys, and replaces\n"
+         "any earlier specifications.  If it is nil, nothing more is hidden.\n"
+         "- `glob': a glob or list of globs, hiding the commits reachable from\n"
+         "     the references they match, as with `libgit-revwalk-hide-glob'\n"
+         "- `merges': if non-nil, hide merge commits\n"
+         "- `author': hide commits whose author name or email contains this string\n"
+         "- `first-parent-below': a depth, counting from 0 at the pushed commits,\n"
+         "     at and below which only first parents are followed\n\n"
+         "Unlike with the HIDE-PRED of `libgit-revwalk-foreach', the parents of a\n"
+         "merge or of a commit by the author are still walked.  A commit's depth\n"
+         "is the length of the shortest path to it from a pushed commit, counted\n"
+         "as commits come out of the walk.  This is exact in topological order;\n"
+         "in time order, a commit that comes out before one of its children due\n"
+         "to clock skew only gets a depth from the children seen so far.\n\n"
+         "The specifications apply to every later walk of REVWALK, in the same\n"
+         "functions as the limits of `libgit-revwalk-limit'.  While a walk is in\n"
+         "progress, `merges' and `author' can be changed for the rest of it, but\n"
+         "changing `glob' or `first-parent-below' signals an error; reset the\n"
+         "walk first.");
+emacs_value egit_revwalk_hide_where(emacs_env *env, emacs_value _revwalk, emacs_value specs)
+{
+    EGIT_ASSERT_REVWALK(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+
+    emacs_value globs = esym_nil, author = esym_nil, merges = esym_nil, depth = esym_nil;
+    {
+        emacs_value car, cdr;
+        EM_DOLIST(spec, specs, loop);
+        EM_ASSERT_CONS(spec);
+
+        car = em_car(env, spec);
+        cdr = em_cdr(env, spec);
+
+        if (EM_EQ(car, esym_glob))
+            globs = em_listp(env, cdr) ? cdr : em_cons(env, cdr, esym_nil);
+        else if (EM_EQ(car, esym_author)) {
+            EM_ASSERT_STRING(cdr);
+            author = cdr;
+        }
+        else if (EM_EQ(car, esym_merges))
+            merges = cdr;
+        else if (EM_EQ(car, esym_first_parent_below)) {
+            EM_ASSERT_INTEGER(cdr);
+            if (EM_EXTRACT_INTEGER(cdr) < 0) {
+                em_signal_wrong_value(env, spec);
+                return esym_nil;
+            }
+            depth = cdr;
+        }
+        else {
+            em_signal_wrong_value(env, car);
+            return esym_nil;
+        }
+
+        EM_DOLIST_END(loop);
+    }
+
+    git_strarray hide_globs;
+    if (!egit_strarray_from_list(&hide_globs, env, globs))
+        return esym_nil;
+
+    // Globs are hidden and depths seeded when a walk starts, and libgit2
+    // ignores globs hidden after that
+    intmax_t first_parent_below = EM_EXTRACT_INTEGER_OR_DEFAULT(depth, -1);
+    if (walk->started && (first_parent_below != walk->first_parent_below ||
+                          !strarray_equal(&hide_globs, &walk->hide_globs))) {
+        egit_strarray_dispose(&hide_globs);
+        giterr_set_str(GITERR_INVALID,
+                       "cannot change `glob' or `first-parent-below' during a walk");
+        EGIT_CHECK_ERROR(GIT_ERROR);
+    }
+
+    revwalk_hide_where_dispose(walk);
+    walk->hide_globs = hide_globs;
+    walk->hide_author = EM_EXTRACT_STRING_OR_NULL(author);
+    walk->hide_merges = EM_EXTRACT_BOOLEAN(merges);
+    walk->first_parent_below = first_parent_below;
     return esym_nil;
 }
 
 
+// =============================================================================
+// Iteration
+
+EGIT_DOC(revwalk_next_n, "REVWALK N",
+         "Return a vector of the next commit IDs from REVWALK, at most N of them.\n"
+         "REVWALK keeps its position between calls, so a walk can be consumed\n"
+         "in pages.  A vector shorter than N means the walk is over, and the\n"
+         "walker has been reset.");
+emacs_value egit_revwalk_next_n(emacs_env *env, emacs_value _revwalk, emacs_value _n)
+{
+    EGIT_ASSERT_REVWALK(_revwalk);
+    EM_ASSERT_INTEGER(_n);
+
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    intmax_t n = EM_EXTRACT_INTEGER(_n);
+    if (n < 0) {
+        em_signal_args_out_of_range(env, n);
+        return esym_nil;
+    }
+
+    emacs_value *ids = NULL;
+    git_oid oid;
+    intmax_t count = 0;
+    size_t alloc = 0;
+    int retval = 0;
+    while (count < n && !(retval = egit_revwalk_next(&oid, walk))) {
+        if ((size_t) count == alloc) {
+            alloc = alloc ? 2 * alloc : 64;
+            emacs_value *grown = (emacs_value*) realloc(ids, alloc * sizeof(emacs_value));
+            if (!grown) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            ids = grown;
+        }
+        ids[count++] = EM_STRING(git_oid_tostr_s(&oid));
+    }
+
+    emacs_value ret = esym_nil;
+    if (retval == 0 || retval == GIT_ITEROVER) {
+        retval = 0;
+        ret = em_vector(env, ids, count);
+    }
+    free(ids);
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
+// =============================================================================
+// Search
+
+typedef struct {
+    char *message;
+    char *author;
+    char *committer;
+    char *regexp_source;
+#ifndef _WIN32
+    regex_t regexp;
+#endif
+    bool has_regexp;
+    bool ignore_case;
+    bool has_since, has_until;
+    git_time_t since, until;
+
+    // Scratch space for case folding
+    char *folded;
+    size_t folded_alloc;
+} search_filters;
+
+static void search_filters_dispose(search_filters *filters)
+{
+    free(filters->message);
+    free(filters->author);
+    free(filters->committer);
+    free(filters->regexp_source);
+#ifndef _WIN32
+    if (filters->has_regexp)
+        regfree(&filters->regexp);
+#endif
+    free(filters->folded);
+}
+
+static void fold_ascii(char *str, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        if (str[i] >= 'A' && str[i] <= 'Z')
+            str[i] += 'a' - 'A';
+}
+
+static emacs_value extract_search_string(emacs_env *env, emacs_value value, char **out)
+{
+    EM_ASSERT_STRING(value);
+    free(*out);
+    *out = EM_EXTRACT_STRING(value);
+    return esym_t;
+}
+
+static emacs_value extract_search_filters(emacs_env *env, emacs_value efilters, search_filters *filters)
+{
+    {
+        emacs_value car, cdr;
+        EM_DOLIST(filter, efilters, loop);
+        EM_ASSERT_CONS(filter);
+
+        car = em_car(env, filter);
+        cdr = em_cdr(env, filter);
+
+        if (EM_EQ(car, esym_message))
+            extract_search_string(env, cdr, &filters->message);
+        else if (EM_EQ(car, esym_message_regexp))
+            extract_search_string(env, cdr, &filters->regexp_source);
+        else if (EM_EQ(car, esym_author))
+            extract_search_string(env, cdr, &filters->author);
+        else if (EM_EQ(car, esym_committer))
+            extract_search_string(env, cdr, &filters->committer);
+        else if (EM_EQ(car, esym_since)) {
+            EM_ASSERT_INTEGER(cdr);
+            filters->has_since = true;
+            filters->since = EM_EXTRACT_INTEGER(cdr);
+        }
+        else if (EM_EQ(car, esym_until)) {
+            EM_ASSERT_INTEGER(cdr);
+            filters->has_until = true;
+            filters->until = EM_EXTRACT_INTEGER(cdr);
+        }
+        else if (EM_EQ(car, esym_ignore_case))
+            filters->ignore_case = EM_EXTRACT_BOOLEAN(cdr);
+        else {
+            em_signal_wrong_value(env, car);
+            return esym_nil;
+        }
+        EM_RETURN_NIL_IF_NLE();
+
+        EM_DOLIST_END(loop);
+    }
+
+    // Literal patterns are folded once here, and the text of each commit
+    // while matching
+    if (filters->ignore_case) {
+        if (filters->message)
+            fold_ascii(filters->message, strlen(filters->message));
+        if (filters->author)
+            fold_ascii(filters->author, strlen(filters->author));
+        if (filters->committer)
+            fold_ascii(filters->committer, strlen(filters->committer));
+    }
+
+    if (filters->regexp_source) {
+#ifdef _WIN32
+        giterr_set_str(GITERR_INVALID, "Regular expressions are not supported on this platform");
+        EGIT_CHECK_ERROR(GIT_ERROR);
+#else
+        int flags = REG_EXTENDED | REG_NOSUB | REG_NEWLINE | (filters->ignore_case ? REG_ICASE : 0);
+        int retval = regcomp(&filters->regexp, filters->regexp_source, flags);
+        if (retval) {
+            char msg[256];
+            regerror(retval, &filters->regexp, msg, sizeof(msg));
+            giterr_set_str(GITERR_INVALID, msg);
+            EGIT_CHECK_ERROR(GIT_ERROR);
+        }
+        filters->has_regexp = true;
+#endif
+    }
+
+    return esym_t;
+}
+
+/**
+ * Check whether the literal PATTERN occurs in TEXT, folding case if asked to.
+ */
+static int search_text(bool *found, search_filters *filters, const char *pattern, const char *text)
+{
+    size_t len = strlen(text);
+
+    if (filters->ignore_case) {
+        if (len > filters->folded_alloc) {
+            char *folded = (char*) realloc(filters->folded, len);
+            if (!folded) {
+                giterr_set_oom();
+                return GIT_ERROR;
+            }
+            filters->folded = folded;
+            filters->folded_alloc = len;
+        }
+        memcpy(filters->folded, text, len);
+        fold_ascii(filters->folded, len);
+        text = filters->folded;
+    }
+
+    *found = egit_memmem(text, len, pattern, strlen(pattern)) != NULL;
+    return 0;
+}
+
+static int search_signature(bool *found, search_filters *filters, const char *pattern,
+                            const git_signature *sig)
+{
+    int retval = search_text(found, filters, pattern, sig->name);
+    if (retval || *found)
+        return retval;
+    return search_text(found, filters, pattern, sig->email);
+}
+
+/**
+ * Check whether COMMIT passes all FILTERS.  The cheap ones go first.
+ */
+static int search_match(bool *match, search_filters *filters, const git_commit *commit)
+{
+    *match = false;
+
+    git_time_t time = git_commit_time(commit);
+    if ((filters->has_since && time < filters->since) ||
+        (filters->has_until && time > filters->until))
+        return 0;
+
+    bool found;
+    int retval;
+    if (filters->author) {
+        retval = search_signature(&found, filters, filters->author, git_commit_author(commit));
+        if (retval || !found)
+            return retval;
+    }
+    if (filters->committer) {
+        retval = search_signature(&found, filters, filters->committer, git_commit_committer(commit));
+        if (retval || !found)
+            return retval;
+    }
+
+    const char *message = git_commit_message(commit);
+    if (filters->message) {
+        retval = search_text(&found, filters, filters->message, message);
+        if (retval || !found)
+            return retval;
+    }
+#ifndef _WIN32
+    if (filters->has_regexp && regexec(&filters->regexp, message, 0, NULL, 0))
+        return 0;
+#endif
+
+    *match = true;
+    return 0;
+}
+
+EGIT_DOC(revwalk_search, "REVWALK FILTERS &optional N",
+         "Return a vector of the next commit IDs from REVWALK that pass FILTERS.\n"
+         "Commits are read and matched natively, so only matching commits\n"
+         "cross over to Emacs.\n\n"
+         "FILTERS is an alist, and a commit must pass all of them:\n"
+         "- message: a string that must occur in the commit message\n"
+         "- message-regexp: a POSIX extended regular expression that must\n"
+         "  match a line of the commit message (not available on Windows)\n"
+         "- author: a string that must occur in the author name or email\n"
+         "- committer: a string that must occur in the committer name or email\n"
+         "- since: the oldest committer time, in seconds since the epoch\n"
+         "- until: the newest committer time, in seconds since the epoch\n"
+         "- ignore-case: if non-nil, ignore ASCII case in the above\n\n"
+         "If N is given, stop after N matches.  As with\n"
+         "`libgit-revwalk-next-n', REVWALK keeps its position between calls,\n"
+         "and a vector shorter than N means the walk is over.");
+emacs_value egit_revwalk_search(emacs_env *env, emacs_value _revwalk, emacs_value _filters,
+                                emacs_value _n)
+{
+    EGIT_ASSERT_REVWALK(_revwalk);
+    EM_ASSERT_INTEGER_OR_NIL(_n);
+
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_repository *repo = git_revwalk_repository(walk->walk);
+    intmax_t n = EM_EXTRACT_BOOLEAN(_n) ? EM_EXTRACT_INTEGER(_n) : -1;
+    if (EM_EXTRACT_BOOLEAN(_n) && n < 0) {
+        em_signal_args_out_of_range(env, n);
+        return esym_nil;
+    }
+
+    search_filters filters;
+    memset(&filters, 0, sizeof(search_filters));
+    extract_search_filters(env, _filters, &filters);
+    if (env->non_local_exit_check(env)) {
+        search_filters_dispose(&filters);
+        return esym_nil;
+    }
+
+    emacs_value *ids = NULL;
+    size_t count = 0, alloc = 0;
+    git_oid oid;
+    int retval = 0;
+    while ((n < 0 || (intmax_t) count < n) && !(retval = egit_revwalk_next(&oid, walk))) {
+        git_commit *commit;
+        bool match;
+        retval = git_commit_lookup(&commit, repo, &oid);
+        if (retval)
+            break;
+        retval = search_match(&match, &filters, commit);
+        git_commit_free(commit);
+        if (retval)
+            break;
+        if (!match)
+            continue;
+
+        if (count == alloc) {
+            size_t new_alloc = alloc ? 2 * alloc : 64;
+            emacs_value *new_ids = (emacs_value*) realloc(ids, new_alloc * sizeof(emacs_value));
+            if (!new_ids) {
+                giterr_set_oom();
+                retval = GIT_ERROR;
+                break;
+            }
+            ids = new_ids;
+            alloc = new_alloc;
+        }
+        ids[count++] = EM_STRING(git_oid_tostr_s(&oid));
+    }
+
+    emacs_value ret = esym_nil;
+    if (retval == 0 || retval == GIT_ITEROVER) {
+        retval = 0;
+        ret = em_vector(env, ids, count);
+    }
+    free(ids);
+    search_filters_dispose(&filters);
+    EGIT_CHECK_ERROR(retval);
+
+    return ret;
+}
+
+
 // =============================================================================
 // Foreach
 
@@ -246,7 +1114,8 @@ emacs_value egit_revwalk_foreach(
     EGIT_ASSERT_REVWALK(_revwalk);
     EM_ASSERT_FUNCTION(func);
 
-    git_revwalk *revwalk = EGIT_EXTRACT(_revwalk);
+    egit_revwalk *walk = EGIT_EXTRACT(_revwalk);
+    git_revwalk *revwalk = walk->walk;
 
     hide_context *ctx = NULL;
     if (EM_EXTRACT_BOOLEAN(hide_pred)) {
@@ -259,7 +1128,8 @@ emacs_value egit_revwalk_foreach(
     // Since both the hide callback and the main function may trigger errors,
     // we must check for non-local exits on both ends of the loop body
     git_oid oid;
-    while (GIT_ITEROVER != git_revwalk_next(&oid, revwalk)) {
+    int retval;
+    while (!(retval = egit_revwalk_next(&oid, walk))) {
         if (env->non_local_exit_check(env))
             goto cleanup;
 
@@ -274,6 +1144,12 @@ emacs_value egit_revwalk_foreach(
   cleanup:
     free(ctx);
     git_revwalk_add_hide_cb(revwalk, NULL, NULL);
-    git_revwalk_reset(revwalk);
+    revwalk_reset(walk);
+
+    // Errors of the hide callback are already signaled
+    EM_RETURN_NIL_IF_NLE();
+    if (retval == GIT_ITEROVER)
+        retval = 0;
+    EGIT_CHECK_ERROR(retval);
     return esym_nil;
 }
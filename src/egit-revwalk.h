@@ -3,6 +3,21 @@
 #ifndef EGIT_REVWALK_H
 #define EGIT_REVWALK_H
 
+/**
+ * A revision walker together with the limits of `libgit-revwalk-limit'
+ * and the hide specifications of `libgit-revwalk-hide-where'.
+ * This is what Emacs revwalk objects hold.
+ */
+typedef struct egit_revwalk egit_revwalk;
+void egit_revwalk_free(egit_revwalk *walk);
+git_revwalk *egit_revwalk_walker(egit_revwalk *walk);
+
+/**
+ * Like git_revwalk_next, but skipping the commits that are outside the
+ * limits of WALK, and ending early when the limits allow it.
+ */
+int egit_revwalk_next(git_oid *out, egit_revwalk *walk);
+
 EGIT_DEFUN(revwalk_new, emacs_value _repo);
 EGIT_DEFUN(revwalk_repository, emacs_value _revwalk);
 
@@ -20,6 +35,11 @@ EGIT_DEFUN(revwalk_push_ref, emacs_value _revwalk, emacs_value _refname);
 EGIT_DEFUN(revwalk_reset, emacs_value _revwalk);
 EGIT_DEFUN(revwalk_simplify_first_parent, emacs_value _revwalk);
 EGIT_DEFUN(revwalk_sorting, emacs_value _revwalk, emacs_value _mode);
+EGIT_DEFUN(revwalk_limit, emacs_value _revwalk, emacs_value limits);
+EGIT_DEFUN(revwalk_hide_where, emacs_value _revwalk, emacs_value specs);
+
+EGIT_DEFUN(revwalk_next_n, emacs_value _revwalk, emacs_value _n);
+EGIT_DEFUN(revwalk_search, emacs_value _revwalk, emacs_value _filters, emacs_value _n);
 
 EGIT_DEFUN(revwalk_foreach, emacs_value _revwalk, emacs_value _func, emacs_value _hide_pred);
 
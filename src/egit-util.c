@@ -1,8 +1,702 @@
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef EGIT_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EGIT_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include "git2.h"
+
+#include "egit-util.h"
 #include "interface.h"
 
+bool egit_intbuf_push(egit_intbuf *buf, intmax_t value)
+{
+    if (buf->size == buf->alloc) {
+        size_t alloc = buf->alloc ? 2 * buf->alloc : 64;
+        intmax_t *ptr = (intmax_t*) realloc(buf->ptr, alloc * sizeof(intmax_t));
+        if (!ptr) {
+            giterr_set_oom();
+            return false;
+        }
+        buf->ptr = ptr;
+        buf->alloc = alloc;
+    }
+    buf->ptr[buf->size++] = value;
+    return true;
+}
+
+void egit_intbuf_dispose(egit_intbuf *buf)
+{
+    free(buf->ptr);
+    buf->ptr = NULL;
+    buf->size = buf->alloc = 0;
+}
+
+static size_t oidmap_slot(const egit_oidmap *map, const git_oid *oid)
+{
+    // Object IDs are already uniformly distributed
+    size_t hash;
+    memcpy(&hash, oid->id, sizeof(size_t));
+    size_t mask = map->alloc - 1;
+    size_t slot = hash & mask;
+    while (map->used[slot] && !git_oid_equal(&map->keys[slot], oid))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static bool oidmap_grow(egit_oidmap *map)
+{
+    egit_oidmap grown;
+    grown.alloc = map->alloc ? 2 * map->alloc : 64;
+    grown.count = map->count;
+    grown.keys = (git_oid*) malloc(grown.alloc * sizeof(git_oid));
+    grown.values = (void**) malloc(grown.alloc * sizeof(void*));
+    grown.used = (bool*) calloc(grown.alloc, sizeof(bool));
+    if (!grown.keys || !grown.values || !grown.used) {
+        egit_oidmap_dispose(&grown);
+        return false;
+    }
+
+    for (size_t i = 0; i < map->alloc; i++) {
+        if (!map->used[i])
+            continue;
+        size_t slot = oidmap_slot(&grown, &map->keys[i]);
+        grown.used[slot] = true;
+        git_oid_cpy(&grown.keys[slot], &map->keys[i]);
+        grown.values[slot] = map->values[i];
+    }
+
+    egit_oidmap_dispose(map);
+    *map = grown;
+    return true;
+}
+
+void **egit_oidmap_put(egit_oidmap *map, const git_oid *oid, bool *existed)
+{
+    if (4 * (map->count + 1) > 3 * map->alloc && !oidmap_grow(map)) {
+        giterr_set_oom();
+        return NULL;
+    }
+
+    size_t slot = oidmap_slot(map, oid);
+    if (existed)
+        *existed = map->used[slot];
+    if (!map->used[slot]) {
+        map->used[slot] = true;
+        git_oid_cpy(&map->keys[slot], oid);
+        map->values[slot] = NULL;
+        map->count++;
+    }
+    return &map->values[slot];
+}
+
+void *egit_oidmap_get(const egit_oidmap *map, const git_oid *oid)
+{
+    if (map->count == 0)
+        return NULL;
+    size_t slot = oidmap_slot(map, oid);
+    return map->used[slot] ? map->values[slot] : NULL;
+}
+
+void egit_oidmap_dispose(egit_oidmap *map)
+{
+    free(map->keys);
+    free(map->values);
+    free(map->used);
+    map->keys = NULL;
+    map->values = NULL;
+    map->used = NULL;
+    map->alloc = map->count = 0;
+}
+
+size_t egit_parallel_default_threads(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t) n : 1;
+#else
+    return 1;
+#endif
+}
+
+typedef struct {
+    size_t nitems;
+    size_t next;
+    bool stop;
+    egit_parallel_init_fn init;
+    egit_parallel_cleanup_fn cleanup;
+    egit_parallel_fn fn;
+    void *payload;
+#ifdef EGIT_THREADS
+    pthread_mutex_t lock;
+#endif
+} parallel_ctx;
+
+static void *parallel_worker(void *_ctx)
+{
+    parallel_ctx *ctx = (parallel_ctx*) _ctx;
+    void *state = ctx->init ? ctx->init(ctx->payload) : NULL;
+
+    while (true) {
+#ifdef EGIT_THREADS
+        pthread_mutex_lock(&ctx->lock);
+#endif
+        size_t index = ctx->next;
+        bool done = ctx->stop || index >= ctx->nitems;
+        if (!done)
+            ctx->next++;
+#ifdef EGIT_THREADS
+        pthread_mutex_unlock(&ctx->lock);
+#endif
+        if (done)
+            break;
+
+        if (ctx->fn(index, state, ctx->payload)) {
+#ifdef EGIT_THREADS
+            pthread_mutex_lock(&ctx->lock);
+#endif
+            ctx->stop = true;
+#ifdef EGIT_THREADS
+            pthread_mutex_unlock(&ctx->lock);
+#endif
+        }
+    }
+
+    if (ctx->cleanup)
+        ctx->cleanup(state, ctx->payload);
+    return NULL;
+}
+
+void egit_parallel_for(size_t nitems, size_t nthreads, egit_parallel_init_fn init,
+                       egit_parallel_cleanup_fn cleanup, egit_parallel_fn fn, void *payload)
+{
+    parallel_ctx ctx;
+    memset(&ctx, 0, sizeof(parallel_ctx));
+    ctx.nitems = nitems;
+    ctx.init = init;
+    ctx.cleanup = cleanup;
+    ctx.fn = fn;
+    ctx.payload = payload;
+    if (nthreads > nitems)
+        nthreads = nitems;
+
+#ifdef EGIT_THREADS
+    if (nthreads > 1 && (git_libgit2_features() & GIT_FEATURE_THREADS)) {
+        pthread_t *threads = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+        pthread_mutex_init(&ctx.lock, NULL);
+
+        // The calling thread is one of the workers
+        size_t started = 0;
+        for (size_t i = 1; threads && i < nthreads; i++) {
+            if (pthread_create(&threads[started], NULL, &parallel_worker, &ctx))
+                break;
+            started++;
+        }
+        parallel_worker(&ctx);
+        for (size_t i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+
+        pthread_mutex_destroy(&ctx.lock);
+        free(threads);
+        return;
+    }
+    pthread_mutex_init(&ctx.lock, NULL);
+    parallel_worker(&ctx);
+    pthread_mutex_destroy(&ctx.lock);
+#else
+    (void) nthreads;
+    parallel_worker(&ctx);
+#endif
+}
+
+uint64_t egit_clock_ms(void)
+{
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static void scan_text_scalar(const unsigned char *p, size_t len, bool *nul, size_t *newlines)
+{
+    if (!newlines) {
+        *nul = *nul || memchr(p, '\0', len);
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '\n')
+            (*newlines)++;
+        else if (nul && p[i] == '\0')
+            *nul = true;
+    }
+}
+
+#ifdef EGIT_X86_SIMD
+
+// 2 for AVX2, 1 for SSE2, 0 for neither
+static int simd_level(void)
+{
+    static int level = -1;
+    if (level < 0) {
+        __builtin_cpu_init();
+        level = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse2") ? 1 : 0;
+    }
+    return level;
+}
+
+__attribute__((target("sse2")))
+static void scan_text_sse2(const unsigned char *p, size_t len, bool *nul, size_t *newlines)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (p + i));
+        if (nul && !*nul && _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero))) {
+            *nul = true;
+            if (!newlines)
+                return;
+        }
+        if (newlines)
+            *newlines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+    }
+
+    scan_text_scalar(p + i, len - i, nul, newlines);
+}
+
+__attribute__((target("avx2")))
+static void scan_text_avx2(const unsigned char *p, size_t len, bool *nul, size_t *newlines)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (p + i));
+        if (nul && !*nul && _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero))) {
+            *nul = true;
+            if (!newlines)
+                return;
+        }
+        if (newlines)
+            *newlines += __builtin_popcount(
+                (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+    }
+
+    scan_text_scalar(p + i, len - i, nul, newlines);
+}
+
+#endif
+
+void egit_scan_text(const char *buf, size_t len, bool *nul, size_t *newlines)
+{
+    const unsigned char *p = (const unsigned char*) buf;
+    if (nul)
+        *nul = false;
+    if (newlines)
+        *newlines = 0;
+    if (!nul && !newlines)
+        return;
+
+#ifdef EGIT_X86_SIMD
+    int level = simd_level();
+    if (level == 2) {
+        scan_text_avx2(p, len, nul, newlines);
+        return;
+    }
+    if (level == 1) {
+        scan_text_sse2(p, len, nul, newlines);
+        return;
+    }
+#endif
+
+    scan_text_scalar(p, len, nul, newlines);
+}
+
+size_t egit_count_lines(const char *buf, size_t len)
+{
+    size_t newlines;
+    egit_scan_text(buf, len, NULL, &newlines);
+    if (len > 0 && buf[len-1] != '\n')
+        newlines++;
+    return newlines;
+}
+
+bool egit_line_offsets(egit_intbuf *out, const char *buf, size_t len)
+{
+    // memchr is vectorized by the C library on all platforms we care about
+    size_t pos = 0;
+    while (pos < len) {
+        if (!egit_intbuf_push(out, pos))
+            return false;
+        const char *eol = memchr(buf + pos, '\n', len - pos);
+        if (!eol)
+            break;
+        pos = eol - buf + 1;
+    }
+    return true;
+}
+
+static const char *memmem_scalar(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const char *end = hay + hlen - nlen + 1;
+    const char *p = hay;
+    while (p < end && (p = memchr(p, needle[0], end - p))) {
+        if (!memcmp(p + 1, needle + 1, nlen - 1))
+            return p;
+        p++;
+    }
+    return NULL;
+}
+
+#ifdef EGIT_X86_SIMD
+
+// Compare the first and last byte of the needle at 16 or 32 positions at
+// once, and only check the rest at positions where both match
+
+__attribute__((target("sse2")))
+static const char *memmem_sse2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+
+    for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (hay + i + nlen - 1));
+        unsigned int mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (!memcmp(hay + pos + 1, needle + 1, nlen - 2))
+                return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return memmem_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+__attribute__((target("avx2")))
+static const char *memmem_avx2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+    size_t i = 0;
+
+    for (; i + nlen - 1 + 32 <= hlen; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (hay + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (hay + i + nlen - 1));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (!memcmp(hay + pos + 1, needle + 1, nlen - 2))
+                return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return memmem_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+#endif
+
+const char *egit_memmem(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    if (nlen == 0)
+        return hay;
+    if (nlen > hlen)
+        return NULL;
+    if (nlen == 1)
+        return memchr(hay, needle[0], hlen);
+
+#ifdef EGIT_X86_SIMD
+    int level = simd_level();
+    if (level == 2)
+        return memmem_avx2(hay, hlen, needle, nlen);
+    if (level == 1)
+        return memmem_sse2(hay, hlen, needle, nlen);
+#endif
+
+    return memmem_scalar(hay, hlen, needle, nlen);
+}
+
+bool egit_rangebuf_push(egit_rangebuf *buf, size_t final_start, size_t start, size_t lines)
+{
+    if (lines == 0)
+        return true;
+
+    if (buf->size > 0) {
+        egit_line_range *last = &buf->ptr[buf->size - 1];
+        if (last->start + last->lines == start && last->final_start + last->lines == final_start) {
+            last->lines += lines;
+            return true;
+        }
+    }
+
+    if (buf->size == buf->alloc) {
+        size_t alloc = buf->alloc ? 2 * buf->alloc : 16;
+        egit_line_range *ptr = (egit_line_range*) realloc(buf->ptr, alloc * sizeof(egit_line_range));
+        if (!ptr) {
+            giterr_set_oom();
+            return false;
+        }
+        buf->ptr = ptr;
+        buf->alloc = alloc;
+    }
+
+    egit_line_range *range = &buf->ptr[buf->size++];
+    range->final_start = final_start;
+    range->start = start;
+    range->lines = lines;
+    return true;
+}
+
+static int compare_line_ranges(const void *a, const void *b)
+{
+    const egit_line_range *ra = (const egit_line_range*) a;
+    const egit_line_range *rb = (const egit_line_range*) b;
+    if (ra->start != rb->start)
+        return ra->start < rb->start ? -1 : 1;
+    if (ra->final_start != rb->final_start)
+        return ra->final_start < rb->final_start ? -1 : 1;
+    return 0;
+}
+
+void egit_rangebuf_sort(egit_rangebuf *buf)
+{
+    if (buf->size < 2)
+        return;
+
+    qsort(buf->ptr, buf->size, sizeof(egit_line_range), compare_line_ranges);
+
+    size_t out = 0;
+    for (size_t i = 1; i < buf->size; i++) {
+        egit_line_range *last = &buf->ptr[out];
+        egit_line_range *next = &buf->ptr[i];
+        if (last->start + last->lines == next->start &&
+            last->final_start + last->lines == next->final_start)
+            last->lines += next->lines;
+        else
+            buf->ptr[++out] = *next;
+    }
+    buf->size = out + 1;
+}
+
+void egit_rangebuf_dispose(egit_rangebuf *buf)
+{
+    free(buf->ptr);
+    buf->ptr = NULL;
+    buf->size = buf->alloc = 0;
+}
+
+static int blob_hunks_callback(const git_diff_delta *delta, const git_diff_hunk *hunk, void *payload)
+{
+    (void) delta;
+    egit_intbuf *out = (egit_intbuf*) payload;
+    if (!egit_intbuf_push(out, hunk->old_start) || !egit_intbuf_push(out, hunk->old_lines) ||
+        !egit_intbuf_push(out, hunk->new_start) || !egit_intbuf_push(out, hunk->new_lines))
+        return GIT_ERROR;
+    return 0;
+}
+
+int egit_diff_blob_hunks(egit_intbuf *out, const git_blob *old_blob, const git_blob *new_blob)
+{
+    git_diff_options opts;
+    int retval = git_diff_init_options(&opts, GIT_DIFF_OPTIONS_VERSION);
+    if (retval < 0)
+        return retval;
+    opts.context_lines = 0;
+    opts.interhunk_lines = 0;
+    opts.flags |= GIT_DIFF_FORCE_TEXT;
+
+    return git_diff_blobs(old_blob, NULL, new_blob, NULL, &opts,
+                          NULL, NULL, blob_hunks_callback, NULL, out);
+}
+
+/**
+ * Whether the hunk at H lies entirely before LINE on the new side.  A hunk
+ * that only removes lines has NEW-START set to the line preceding the removal.
+ */
+static bool hunk_before(const intmax_t *h, size_t line)
+{
+    size_t new_start = h[2], new_lines = h[3];
+    return new_lines == 0 ? new_start < line : new_start + new_lines <= line;
+}
+
+bool egit_line_ranges_map(const egit_rangebuf *ranges, const egit_intbuf *hunks,
+                          egit_rangebuf *carried, egit_rangebuf *changed)
+{
+    size_t nhunks = hunks->size / 4;
+
+    // Hunk index and old-minus-new line offset at the start of the current
+    // range.  These only move forward, since the ranges are sorted.
+    size_t first = 0;
+    intmax_t first_delta = 0;
+
+    for (size_t i = 0; i < ranges->size; i++) {
+        const egit_line_range *range = &ranges->ptr[i];
+        size_t pos = range->start, final = range->final_start, remaining = range->lines;
+
+        while (first < nhunks && hunk_before(&hunks->ptr[4*first], pos)) {
+            first_delta += hunks->ptr[4*first + 1] - hunks->ptr[4*first + 3];
+            first++;
+        }
+
+        size_t h = first;
+        intmax_t delta = first_delta;
+
+        while (remaining > 0) {
+            while (h < nhunks && hunk_before(&hunks->ptr[4*h], pos)) {
+                delta += hunks->ptr[4*h + 1] - hunks->ptr[4*h + 3];
+                h++;
+            }
+
+            const intmax_t *hunk = h < nhunks ? &hunks->ptr[4*h] : NULL;
+            size_t count = remaining;
+
+            if (hunk && hunk[3] > 0 && (size_t) hunk[2] <= pos) {
+                // Inside a hunk: these lines were introduced on the new side
+                size_t end = hunk[2] + hunk[3];
+                if (end - pos < count)
+                    count = end - pos;
+                if (changed && !egit_rangebuf_push(changed, final, pos, count))
+                    return false;
+            }
+            else {
+                // Untouched up to the next hunk, or up to and including
+                // the line after which a pure removal happens
+                if (hunk) {
+                    size_t limit = hunk[3] > 0 ? hunk[2] - pos : hunk[2] - pos + 1;
+                    if (limit < count)
+                        count = limit;
+                }
+                if (carried && !egit_rangebuf_push(carried, final, pos + delta, count))
+                    return false;
+            }
+
+            pos += count;
+            final += count;
+            remaining -= count;
+        }
+    }
+
+    return true;
+}
+
+#define SHA1_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t *h, const unsigned char *block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i+1] << 16 |
+            (uint32_t) block[4*i+2] << 8 | block[4*i+3];
+    for (int i = 16; i < 80; i++)
+        w[i] = SHA1_ROL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        }
+        else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        }
+        else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        }
+        else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = SHA1_ROL(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = SHA1_ROL(b, 30);
+        b = a;
+        a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+void egit_sha1_init(egit_sha1_ctx *ctx)
+{
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xefcdab89;
+    ctx->h[2] = 0x98badcfe;
+    ctx->h[3] = 0x10325476;
+    ctx->h[4] = 0xc3d2e1f0;
+    ctx->len = 0;
+}
+
+void egit_sha1_update(egit_sha1_ctx *ctx, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t used = ctx->len % 64;
+    ctx->len += len;
+
+    if (used) {
+        size_t n = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->buf + used, p, n);
+        p += n;
+        len -= n;
+        if (used + n < 64)
+            return;
+        sha1_block(ctx->h, ctx->buf);
+    }
+    for (; len >= 64; p += 64, len -= 64)
+        sha1_block(ctx->h, p);
+    memcpy(ctx->buf, p, len);
+}
+
+void egit_sha1_final(unsigned char *out, egit_sha1_ctx *ctx)
+{
+    uint64_t bits = ctx->len * 8;
+    unsigned char pad[72] = {0x80};
+    size_t npad = (ctx->len % 64 < 56 ? 56 : 120) - ctx->len % 64;
+    for (int i = 0; i < 8; i++)
+        pad[npad + i] = bits >> (56 - 8*i);
+    egit_sha1_update(ctx, pad, npad + 8);
+
+    for (int i = 0; i < 5; i++) {
+        out[4*i] = ctx->h[i] >> 24;
+        out[4*i+1] = ctx->h[i] >> 16;
+        out[4*i+2] = ctx->h[i] >> 8;
+        out[4*i+3] = ctx->h[i];
+    }
+}
+
 bool egit_strarray_from_list(git_strarray *array, emacs_env *env, emacs_value list)
 {
     array->count = 0;
@@ -9,6 +9,168 @@ typedef struct {
     egit_object *parent;
 } egit_generic_payload;
 
+/**
+ * Growable array of integers, used to build flat integer vectors for Emacs.
+ */
+typedef struct {
+    intmax_t *ptr;
+    size_t size;
+    size_t alloc;
+} egit_intbuf;
+
+bool egit_intbuf_push(egit_intbuf *buf, intmax_t value);
+void egit_intbuf_dispose(egit_intbuf *buf);
+
+/**
+ * Hash map from git_oid to pointers, using open addressing.
+ */
+typedef struct {
+    git_oid *keys;
+    void **values;
+    bool *used;
+    size_t alloc;
+    size_t count;
+} egit_oidmap;
+
+/**
+ * Find or create the value slot for OID in MAP.
+ * New slots are initialized to NULL.
+ * @param existed If non-NULL, set to whether OID was already present.
+ * @return The value slot, or NULL on allocation failure.
+ */
+void **egit_oidmap_put(egit_oidmap *map, const git_oid *oid, bool *existed);
+
+/**
+ * Return the value stored for OID in MAP, or NULL.
+ */
+void *egit_oidmap_get(const egit_oidmap *map, const git_oid *oid);
+
+/**
+ * Free the storage of MAP, but not the values.
+ */
+void egit_oidmap_dispose(egit_oidmap *map);
+
+/**
+ * Function run on each item by egit_parallel_for.
+ * @param index Index of the item.
+ * @param state Per-thread state returned by the init function.
+ * @param payload Payload passed to egit_parallel_for.
+ * @return Non-zero to stop handing out further items.
+ */
+typedef int (*egit_parallel_fn)(size_t index, void *state, void *payload);
+typedef void *(*egit_parallel_init_fn)(void *payload);
+typedef void (*egit_parallel_cleanup_fn)(void *state, void *payload);
+
+/**
+ * Return the default number of worker threads (the number of online CPUs).
+ */
+size_t egit_parallel_default_threads(void);
+
+/**
+ * Run FN on items 0 to NITEMS-1 using up to NTHREADS threads.
+ * Each thread calls INIT (if non-NULL) before processing items, and
+ * CLEANUP (if non-NULL) afterwards.  If threads are unavailable, in this
+ * build or in libgit2, the items are processed on the calling thread.
+ * Since FN may run on other threads, it must not call into Emacs.
+ */
+void egit_parallel_for(size_t nitems, size_t nthreads, egit_parallel_init_fn init,
+                       egit_parallel_cleanup_fn cleanup, egit_parallel_fn fn, void *payload);
+
+/**
+ * Return a monotonic clock reading in milliseconds.
+ */
+uint64_t egit_clock_ms(void);
+
+/**
+ * Scan a buffer for NUL bytes and count its newlines in a single pass.
+ * Uses AVX2 or SSE2 where the CPU supports them.  Either output may be
+ * NULL to skip that part of the work; a scan for NUL bytes alone stops
+ * at the first one.
+ * @param nul Set to whether BUF contains a NUL byte.
+ * @param newlines Set to the number of newline characters in BUF.
+ */
+void egit_scan_text(const char *buf, size_t len, bool *nul, size_t *newlines);
+
+/**
+ * Count the lines in a buffer.  A final line without a newline counts.
+ */
+size_t egit_count_lines(const char *buf, size_t len);
+
+/**
+ * Append the byte offset of the start of every line in BUF to OUT.
+ */
+bool egit_line_offsets(egit_intbuf *out, const char *buf, size_t len);
+
+/**
+ * Find the first occurrence of NEEDLE in HAY, like memmem(3), which isn't
+ * available everywhere.  Uses AVX2 or SSE2 where the CPU supports them.
+ * @return A pointer into HAY, or NULL if there is no occurrence.
+ */
+const char *egit_memmem(const char *hay, size_t hlen, const char *needle, size_t nlen);
+
+/**
+ * A run of lines in some version of a file, tied to the run of lines
+ * it became in a final version.  Line numbers are 1-based.
+ */
+typedef struct {
+    size_t final_start;
+    size_t start;
+    size_t lines;
+} egit_line_range;
+
+/**
+ * Growable array of line ranges.
+ */
+typedef struct {
+    egit_line_range *ptr;
+    size_t size;
+    size_t alloc;
+} egit_rangebuf;
+
+/**
+ * Append a range to BUF, merging it with the last one if both are contiguous.
+ */
+bool egit_rangebuf_push(egit_rangebuf *buf, size_t final_start, size_t start, size_t lines);
+
+/**
+ * Sort the ranges in BUF by start line and merge contiguous ranges.
+ */
+void egit_rangebuf_sort(egit_rangebuf *buf);
+void egit_rangebuf_dispose(egit_rangebuf *buf);
+
+/**
+ * Diff two blobs without context and append each hunk to OUT as the four
+ * integers OLD-START OLD-LINES NEW-START NEW-LINES.  Either blob may be NULL.
+ */
+int egit_diff_blob_hunks(egit_intbuf *out, const git_blob *old_blob, const git_blob *new_blob);
+
+/**
+ * Push RANGES, given in the new side of HUNKS, through the diff.
+ * Lines the diff leaves alone are appended to CARRIED with their old line
+ * numbers, and lines it adds or changes are appended to CHANGED.  RANGES
+ * must be sorted.  Either output may be NULL to drop those lines.
+ */
+bool egit_line_ranges_map(const egit_rangebuf *ranges, const egit_intbuf *hunks,
+                          egit_rangebuf *carried, egit_rangebuf *changed);
+
+/**
+ * Incremental SHA-1, for the checksums git puts at the end of its
+ * auxiliary files.  libgit2 does not expose its own hash functions.
+ */
+typedef struct {
+    uint32_t h[5];
+    uint64_t len;
+    unsigned char buf[64];
+} egit_sha1_ctx;
+
+void egit_sha1_init(egit_sha1_ctx *ctx);
+void egit_sha1_update(egit_sha1_ctx *ctx, const void *data, size_t len);
+
+/**
+ * Finish the hash and store the 20-byte digest in OUT.
+ */
+void egit_sha1_final(unsigned char *out, egit_sha1_ctx *ctx);
+
 bool egit_strarray_from_list(git_strarray *array, emacs_env *env, emacs_value list);
 void egit_strarray_dispose(git_strarray *array);
 
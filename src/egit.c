@@ -17,6 +17,7 @@
 #include "egit-cherrypick.h"
 #include "egit-clone.h"
 #include "egit-commit.h"
+#include "egit-commit-graph.h"
 #include "egit-config.h"
 #include "egit-cred.h"
 #include "egit-describe.h"
@@ -25,6 +26,7 @@
 #include "egit-ignore.h"
 #include "egit-index.h"
 #include "egit-libgit2.h"
+#include "egit-log.h"
 #include "egit-merge.h"
 #include "egit-message.h"
 #include "egit-object.h"
@@ -127,7 +129,12 @@ void egit_finalize(void* _obj)
     case EGIT_COMMIT: case EGIT_TREE: case EGIT_BLOB: case EGIT_TAG: case EGIT_OBJECT:
         git_object_free(obj->ptr); break;
     case EGIT_BLAME: git_blame_free(obj->ptr); break;
-    case EGIT_DIFF: git_diff_free(obj->ptr); break;
+    case EGIT_BLAME_SESSION: egit_blame_session_free(obj->ptr); break;
+    case EGIT_DIFF:
+        // Diffs from the diff cache share the git_diff of their parent until modified
+        if (!parent || parent->type != EGIT_DIFF || parent->ptr != obj->ptr)
+            git_diff_free(obj->ptr);
+        break;
     case EGIT_INDEX: git_index_free(obj->ptr); break;
     case EGIT_REFLOG: git_reflog_free(obj->ptr); break;
     case EGIT_REMOTE: git_remote_free(obj->ptr); break;
@@ -139,7 +146,8 @@ void egit_finalize(void* _obj)
     case EGIT_SUBMODULE: git_submodule_free(obj->ptr); break;
     case EGIT_CRED: git_cred_free(obj->ptr); break;
     case EGIT_ANNOTATED_COMMIT: git_annotated_commit_free(obj->ptr); break;
-    case EGIT_REVWALK: git_revwalk_free(obj->ptr); break;
+    case EGIT_LOG_CURSOR: egit_log_cursor_free(obj->ptr); break;
+    case EGIT_REVWALK: egit_revwalk_free(obj->ptr); break;
     case EGIT_TREEBUILDER: git_treebuilder_free(obj->ptr); break;
     case EGIT_PATHSPEC: git_pathspec_free(obj->ptr); break;
     case EGIT_PATHSPEC_MATCH_LIST: git_pathspec_match_list_free(obj->ptr); break;
@@ -283,10 +291,12 @@ static emacs_value egit_typeof(emacs_env *env, emacs_value val)
     case EGIT_OBJECT: return esym_object;
     case EGIT_BLAME: return esym_blame;
     case EGIT_BLAME_HUNK: return esym_blame_hunk;
+    case EGIT_BLAME_SESSION: return esym_blame_session;
     case EGIT_CONFIG: return esym_config;
     case EGIT_TRANSACTION: return esym_transaction;
     case EGIT_INDEX: return esym_index;
     case EGIT_INDEX_ENTRY: return esym_index_entry;
+    case EGIT_LOG_CURSOR: return esym_log_cursor;
     case EGIT_DIFF: return esym_diff;
     case EGIT_DIFF_DELTA: return esym_diff_delta;
     case EGIT_DIFF_BINARY: return esym_diff_binary;
@@ -317,6 +327,7 @@ static emacs_value egit_typeof(emacs_env *env, emacs_value val)
 TYPECHECKER(ANNOTATED_COMMIT, annotated_commit, "annotated commit");
 TYPECHECKER(BLAME, blame, "blame");
 TYPECHECKER(BLAME_HUNK, blame_hunk, "blame hunk");
+TYPECHECKER(BLAME_SESSION, blame_session, "blame session");
 TYPECHECKER(COMMIT, commit, "commit");
 TYPECHECKER(BLOB, blob, "blob");
 TYPECHECKER(CONFIG, config, "config");
@@ -328,6 +339,7 @@ TYPECHECKER(DIFF_HUNK, diff_hunk, "diff hunk");
 TYPECHECKER(DIFF_LINE, diff_line, "diff line");
 TYPECHECKER(INDEX, index, "index.");
 TYPECHECKER(INDEX_ENTRY, index_entry, "index entry");
+TYPECHECKER(LOG_CURSOR, log_cursor, "log cursor");
 TYPECHECKER(PATHSPEC, pathspec, "pathspec");
 TYPECHECKER(PATHSPEC_MATCH_LIST, pathspec_match_list, "pathspec match list");
 TYPECHECKER(REFERENCE, reference, "reference");
@@ -380,6 +392,7 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-annotated-commit-p", annotated_commit_p, 1, 1);
     DEFUN("libgit-blame-p", blame_p, 1, 1);
     DEFUN("libgit-blame-hunk-p", blame_hunk_p, 1, 1);
+    DEFUN("libgit-blame-session-p", blame_session_p, 1, 1);
     DEFUN("libgit-blob-p", blob_p, 1, 1);
     DEFUN("libgit-commit-p", commit_p, 1, 1);
     DEFUN("libgit-config-p", config_p, 1, 1);
@@ -391,6 +404,7 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-diff-line-p", diff_line_p, 1, 1);
     DEFUN("libgit-index-p", index_p, 1, 1);
     DEFUN("libgit-index-entry-p", index_entry_p, 1, 1);
+    DEFUN("libgit-log-cursor-p", log_cursor_p, 1, 1);
     DEFUN("libgit-object-p", object_p, 1, 1);
     DEFUN("libgit-pathspec-p", pathspec_p, 1, 1);
     DEFUN("libgit-pathspec-match-list-p", pathspec_match_list_p, 1, 1);
@@ -420,10 +434,19 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-annotated-commit-id", annotated_commit_id, 1, 1);
 
     // Blame
+    DEFUN("libgit-blame-buffer", blame_buffer, 2, 2);
     DEFUN("libgit-blame-file", blame_file, 2, 3);
+    DEFUN("libgit-blame-files", blame_files, 2, 4);
     DEFUN("libgit-blame-get-hunk-byindex", blame_get_hunk_byindex, 2, 2);
     DEFUN("libgit-blame-get-hunk-byline", blame_get_hunk_byline, 2, 2);
     DEFUN("libgit-blame-get-hunk-count", blame_get_hunk_count, 1, 1);
+    DEFUN("libgit-blame-incremental", blame_incremental, 3, 4);
+    DEFUN("libgit-blame-to-vectors", blame_to_vectors, 1, 1);
+
+    DEFUN("libgit-blame-session-new", blame_session_new, 2, 3);
+    DEFUN("libgit-blame-session-move", blame_session_move, 2, 2);
+    DEFUN("libgit-blame-session-revision", blame_session_revision, 1, 1);
+    DEFUN("libgit-blame-session-to-vectors", blame_session_to_vectors, 1, 1);
 
     DEFUN("libgit-blame-hunk-commit-id", blame_hunk_commit_id, 1, 2);
     DEFUN("libgit-blame-hunk-lines", blame_hunk_lines, 1, 1);
@@ -438,9 +461,11 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-blob-lookup", blob_lookup, 2, 2);
     DEFUN("libgit-blob-lookup-prefix", blob_lookup_prefix, 2, 2);
 
-    DEFUN("libgit-blob-binary-p", blob_binary_p, 1, 1);
+    DEFUN("libgit-blob-binary-p", blob_binary_p, 1, 2);
     DEFUN("libgit-blob-filtered-content", blob_filtered_content, 2, 3);
     DEFUN("libgit-blob-id", blob_id, 1, 1);
+    DEFUN("libgit-blob-line-count", blob_line_count, 1, 1);
+    DEFUN("libgit-blob-line-offsets", blob_line_offsets, 1, 1);
     DEFUN("libgit-blob-owner", blob_owner, 1, 1);
     DEFUN("libgit-blob-rawcontent", blob_rawcontent, 1, 1);
     DEFUN("libgit-blob-rawsize", blob_rawsize, 1, 1);
@@ -494,6 +519,10 @@ void egit_init(emacs_env *env)
 
     DEFUN("libgit-commit-create", commit_create, 6, 7);
 
+    // Commit graph
+    DEFUN("libgit-commit-graph-generation", commit_graph_generation, 2, 2);
+    DEFUN("libgit-commit-graph-write", commit_graph_write, 1, 2);
+
     // Config
     DEFUN("libgit-config-new", config_new, 0, 0);
     DEFUN("libgit-config-open-default", config_open_default, 0, 0);
@@ -535,6 +564,8 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-describe-workdir", describe_workdir, 1, 2);
 
     // Diff
+    DEFUN("libgit-diff-buffer-to-blob", diff_buffer_to_blob, 2, 3);
+    DEFUN("libgit-diff-buffer-to-index", diff_buffer_to_index, 3, 3);
     DEFUN("libgit-diff-index-to-index", diff_index_to_index, 3, 4);
     DEFUN("libgit-diff-index-to-workdir", diff_index_to_workdir, 1, 3);
     DEFUN("libgit-diff-tree-to-index", diff_tree_to_index, 1, 4);
@@ -542,9 +573,15 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-diff-tree-to-workdir", diff_tree_to_workdir, 1, 3);
     DEFUN("libgit-diff-tree-to-workdir-with-index", diff_tree_to_workdir_with_index, 1, 3);
     DEFUN("libgit-diff-find-similar", diff_find_similar, 1, 2);
+    DEFUN("libgit-diff-refine", diff_refine, 1, 2);
 
     DEFUN("libgit-diff-foreach", diff_foreach, 2, 5);
     DEFUN("libgit-diff-print", diff_print, 1, 3);
+    DEFUN("libgit-diff-to-string", diff_to_string, 1, 2);
+
+    DEFUN("libgit-diff-cache-flush", diff_cache_flush, 0, 0);
+    DEFUN("libgit-diff-cache-set-budget", diff_cache_set_budget, 1, 1);
+    DEFUN("libgit-diff-cache-stats", diff_cache_stats, 0, 0);
 
     DEFUN("libgit-diff-delta-file-id", diff_delta_file_id, 1, 2);
     DEFUN("libgit-diff-delta-file-path", diff_delta_file_path, 1, 2);
@@ -556,6 +593,7 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-diff-hunk-header", diff_hunk_header, 1, 1);
     DEFUN("libgit-diff-hunk-lines", diff_hunk_lines, 1, 2);
     DEFUN("libgit-diff-hunk-start", diff_hunk_start, 1, 2);
+    DEFUN("libgit-diff-hunk-refine", diff_hunk_refine, 2, 3);
 
     DEFUN("libgit-diff-line-origin", diff_line_origin, 1, 1);
     DEFUN("libgit-diff-line-lineno", diff_line_lineno, 2, 2);
@@ -566,7 +604,9 @@ void egit_init(emacs_env *env)
 
     // Graph
     DEFUN("libgit-graph-ahead-behind", graph_ahead_behind, 3, 3);
+    DEFUN("libgit-branches-ahead-behind", branches_ahead_behind, 1, 3);
     DEFUN("libgit-graph-descendant-p", graph_descendant_p, 3, 3);
+    DEFUN("libgit-refs-containing", refs_containing, 2, 3);
 
     // Ignore
     DEFUN("libgit-ignore-add-rule", add_rule, 2, 2);
@@ -596,6 +636,16 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-index-write", index_write, 1, 1);
     DEFUN("libgit-index-write-tree", index_write_tree, 1, 2);
 
+    // Log
+    DEFUN("libgit-log", log, 3, 5);
+    DEFUN("libgit-log-cursor-new", log_cursor_new, 3, 4);
+    DEFUN("libgit-log-cursor-next", log_cursor_next, 2, 2);
+    DEFUN("libgit-log-cursor-valid-p", log_cursor_valid_p, 1, 1);
+    DEFUN("libgit-log-graph", log_graph, 3, 4);
+    DEFUN("libgit-log-path", log_path, 2, 3);
+    DEFUN("libgit-log-line-range", log_line_range, 4, 5);
+    DEFUN("libgit-log-pickaxe", log_pickaxe, 2, 5);
+
     // Merge
     DEFUN("libgit-merge", merge, 2, 4);
     DEFUN("libgit-merge-analysis", merge_analysis, 2, 2);
@@ -759,6 +809,7 @@ void egit_init(emacs_env *env)
 
     DEFUN("libgit-revwalk-hide", revwalk_hide, 2, 2);
     DEFUN("libgit-revwalk-hide-glob", revwalk_hide_glob, 2, 2);
+    DEFUN("libgit-revwalk-hide-where", revwalk_hide_where, 2, 2);
     DEFUN("libgit-revwalk-hide-head", revwalk_hide_head, 1, 1);
     DEFUN("libgit-revwalk-hide-ref", revwalk_hide_ref, 2, 2);
 
@@ -771,7 +822,10 @@ void egit_init(emacs_env *env)
     DEFUN("libgit-revwalk-reset", revwalk_reset, 1, 1);
     DEFUN("libgit-revwalk-simplifiy-first-parent", revwalk_simplify_first_parent, 1, 1);
     DEFUN("libgit-revwalk-sorting", revwalk_sorting, 1, 2);
+    DEFUN("libgit-revwalk-limit", revwalk_limit, 2, 2);
 
+    DEFUN("libgit-revwalk-next-n", revwalk_next_n, 2, 2);
+    DEFUN("libgit-revwalk-search", revwalk_search, 2, 3);
     DEFUN("libgit-revwalk-foreach", revwalk_foreach, 2, 3);
 
     // Signature
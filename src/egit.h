@@ -36,6 +36,10 @@
 #define EGIT_ASSERT_BLAME(val)                                          \
     do { if (!egit_assert_type(env, (val), EGIT_BLAME, esym_libgit_blame_p)) return esym_nil; } while (0)
 
+// Assert that VAL is a git blame session, signal an error and return otherwise.
+#define EGIT_ASSERT_BLAME_SESSION(val)                                  \
+    do { if (!egit_assert_type(env, (val), EGIT_BLAME_SESSION, esym_libgit_blame_session_p)) return esym_nil; } while (0)
+
 // Assert that VAL is a git blob, signal an error and return otherwise.
 #define EGIT_ASSERT_BLOB(val)                                           \
     do { if (!egit_assert_type(env, (val), EGIT_BLOB, esym_libgit_blob_p)) return esym_nil; } while (0)
@@ -84,6 +88,10 @@
 #define EGIT_ASSERT_INDEX_ENTRY(val)                                    \
     do { if (!egit_assert_type(env, (val), EGIT_INDEX_ENTRY, esym_libgit_index_entry_p)) return esym_nil; } while (0)
 
+// Assert that VAL is a git log cursor, signal an error and return otherwise.
+#define EGIT_ASSERT_LOG_CURSOR(val)                                     \
+    do { if (!egit_assert_type(env, (val), EGIT_LOG_CURSOR, esym_libgit_log_cursor_p)) return esym_nil; } while (0)
+
 // Assert that VAL is a git object, signal an error and return otherwise.
 #define EGIT_ASSERT_OBJECT(val)                                         \
     do { if (!egit_assert_object(env, (val))) return esym_nil; } while (0)
@@ -257,10 +265,12 @@ typedef enum {
     EGIT_SIGNATURE,
     EGIT_BLAME,
     EGIT_BLAME_HUNK,
+    EGIT_BLAME_SESSION,
     EGIT_CONFIG,
     EGIT_TRANSACTION,
     EGIT_INDEX,
     EGIT_INDEX_ENTRY,
+    EGIT_LOG_CURSOR,
     EGIT_DIFF,
     EGIT_DIFF_DELTA,
     EGIT_DIFF_BINARY,
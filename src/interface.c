@@ -137,6 +137,34 @@ char *em_get_string(emacs_env *env, emacs_value arg)
     return em_get_string_with_size(env, arg, &size);
 }
 
+char *em_get_text_with_size(emacs_env *env, emacs_value arg, ptrdiff_t *size, bool encode)
+{
+    if (EM_EXTRACT_BOOLEAN(em_funcall(env, esym_bufferp, 1, arg))) {
+        // Evaluate (save-current-buffer (set-buffer ARG) TEXT) so that the
+        // current buffer is restored even after a non-local exit, where TEXT
+        // is (buffer-substring-no-properties (point-min) (point-max)),
+        // encoded with buffer-file-coding-system if ENCODE
+        emacs_value bounds[3] = {
+            esym_buffer_substring_no_properties,
+            em_list(env, &esym_point_min, 1),
+            em_list(env, &esym_point_max, 1),
+        };
+        emacs_value text = em_list(env, bounds, 3);
+        if (encode) {
+            emacs_value args[4] = {esym_encode_coding_string, text, esym_buffer_file_coding_system, esym_t};
+            text = em_list(env, args, 4);
+        }
+        emacs_value set[2] = {esym_set_buffer, arg};
+        emacs_value form[3] = {esym_save_current_buffer, em_list(env, set, 2), text};
+        arg = em_funcall(env, esym_eval, 1, em_list(env, form, 3));
+    }
+    else if (!em_assert(env, esym_stringp, arg))
+        return NULL;
+    EM_RETURN_IF_NLE(NULL);
+
+    return em_get_string_with_size(env, arg, size);
+}
+
 emacs_value em_cons(emacs_env *env, emacs_value car, emacs_value cdr)
 {
     return em_funcall(env, esym_cons, 2, car, cdr);
@@ -162,6 +190,21 @@ emacs_value em_list(emacs_env *env, emacs_value *objects, ptrdiff_t nobjects)
     return env->funcall(env, esym_list, nobjects, objects);
 }
 
+emacs_value em_vector(emacs_env *env, emacs_value *objects, ptrdiff_t nobjects)
+{
+    return env->funcall(env, esym_vector, nobjects, objects);
+}
+
+emacs_value em_integer_vector(emacs_env *env, const intmax_t *values, size_t nvalues)
+{
+    emacs_value *objects = (emacs_value*) malloc((nvalues + 1) * sizeof(emacs_value));
+    for (size_t i = 0; i < nvalues; i++)
+        objects[i] = EM_INTEGER(values[i]);
+    emacs_value ret = em_vector(env, objects, nvalues);
+    free(objects);
+    return ret;
+}
+
 bool em_listp(emacs_env *env, emacs_value object)
 {
     return EM_EXTRACT_BOOLEAN(em_funcall(env, esym_listp, 1, object));
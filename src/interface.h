@@ -186,6 +186,20 @@ char *em_get_string_with_size(emacs_env *env, emacs_value arg, ptrdiff_t *size);
  */
 char *em_get_string(emacs_env *env, emacs_value arg);
 
+/**
+ * Return the text of a string, or of the accessible portion of a buffer.
+ * Signal a wrong-type-argument error if the value is neither.
+ * Caller is responsible for freeing the returned pointer.
+ * @param env The active Emacs environment.
+ * @param arg Emacs value representing a string or a buffer.
+ * @param size Where the size will be stored.
+ * @param encode If true, the text of a buffer is encoded with its
+ *               buffer-file-coding-system, as it would be saved.  Strings
+ *               and other text are returned as UTF-8.
+ * @return The text (owned pointer), or NULL if an error was signaled.
+ */
+char *em_get_text_with_size(emacs_env *env, emacs_value arg, ptrdiff_t *size, bool encode);
+
 /**
  * Call (cons car cdr) in Emacs.
  * @param env The active Emacs environment.
@@ -227,6 +241,22 @@ emacs_value em_cdr(emacs_env *env, emacs_value cell);
  */
 emacs_value em_list(emacs_env *env, emacs_value *objects, ptrdiff_t nobjects);
 
+/**
+ * Call (vector OBJECTS...) in Emacs.
+ * @param env The active Emacs environment.
+ * @param objects Array of objects.
+ * @param nobjects Number of \p objects.
+ */
+emacs_value em_vector(emacs_env *env, emacs_value *objects, ptrdiff_t nobjects);
+
+/**
+ * Create an Emacs vector of integers.
+ * @param env The active Emacs environment.
+ * @param values Array of integers.
+ * @param nvalues Number of \p values.
+ */
+emacs_value em_integer_vector(emacs_env *env, const intmax_t *values, size_t nvalues);
+
 /**
  * Call (listp OBJECT) in Emacs.
  * @param env The active Emacs environment.
@@ -18,26 +18,41 @@ emacs_value esym_apply_mailbox;
 emacs_value esym_apply_mailbox_or_rebase;
 emacs_value esym_args_out_of_range;
 emacs_value esym_assq;
+emacs_value esym_author;
+emacs_value esym_author_email;
+emacs_value esym_author_name;
+emacs_value esym_author_time;
 emacs_value esym_auto;
 emacs_value esym_base;
 emacs_value esym_baseline;
 emacs_value esym_bisect;
 emacs_value esym_blame;
 emacs_value esym_blame_hunk;
+emacs_value esym_blame_session;
 emacs_value esym_blob;
 emacs_value esym_blob_executable;
 emacs_value esym_break_rewrites;
 emacs_value esym_break_rewrites_for_renames_only;
 emacs_value esym_break_rewrite_threshold;
+emacs_value esym_budget;
+emacs_value esym_budget_exceeded;
+emacs_value esym_buffer_file_coding_system;
+emacs_value esym_buffer_substring_no_properties;
+emacs_value esym_bufferp;
 emacs_value esym_callbacks;
 emacs_value esym_car;
 emacs_value esym_cdr;
 emacs_value esym_certificate_check;
+emacs_value esym_char;
 emacs_value esym_check_pathspec;
 emacs_value esym_checkout;
 emacs_value esym_cherrypick;
 emacs_value esym_cherrypick_sequence;
 emacs_value esym_commit;
+emacs_value esym_committer;
+emacs_value esym_committer_email;
+emacs_value esym_committer_name;
+emacs_value esym_committer_time;
 emacs_value esym_config;
 emacs_value esym_conflict;
 emacs_value esym_conflicted;
@@ -67,7 +82,10 @@ emacs_value esym_dirty_suffix;
 emacs_value esym_disable_pathspec_match;
 emacs_value esym_download_tags;
 emacs_value esym_enable_fast_untracked_dirs;
+emacs_value esym_encode_coding_string;
 emacs_value esym_encode_time;
+emacs_value esym_entries;
+emacs_value esym_eval;
 emacs_value esym_exclude_submodules;
 emacs_value esym_expand_file_name;
 emacs_value esym_fail_on_conflict;
@@ -91,11 +109,14 @@ emacs_value esym_find_renames;
 emacs_value esym_find_renames_from_rewrites;
 emacs_value esym_find_rewrites;
 emacs_value esym_first_parent;
+emacs_value esym_first_parent_below;
 emacs_value esym_flags;
+emacs_value esym_follow;
 emacs_value esym_force;
 emacs_value esym_force_binary;
 emacs_value esym_force_text;
 emacs_value esym_from_owner;
+emacs_value esym_full_history;
 emacs_value esym_functionp;
 emacs_value esym_giterr;
 emacs_value esym_giterr_callback;
@@ -131,11 +152,14 @@ emacs_value esym_giterr_thread;
 emacs_value esym_giterr_tree;
 emacs_value esym_giterr_worktree;
 emacs_value esym_giterr_zlib;
+emacs_value esym_glob;
 emacs_value esym_global;
 emacs_value esym_hard;
 emacs_value esym_headers;
+emacs_value esym_hits;
 emacs_value esym_hostkey_libssh2;
 emacs_value esym_https;
+emacs_value esym_id;
 emacs_value esym_id_abbrev;
 emacs_value esym_ignore_case;
 emacs_value esym_ignore_filemode;
@@ -175,6 +199,7 @@ emacs_value esym_length;
 emacs_value esym_libgit_annotated_commit_p;
 emacs_value esym_libgit_blame_hunk_p;
 emacs_value esym_libgit_blame_p;
+emacs_value esym_libgit_blame_session_p;
 emacs_value esym_libgit_blob_p;
 emacs_value esym_libgit_commit_p;
 emacs_value esym_libgit_config_p;
@@ -186,6 +211,7 @@ emacs_value esym_libgit_diff_line_p;
 emacs_value esym_libgit_diff_p;
 emacs_value esym_libgit_index_entry_p;
 emacs_value esym_libgit_index_p;
+emacs_value esym_libgit_log_cursor_p;
 emacs_value esym_libgit_object_p;
 emacs_value esym_libgit_pathspec_match_list_p;
 emacs_value esym_libgit_pathspec_p;
@@ -202,18 +228,25 @@ emacs_value esym_libgit_tag_p;
 emacs_value esym_libgit_transaction_p;
 emacs_value esym_libgit_tree_p;
 emacs_value esym_libgit_treebuilder_p;
+emacs_value esym_limit;
 emacs_value esym_link;
 emacs_value esym_list;
 emacs_value esym_listp;
 emacs_value esym_local;
+emacs_value esym_log_cursor;
 emacs_value esym_max_candidates_tags;
+emacs_value esym_max_count;
 emacs_value esym_max_line;
 emacs_value esym_max_size;
 emacs_value esym_md5;
 emacs_value esym_merge;
+emacs_value esym_merges;
+emacs_value esym_message;
+emacs_value esym_message_regexp;
 emacs_value esym_metric;
 emacs_value esym_min_line;
 emacs_value esym_minimal;
+emacs_value esym_misses;
 emacs_value esym_mixed;
 emacs_value esym_modified;
 emacs_value esym_name_only;
@@ -243,12 +276,16 @@ emacs_value esym_on;
 emacs_value esym_ondemand;
 emacs_value esym_only_follow_first_parent;
 emacs_value esym_ours;
+emacs_value esym_parallel;
+emacs_value esym_parents;
 emacs_value esym_patch;
 emacs_value esym_patch_header;
 emacs_value esym_pathspec;
 emacs_value esym_pathspec_match_list;
 emacs_value esym_patience;
 emacs_value esym_pattern;
+emacs_value esym_point_max;
+emacs_value esym_point_min;
 emacs_value esym_post;
 emacs_value esym_pre;
 emacs_value esym_programdata;
@@ -267,6 +304,7 @@ emacs_value esym_recursion_limit;
 emacs_value esym_reference;
 emacs_value esym_reflog;
 emacs_value esym_reflog_entry;
+emacs_value esym_refs;
 emacs_value esym_refspec;
 emacs_value esym_remote;
 emacs_value esym_rename_threshold;
@@ -281,8 +319,11 @@ emacs_value esym_repository;
 emacs_value esym_reverse;
 emacs_value esym_revert;
 emacs_value esym_revert_sequence;
+emacs_value esym_revisions;
 emacs_value esym_revwalk;
 emacs_value esym_safe;
+emacs_value esym_save_current_buffer;
+emacs_value esym_set_buffer;
 emacs_value esym_sha1;
 emacs_value esym_show_binary;
 emacs_value esym_show_commit_oid_as_fallback;
@@ -291,6 +332,8 @@ emacs_value esym_show_untracked_content;
 emacs_value esym_sideband_progress;
 emacs_value esym_signature;
 emacs_value esym_simplify_alnum;
+emacs_value esym_since;
+emacs_value esym_size;
 emacs_value esym_skip;
 emacs_value esym_skip_binary_check;
 emacs_value esym_skip_reuc;
@@ -310,8 +353,10 @@ emacs_value esym_stringp;
 emacs_value esym_style_diff3;
 emacs_value esym_style_merge;
 emacs_value esym_submodule;
+emacs_value esym_summary;
 emacs_value esym_symbol_value;
 emacs_value esym_symbolic;
+emacs_value esym_symbolp;
 emacs_value esym_system;
 emacs_value esym_t;
 emacs_value esym_tag;
@@ -336,6 +381,7 @@ emacs_value esym_union;
 emacs_value esym_unmodified;
 emacs_value esym_unreadable;
 emacs_value esym_unspecified;
+emacs_value esym_until;
 emacs_value esym_untracked;
 emacs_value esym_up_to_date;
 emacs_value esym_update_fetchhead;
@@ -355,6 +401,7 @@ emacs_value esym_wd_modified;
 emacs_value esym_wd_uninitialized;
 emacs_value esym_wd_untracked;
 emacs_value esym_wd_wd_modified;
+emacs_value esym_word;
 emacs_value esym_workdir_only;
 emacs_value esym_wrong_type_argument;
 emacs_value esym_wrong_value_argument;
@@ -791,26 +838,41 @@ void esyms_init(emacs_env *env)
     esym_apply_mailbox_or_rebase = env->make_global_ref(env, env->intern(env, "apply-mailbox-or-rebase"));
     esym_args_out_of_range = env->make_global_ref(env, env->intern(env, "args-out-of-range"));
     esym_assq = env->make_global_ref(env, env->intern(env, "assq"));
+    esym_author = env->make_global_ref(env, env->intern(env, "author"));
+    esym_author_email = env->make_global_ref(env, env->intern(env, "author-email"));
+    esym_author_name = env->make_global_ref(env, env->intern(env, "author-name"));
+    esym_author_time = env->make_global_ref(env, env->intern(env, "author-time"));
     esym_auto = env->make_global_ref(env, env->intern(env, "auto"));
     esym_base = env->make_global_ref(env, env->intern(env, "base"));
     esym_baseline = env->make_global_ref(env, env->intern(env, "baseline"));
     esym_bisect = env->make_global_ref(env, env->intern(env, "bisect"));
     esym_blame = env->make_global_ref(env, env->intern(env, "blame"));
     esym_blame_hunk = env->make_global_ref(env, env->intern(env, "blame-hunk"));
+    esym_blame_session = env->make_global_ref(env, env->intern(env, "blame-session"));
     esym_blob = env->make_global_ref(env, env->intern(env, "blob"));
     esym_blob_executable = env->make_global_ref(env, env->intern(env, "blob-executable"));
     esym_break_rewrites = env->make_global_ref(env, env->intern(env, "break-rewrites"));
     esym_break_rewrites_for_renames_only = env->make_global_ref(env, env->intern(env, "break-rewrites-for-renames-only"));
     esym_break_rewrite_threshold = env->make_global_ref(env, env->intern(env, "break_rewrite_threshold"));
+    esym_budget = env->make_global_ref(env, env->intern(env, "budget"));
+    esym_budget_exceeded = env->make_global_ref(env, env->intern(env, "budget-exceeded"));
+    esym_buffer_file_coding_system = env->make_global_ref(env, env->intern(env, "buffer-file-coding-system"));
+    esym_buffer_substring_no_properties = env->make_global_ref(env, env->intern(env, "buffer-substring-no-properties"));
+    esym_bufferp = env->make_global_ref(env, env->intern(env, "bufferp"));
     esym_callbacks = env->make_global_ref(env, env->intern(env, "callbacks"));
     esym_car = env->make_global_ref(env, env->intern(env, "car"));
     esym_cdr = env->make_global_ref(env, env->intern(env, "cdr"));
     esym_certificate_check = env->make_global_ref(env, env->intern(env, "certificate-check"));
+    esym_char = env->make_global_ref(env, env->intern(env, "char"));
     esym_check_pathspec = env->make_global_ref(env, env->intern(env, "check-pathspec"));
     esym_checkout = env->make_global_ref(env, env->intern(env, "checkout"));
     esym_cherrypick = env->make_global_ref(env, env->intern(env, "cherrypick"));
     esym_cherrypick_sequence = env->make_global_ref(env, env->intern(env, "cherrypick-sequence"));
     esym_commit = env->make_global_ref(env, env->intern(env, "commit"));
+    esym_committer = env->make_global_ref(env, env->intern(env, "committer"));
+    esym_committer_email = env->make_global_ref(env, env->intern(env, "committer-email"));
+    esym_committer_name = env->make_global_ref(env, env->intern(env, "committer-name"));
+    esym_committer_time = env->make_global_ref(env, env->intern(env, "committer-time"));
     esym_config = env->make_global_ref(env, env->intern(env, "config"));
     esym_conflict = env->make_global_ref(env, env->intern(env, "conflict"));
     esym_conflicted = env->make_global_ref(env, env->intern(env, "conflicted"));
@@ -840,7 +902,10 @@ void esyms_init(emacs_env *env)
     esym_disable_pathspec_match = env->make_global_ref(env, env->intern(env, "disable-pathspec-match"));
     esym_download_tags = env->make_global_ref(env, env->intern(env, "download-tags"));
     esym_enable_fast_untracked_dirs = env->make_global_ref(env, env->intern(env, "enable-fast-untracked-dirs"));
+    esym_encode_coding_string = env->make_global_ref(env, env->intern(env, "encode-coding-string"));
     esym_encode_time = env->make_global_ref(env, env->intern(env, "encode-time"));
+    esym_entries = env->make_global_ref(env, env->intern(env, "entries"));
+    esym_eval = env->make_global_ref(env, env->intern(env, "eval"));
     esym_exclude_submodules = env->make_global_ref(env, env->intern(env, "exclude-submodules"));
     esym_expand_file_name = env->make_global_ref(env, env->intern(env, "expand-file-name"));
     esym_fail_on_conflict = env->make_global_ref(env, env->intern(env, "fail-on-conflict"));
@@ -864,11 +929,14 @@ void esyms_init(emacs_env *env)
     esym_find_renames_from_rewrites = env->make_global_ref(env, env->intern(env, "find-renames-from-rewrites"));
     esym_find_rewrites = env->make_global_ref(env, env->intern(env, "find-rewrites"));
     esym_first_parent = env->make_global_ref(env, env->intern(env, "first-parent"));
+    esym_first_parent_below = env->make_global_ref(env, env->intern(env, "first-parent-below"));
     esym_flags = env->make_global_ref(env, env->intern(env, "flags"));
+    esym_follow = env->make_global_ref(env, env->intern(env, "follow"));
     esym_force = env->make_global_ref(env, env->intern(env, "force"));
     esym_force_binary = env->make_global_ref(env, env->intern(env, "force-binary"));
     esym_force_text = env->make_global_ref(env, env->intern(env, "force-text"));
     esym_from_owner = env->make_global_ref(env, env->intern(env, "from-owner"));
+    esym_full_history = env->make_global_ref(env, env->intern(env, "full-history"));
     esym_functionp = env->make_global_ref(env, env->intern(env, "functionp"));
     esym_giterr = env->make_global_ref(env, env->intern(env, "giterr"));
     esym_giterr_callback = env->make_global_ref(env, env->intern(env, "giterr-callback"));
@@ -904,11 +972,14 @@ void esyms_init(emacs_env *env)
     esym_giterr_tree = env->make_global_ref(env, env->intern(env, "giterr-tree"));
     esym_giterr_worktree = env->make_global_ref(env, env->intern(env, "giterr-worktree"));
     esym_giterr_zlib = env->make_global_ref(env, env->intern(env, "giterr-zlib"));
+    esym_glob = env->make_global_ref(env, env->intern(env, "glob"));
     esym_global = env->make_global_ref(env, env->intern(env, "global"));
     esym_hard = env->make_global_ref(env, env->intern(env, "hard"));
     esym_headers = env->make_global_ref(env, env->intern(env, "headers"));
+    esym_hits = env->make_global_ref(env, env->intern(env, "hits"));
     esym_hostkey_libssh2 = env->make_global_ref(env, env->intern(env, "hostkey-libssh2"));
     esym_https = env->make_global_ref(env, env->intern(env, "https"));
+    esym_id = env->make_global_ref(env, env->intern(env, "id"));
     esym_id_abbrev = env->make_global_ref(env, env->intern(env, "id-abbrev"));
     esym_ignore_case = env->make_global_ref(env, env->intern(env, "ignore-case"));
     esym_ignore_filemode = env->make_global_ref(env, env->intern(env, "ignore-filemode"));
@@ -948,6 +1019,7 @@ void esyms_init(emacs_env *env)
     esym_libgit_annotated_commit_p = env->make_global_ref(env, env->intern(env, "libgit-annotated-commit-p"));
     esym_libgit_blame_hunk_p = env->make_global_ref(env, env->intern(env, "libgit-blame-hunk-p"));
     esym_libgit_blame_p = env->make_global_ref(env, env->intern(env, "libgit-blame-p"));
+    esym_libgit_blame_session_p = env->make_global_ref(env, env->intern(env, "libgit-blame-session-p"));
     esym_libgit_blob_p = env->make_global_ref(env, env->intern(env, "libgit-blob-p"));
     esym_libgit_commit_p = env->make_global_ref(env, env->intern(env, "libgit-commit-p"));
     esym_libgit_config_p = env->make_global_ref(env, env->intern(env, "libgit-config-p"));
@@ -959,6 +1031,7 @@ void esyms_init(emacs_env *env)
     esym_libgit_diff_p = env->make_global_ref(env, env->intern(env, "libgit-diff-p"));
     esym_libgit_index_entry_p = env->make_global_ref(env, env->intern(env, "libgit-index-entry-p"));
     esym_libgit_index_p = env->make_global_ref(env, env->intern(env, "libgit-index-p"));
+    esym_libgit_log_cursor_p = env->make_global_ref(env, env->intern(env, "libgit-log-cursor-p"));
     esym_libgit_object_p = env->make_global_ref(env, env->intern(env, "libgit-object-p"));
     esym_libgit_pathspec_match_list_p = env->make_global_ref(env, env->intern(env, "libgit-pathspec-match-list-p"));
     esym_libgit_pathspec_p = env->make_global_ref(env, env->intern(env, "libgit-pathspec-p"));
@@ -975,18 +1048,25 @@ void esyms_init(emacs_env *env)
     esym_libgit_transaction_p = env->make_global_ref(env, env->intern(env, "libgit-transaction-p"));
     esym_libgit_tree_p = env->make_global_ref(env, env->intern(env, "libgit-tree-p"));
     esym_libgit_treebuilder_p = env->make_global_ref(env, env->intern(env, "libgit-treebuilder-p"));
+    esym_limit = env->make_global_ref(env, env->intern(env, "limit"));
     esym_link = env->make_global_ref(env, env->intern(env, "link"));
     esym_list = env->make_global_ref(env, env->intern(env, "list"));
     esym_listp = env->make_global_ref(env, env->intern(env, "listp"));
     esym_local = env->make_global_ref(env, env->intern(env, "local"));
+    esym_log_cursor = env->make_global_ref(env, env->intern(env, "log-cursor"));
     esym_max_candidates_tags = env->make_global_ref(env, env->intern(env, "max-candidates-tags"));
+    esym_max_count = env->make_global_ref(env, env->intern(env, "max-count"));
     esym_max_line = env->make_global_ref(env, env->intern(env, "max-line"));
     esym_max_size = env->make_global_ref(env, env->intern(env, "max-size"));
     esym_md5 = env->make_global_ref(env, env->intern(env, "md5"));
     esym_merge = env->make_global_ref(env, env->intern(env, "merge"));
+    esym_merges = env->make_global_ref(env, env->intern(env, "merges"));
+    esym_message = env->make_global_ref(env, env->intern(env, "message"));
+    esym_message_regexp = env->make_global_ref(env, env->intern(env, "message-regexp"));
     esym_metric = env->make_global_ref(env, env->intern(env, "metric"));
     esym_min_line = env->make_global_ref(env, env->intern(env, "min-line"));
     esym_minimal = env->make_global_ref(env, env->intern(env, "minimal"));
+    esym_misses = env->make_global_ref(env, env->intern(env, "misses"));
     esym_mixed = env->make_global_ref(env, env->intern(env, "mixed"));
     esym_modified = env->make_global_ref(env, env->intern(env, "modified"));
     esym_name_only = env->make_global_ref(env, env->intern(env, "name-only"));
@@ -1016,12 +1096,16 @@ void esyms_init(emacs_env *env)
     esym_ondemand = env->make_global_ref(env, env->intern(env, "ondemand"));
     esym_only_follow_first_parent = env->make_global_ref(env, env->intern(env, "only-follow-first-parent"));
     esym_ours = env->make_global_ref(env, env->intern(env, "ours"));
+    esym_parallel = env->make_global_ref(env, env->intern(env, "parallel"));
+    esym_parents = env->make_global_ref(env, env->intern(env, "parents"));
     esym_patch = env->make_global_ref(env, env->intern(env, "patch"));
     esym_patch_header = env->make_global_ref(env, env->intern(env, "patch-header"));
     esym_pathspec = env->make_global_ref(env, env->intern(env, "pathspec"));
     esym_pathspec_match_list = env->make_global_ref(env, env->intern(env, "pathspec-match-list"));
     esym_patience = env->make_global_ref(env, env->intern(env, "patience"));
     esym_pattern = env->make_global_ref(env, env->intern(env, "pattern"));
+    esym_point_max = env->make_global_ref(env, env->intern(env, "point-max"));
+    esym_point_min = env->make_global_ref(env, env->intern(env, "point-min"));
     esym_post = env->make_global_ref(env, env->intern(env, "post"));
     esym_pre = env->make_global_ref(env, env->intern(env, "pre"));
     esym_programdata = env->make_global_ref(env, env->intern(env, "programdata"));
@@ -1040,6 +1124,7 @@ void esyms_init(emacs_env *env)
     esym_reference = env->make_global_ref(env, env->intern(env, "reference"));
     esym_reflog = env->make_global_ref(env, env->intern(env, "reflog"));
     esym_reflog_entry = env->make_global_ref(env, env->intern(env, "reflog-entry"));
+    esym_refs = env->make_global_ref(env, env->intern(env, "refs"));
     esym_refspec = env->make_global_ref(env, env->intern(env, "refspec"));
     esym_remote = env->make_global_ref(env, env->intern(env, "remote"));
     esym_rename_threshold = env->make_global_ref(env, env->intern(env, "rename-threshold"));
@@ -1054,8 +1139,11 @@ void esyms_init(emacs_env *env)
     esym_reverse = env->make_global_ref(env, env->intern(env, "reverse"));
     esym_revert = env->make_global_ref(env, env->intern(env, "revert"));
     esym_revert_sequence = env->make_global_ref(env, env->intern(env, "revert-sequence"));
+    esym_revisions = env->make_global_ref(env, env->intern(env, "revisions"));
     esym_revwalk = env->make_global_ref(env, env->intern(env, "revwalk"));
     esym_safe = env->make_global_ref(env, env->intern(env, "safe"));
+    esym_save_current_buffer = env->make_global_ref(env, env->intern(env, "save-current-buffer"));
+    esym_set_buffer = env->make_global_ref(env, env->intern(env, "set-buffer"));
     esym_sha1 = env->make_global_ref(env, env->intern(env, "sha1"));
     esym_show_binary = env->make_global_ref(env, env->intern(env, "show-binary"));
     esym_show_commit_oid_as_fallback = env->make_global_ref(env, env->intern(env, "show-commit-oid-as-fallback"));
@@ -1064,6 +1152,8 @@ void esyms_init(emacs_env *env)
     esym_sideband_progress = env->make_global_ref(env, env->intern(env, "sideband-progress"));
     esym_signature = env->make_global_ref(env, env->intern(env, "signature"));
     esym_simplify_alnum = env->make_global_ref(env, env->intern(env, "simplify-alnum"));
+    esym_since = env->make_global_ref(env, env->intern(env, "since"));
+    esym_size = env->make_global_ref(env, env->intern(env, "size"));
     esym_skip = env->make_global_ref(env, env->intern(env, "skip"));
     esym_skip_binary_check = env->make_global_ref(env, env->intern(env, "skip-binary-check"));
     esym_skip_reuc = env->make_global_ref(env, env->intern(env, "skip-reuc"));
@@ -1083,8 +1173,10 @@ void esyms_init(emacs_env *env)
     esym_style_diff3 = env->make_global_ref(env, env->intern(env, "style-diff3"));
     esym_style_merge = env->make_global_ref(env, env->intern(env, "style-merge"));
     esym_submodule = env->make_global_ref(env, env->intern(env, "submodule"));
+    esym_summary = env->make_global_ref(env, env->intern(env, "summary"));
     esym_symbol_value = env->make_global_ref(env, env->intern(env, "symbol-value"));
     esym_symbolic = env->make_global_ref(env, env->intern(env, "symbolic"));
+    esym_symbolp = env->make_global_ref(env, env->intern(env, "symbolp"));
     esym_system = env->make_global_ref(env, env->intern(env, "system"));
     esym_t = env->make_global_ref(env, env->intern(env, "t"));
     esym_tag = env->make_global_ref(env, env->intern(env, "tag"));
@@ -1109,6 +1201,7 @@ void esyms_init(emacs_env *env)
     esym_unmodified = env->make_global_ref(env, env->intern(env, "unmodified"));
     esym_unreadable = env->make_global_ref(env, env->intern(env, "unreadable"));
     esym_unspecified = env->make_global_ref(env, env->intern(env, "unspecified"));
+    esym_until = env->make_global_ref(env, env->intern(env, "until"));
     esym_untracked = env->make_global_ref(env, env->intern(env, "untracked"));
     esym_up_to_date = env->make_global_ref(env, env->intern(env, "up-to-date"));
     esym_update_fetchhead = env->make_global_ref(env, env->intern(env, "update-fetchhead"));
@@ -1128,6 +1221,7 @@ void esyms_init(emacs_env *env)
     esym_wd_uninitialized = env->make_global_ref(env, env->intern(env, "wd-uninitialized"));
     esym_wd_untracked = env->make_global_ref(env, env->intern(env, "wd-untracked"));
     esym_wd_wd_modified = env->make_global_ref(env, env->intern(env, "wd-wd-modified"));
+    esym_word = env->make_global_ref(env, env->intern(env, "word"));
     esym_workdir_only = env->make_global_ref(env, env->intern(env, "workdir-only"));
     esym_wrong_type_argument = env->make_global_ref(env, env->intern(env, "wrong-type-argument"));
     esym_wrong_value_argument = env->make_global_ref(env, env->intern(env, "wrong-value-argument"));
@@ -109,26 +109,41 @@ extern emacs_value esym_apply_mailbox;
 extern emacs_value esym_apply_mailbox_or_rebase;
 extern emacs_value esym_args_out_of_range;
 extern emacs_value esym_assq;
+extern emacs_value esym_author;
+extern emacs_value esym_author_email;
+extern emacs_value esym_author_name;
+extern emacs_value esym_author_time;
 extern emacs_value esym_auto;
 extern emacs_value esym_base;
 extern emacs_value esym_baseline;
 extern emacs_value esym_bisect;
 extern emacs_value esym_blame;
 extern emacs_value esym_blame_hunk;
+extern emacs_value esym_blame_session;
 extern emacs_value esym_blob;
 extern emacs_value esym_blob_executable;
 extern emacs_value esym_break_rewrites;
 extern emacs_value esym_break_rewrites_for_renames_only;
 extern emacs_value esym_break_rewrite_threshold;
+extern emacs_value esym_budget;
+extern emacs_value esym_budget_exceeded;
+extern emacs_value esym_buffer_file_coding_system;
+extern emacs_value esym_buffer_substring_no_properties;
+extern emacs_value esym_bufferp;
 extern emacs_value esym_callbacks;
 extern emacs_value esym_car;
 extern emacs_value esym_cdr;
 extern emacs_value esym_certificate_check;
+extern emacs_value esym_char;
 extern emacs_value esym_check_pathspec;
 extern emacs_value esym_checkout;
 extern emacs_value esym_cherrypick;
 extern emacs_value esym_cherrypick_sequence;
 extern emacs_value esym_commit;
+extern emacs_value esym_committer;
+extern emacs_value esym_committer_email;
+extern emacs_value esym_committer_name;
+extern emacs_value esym_committer_time;
 extern emacs_value esym_config;
 extern emacs_value esym_conflict;
 extern emacs_value esym_conflicted;
@@ -158,7 +173,10 @@ extern emacs_value esym_dirty_suffix;
 extern emacs_value esym_disable_pathspec_match;
 extern emacs_value esym_download_tags;
 extern emacs_value esym_enable_fast_untracked_dirs;
+extern emacs_value esym_encode_coding_string;
 extern emacs_value esym_encode_time;
+extern emacs_value esym_entries;
+extern emacs_value esym_eval;
 extern emacs_value esym_exclude_submodules;
 extern emacs_value esym_expand_file_name;
 extern emacs_value esym_fail_on_conflict;
@@ -182,11 +200,14 @@ extern emacs_value esym_find_renames;
 extern emacs_value esym_find_renames_from_rewrites;
 extern emacs_value esym_find_rewrites;
 extern emacs_value esym_first_parent;
+extern emacs_value esym_first_parent_below;
 extern emacs_value esym_flags;
+extern emacs_value esym_follow;
 extern emacs_value esym_force;
 extern emacs_value esym_force_binary;
 extern emacs_value esym_force_text;
 extern emacs_value esym_from_owner;
+extern emacs_value esym_full_history;
 extern emacs_value esym_functionp;
 extern emacs_value esym_giterr;
 extern emacs_value esym_giterr_callback;
@@ -222,11 +243,14 @@ extern emacs_value esym_giterr_thread;
 extern emacs_value esym_giterr_tree;
 extern emacs_value esym_giterr_worktree;
 extern emacs_value esym_giterr_zlib;
+extern emacs_value esym_glob;
 extern emacs_value esym_global;
 extern emacs_value esym_hard;
 extern emacs_value esym_headers;
+extern emacs_value esym_hits;
 extern emacs_value esym_hostkey_libssh2;
 extern emacs_value esym_https;
+extern emacs_value esym_id;
 extern emacs_value esym_id_abbrev;
 extern emacs_value esym_ignore_case;
 extern emacs_value esym_ignore_filemode;
@@ -266,6 +290,7 @@ extern emacs_value esym_length;
 extern emacs_value esym_libgit_annotated_commit_p;
 extern emacs_value esym_libgit_blame_hunk_p;
 extern emacs_value esym_libgit_blame_p;
+extern emacs_value esym_libgit_blame_session_p;
 extern emacs_value esym_libgit_blob_p;
 extern emacs_value esym_libgit_commit_p;
 extern emacs_value esym_libgit_config_p;
@@ -277,6 +302,7 @@ extern emacs_value esym_libgit_diff_line_p;
 extern emacs_value esym_libgit_diff_p;
 extern emacs_value esym_libgit_index_entry_p;
 extern emacs_value esym_libgit_index_p;
+extern emacs_value esym_libgit_log_cursor_p;
 extern emacs_value esym_libgit_object_p;
 extern emacs_value esym_libgit_pathspec_match_list_p;
 extern emacs_value esym_libgit_pathspec_p;
@@ -293,18 +319,25 @@ extern emacs_value esym_libgit_tag_p;
 extern emacs_value esym_libgit_transaction_p;
 extern emacs_value esym_libgit_tree_p;
 extern emacs_value esym_libgit_treebuilder_p;
+extern emacs_value esym_limit;
 extern emacs_value esym_link;
 extern emacs_value esym_list;
 extern emacs_value esym_listp;
 extern emacs_value esym_local;
+extern emacs_value esym_log_cursor;
 extern emacs_value esym_max_candidates_tags;
+extern emacs_value esym_max_count;
 extern emacs_value esym_max_line;
 extern emacs_value esym_max_size;
 extern emacs_value esym_md5;
 extern emacs_value esym_merge;
+extern emacs_value esym_merges;
+extern emacs_value esym_message;
+extern emacs_value esym_message_regexp;
 extern emacs_value esym_metric;
 extern emacs_value esym_min_line;
 extern emacs_value esym_minimal;
+extern emacs_value esym_misses;
 extern emacs_value esym_mixed;
 extern emacs_value esym_modified;
 extern emacs_value esym_name_only;
@@ -334,12 +367,16 @@ extern emacs_value esym_on;
 extern emacs_value esym_ondemand;
 extern emacs_value esym_only_follow_first_parent;
 extern emacs_value esym_ours;
+extern emacs_value esym_parallel;
+extern emacs_value esym_parents;
 extern emacs_value esym_patch;
 extern emacs_value esym_patch_header;
 extern emacs_value esym_pathspec;
 extern emacs_value esym_pathspec_match_list;
 extern emacs_value esym_patience;
 extern emacs_value esym_pattern;
+extern emacs_value esym_point_max;
+extern emacs_value esym_point_min;
 extern emacs_value esym_post;
 extern emacs_value esym_pre;
 extern emacs_value esym_programdata;
@@ -358,6 +395,7 @@ extern emacs_value esym_recursion_limit;
 extern emacs_value esym_reference;
 extern emacs_value esym_reflog;
 extern emacs_value esym_reflog_entry;
+extern emacs_value esym_refs;
 extern emacs_value esym_refspec;
 extern emacs_value esym_remote;
 extern emacs_value esym_rename_threshold;
@@ -372,8 +410,11 @@ extern emacs_value esym_repository;
 extern emacs_value esym_reverse;
 extern emacs_value esym_revert;
 extern emacs_value esym_revert_sequence;
+extern emacs_value esym_revisions;
 extern emacs_value esym_revwalk;
 extern emacs_value esym_safe;
+extern emacs_value esym_save_current_buffer;
+extern emacs_value esym_set_buffer;
 extern emacs_value esym_sha1;
 extern emacs_value esym_show_binary;
 extern emacs_value esym_show_commit_oid_as_fallback;
@@ -382,6 +423,8 @@ extern emacs_value esym_show_untracked_content;
 extern emacs_value esym_sideband_progress;
 extern emacs_value esym_signature;
 extern emacs_value esym_simplify_alnum;
+extern emacs_value esym_since;
+extern emacs_value esym_size;
 extern emacs_value esym_skip;
 extern emacs_value esym_skip_binary_check;
 extern emacs_value esym_skip_reuc;
@@ -401,8 +444,10 @@ extern emacs_value esym_stringp;
 extern emacs_value esym_style_diff3;
 extern emacs_value esym_style_merge;
 extern emacs_value esym_submodule;
+extern emacs_value esym_summary;
 extern emacs_value esym_symbol_value;
 extern emacs_value esym_symbolic;
+extern emacs_value esym_symbolp;
 extern emacs_value esym_system;
 extern emacs_value esym_t;
 extern emacs_value esym_tag;
@@ -427,6 +472,7 @@ extern emacs_value esym_union;
 extern emacs_value esym_unmodified;
 extern emacs_value esym_unreadable;
 extern emacs_value esym_unspecified;
+extern emacs_value esym_until;
 extern emacs_value esym_untracked;
 extern emacs_value esym_up_to_date;
 extern emacs_value esym_update_fetchhead;
@@ -446,6 +492,7 @@ extern emacs_value esym_wd_modified;
 extern emacs_value esym_wd_uninitialized;
 extern emacs_value esym_wd_untracked;
 extern emacs_value esym_wd_wd_modified;
+extern emacs_value esym_word;
 extern emacs_value esym_workdir_only;
 extern emacs_value esym_wrong_type_argument;
 extern emacs_value esym_wrong_value_argument;
@@ -118,3 +118,192 @@
     (let* ((repo (libgit-repository-open path))
            (blame (libgit-blame-file repo "test")))
       (should (= 3 (libgit-blame-get-hunk-count blame))))))
+
+(ert-deftest blame-incremental ()
+  (with-temp-dir path
+    (init)
+    (commit-change "test" "foo\nbar\nbaz\n")
+    (let* ((repo (libgit-repository-open path))
+           (first (libgit-reference-name-to-id repo "HEAD"))
+           second calls)
+      (commit-change "test" "foo\nbum\nbaz\nbin\n")
+      (setq second (libgit-reference-name-to-id repo "HEAD"))
+
+      ;; the newest commit is reported first
+      (should (eq t (libgit-blame-incremental
+                     repo "test" (lambda (id hunks) (push (cons id hunks) calls)))))
+      (should (equal (nreverse calls)
+                     `((,second . [2 1 2 4 1 4])
+                       (,first . [1 1 1 3 1 3]))))
+
+      ;; line ranges are respected
+      (setq calls nil)
+      (libgit-blame-incremental
+       repo "test" (lambda (id hunks) (push (cons id hunks) calls))
+       '((min-line . 3) (max-line . 3)))
+      (should (equal calls `((,first . [3 1 3]))))
+
+      ;; the walk can be stopped early
+      (setq calls nil)
+      (should-not (libgit-blame-incremental
+                   repo "test" (lambda (id _hunks) (push id calls) 'abort)))
+      (should (equal calls (list second)))
+
+      ;; options the walk can't honor are rejected
+      (should-error (libgit-blame-incremental
+                     repo "test" #'ignore '((track-copies . t)))))))
+
+(ert-deftest blame-incremental-rename ()
+  (with-temp-dir path
+    (init)
+    (let ((lines (mapcar #'number-to-string (number-sequence 1 20)))
+          repo first second calls)
+      (commit-change "old" (mapconcat (lambda (l) (concat l "\n")) lines ""))
+      (setq repo (libgit-repository-open path)
+            first (libgit-reference-name-to-id repo "HEAD"))
+      (rename-file "old" "new")
+      (setcar (nthcdr 9 lines) "ten")
+      (write "new" (mapconcat (lambda (l) (concat l "\n")) lines ""))
+      (add "old")
+      (add "new")
+      (commit "Rename with changes")
+      (setq second (libgit-reference-name-to-id repo "HEAD"))
+
+      ;; lines that survived the rename are traced to the old name
+      (should (eq t (libgit-blame-incremental
+                     repo "new" (lambda (id hunks) (push (cons id hunks) calls)))))
+      (should (equal (nreverse calls)
+                     `((,second . [10 1 10])
+                       (,first . [1 9 1 11 10 11])))))))
+
+(ert-deftest blame-buffer ()
+  (with-temp-dir path
+    (init)
+    (commit-change "test" "foo\nbar\n")
+    (let* ((repo (libgit-repository-open path))
+           (head (libgit-reference-name-to-id repo "HEAD"))
+           (reference (libgit-blame-file repo "test"))
+           (zeros (make-string 40 ?0)))
+      (dolist (text (list "foo\nnew\nbar\n"
+                          (with-current-buffer (get-buffer-create " *blame-buffer*")
+                            (erase-buffer)
+                            (insert "foo\nnew\nbar\n")
+                            (current-buffer))))
+        (let* ((blame (libgit-blame-buffer reference text))
+               (new (libgit-blame-get-hunk-byline blame 2)))
+          (should (libgit-blame-p blame))
+          (should (string= head (libgit-blame-hunk-commit-id
+                                 (libgit-blame-get-hunk-byline blame 1))))
+          (should (string= zeros (libgit-blame-hunk-commit-id new)))
+          (should-not (libgit-blame-hunk-signature new))
+          (should (string= head (libgit-blame-hunk-commit-id
+                                 (libgit-blame-get-hunk-byline blame 3))))))
+      (kill-buffer " *blame-buffer*"))))
+
+(ert-deftest blame-to-vectors ()
+  (with-temp-dir path
+    (init)
+    (commit-change "test" "foo\nbar\nbaz\n")
+    (let* ((repo (libgit-repository-open path))
+           (first (libgit-reference-name-to-id repo "HEAD")))
+      (commit-change "test" "foo\nbum\nbaz\n")
+      (let* ((second (libgit-reference-name-to-id repo "HEAD"))
+             (vectors (libgit-blame-to-vectors (libgit-blame-file repo "test")))
+             (commits (car vectors))
+             (lines (cdr vectors)))
+        (should (= 2 (length commits)))
+        (should (= 3 (length lines)))
+        (should (string= first (aref (aref commits (aref lines 0)) 0)))
+        (should (string= second (aref (aref commits (aref lines 1)) 0)))
+        (should (eq (aref lines 0) (aref lines 2)))
+        (let ((commit (aref commits 0)))
+          (should (string= "A U Thor" (aref commit 1)))
+          (should (string= "author@example.com" (aref commit 2)))
+          (should (integerp (aref commit 3)))
+          (should (string= "test" (aref commit 4))))))))
+
+(ert-deftest blame-session ()
+  (with-temp-dir path
+    (init)
+    (let (repo c1 c2 c3 session)
+      (commit-change "test" "a\nb\nc\n")
+      (setq repo (libgit-repository-open path)
+            c1 (libgit-reference-name-to-id repo "HEAD"))
+      (commit-change "test" "a\nB\nc\n")
+      (setq c2 (libgit-reference-name-to-id repo "HEAD"))
+      (commit-change "test" "a\nB\nc\nd\n")
+      (setq c3 (libgit-reference-name-to-id repo "HEAD"))
+      (cl-flet ((line-ids ()
+                  (let ((vectors (libgit-blame-session-to-vectors session)))
+                    (mapcar (lambda (i) (aref (aref (car vectors) i) 0))
+                            (cdr vectors)))))
+        (setq session (libgit-blame-session-new repo "test"))
+        (should (libgit-blame-session-p session))
+        (should (string= c3 (libgit-blame-session-revision session)))
+        (should (equal (list c1 c2 c1 c3) (line-ids)))
+
+        ;; stepping back to the parent only re-blames lines it changed
+        (should (= 0 (libgit-blame-session-move session c2)))
+        (should (equal (list c1 c2 c1) (line-ids)))
+        (should (= 1 (libgit-blame-session-move session c1)))
+        (should (equal (list c1 c1 c1) (line-ids)))
+
+        ;; and stepping forward attributes changed lines to the child
+        (should (= 1 (libgit-blame-session-move session c2)))
+        (should (equal (list c1 c2 c1) (line-ids)))
+
+        ;; a jump is blamed from scratch
+        (libgit-blame-session-move session c1)
+        (should (= 4 (libgit-blame-session-move session c3)))
+        (should (equal (list c1 c2 c1 c3) (line-ids)))))))
+
+(ert-deftest blame-session-rename ()
+  (with-temp-dir path
+    (init)
+    (let ((lines (mapcar #'number-to-string (number-sequence 1 20)))
+          repo c1 c2 session)
+      (commit-change "old" (mapconcat (lambda (l) (concat l "\n")) lines ""))
+      (setq repo (libgit-repository-open path)
+            c1 (libgit-reference-name-to-id repo "HEAD"))
+      (rename-file "old" "new")
+      (setcar (nthcdr 9 lines) "ten")
+      (write "new" (mapconcat (lambda (l) (concat l "\n")) lines ""))
+      (add "old")
+      (add "new")
+      (commit "Rename with changes")
+      (setq c2 (libgit-reference-name-to-id repo "HEAD"))
+      (cl-flet ((paths-and-ids ()
+                  (let ((vectors (libgit-blame-session-to-vectors session)))
+                    (cons (mapcar (lambda (commit) (aref commit 4)) (car vectors))
+                          (mapcar (lambda (i) (aref (aref (car vectors) i) 0))
+                                  (cdr vectors))))))
+        ;; each commit has the name of the file in that commit
+        (setq session (libgit-blame-session-new repo "new"))
+        (should (equal (paths-and-ids)
+                       `(("old" "new") ,@(make-list 9 c1) ,c2 ,@(make-list 10 c1))))
+
+        ;; the session follows the file across the rename both ways
+        (should (= 1 (libgit-blame-session-move session c1)))
+        (should (equal (paths-and-ids) `(("old") ,@(make-list 20 c1))))
+        (should (= 1 (libgit-blame-session-move session c2)))
+        (should (equal (paths-and-ids)
+                       `(("old" "new") ,@(make-list 9 c1) ,c2 ,@(make-list 10 c1))))))))
+
+(ert-deftest blame-files ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "foo\nbar\n")
+    (commit-change "b" "baz\n")
+    (commit-change "a" "foo\nbum\nbin\n")
+    (let ((repo (libgit-repository-open path)))
+      (dolist (threads '(nil 1 4))
+        (let* ((result (libgit-blame-files repo '("a" "b") nil threads))
+               (files (car result)))
+          (should (equal '("a" "b") (mapcar #'car files)))
+          (should (= 2 (length (car (cdr (assoc "a" files))))))
+          (should (= 3 (length (cdr (cdr (assoc "a" files))))))
+          (should (= 1 (length (cdr (cdr (assoc "b" files))))))
+          (should (equal '(("A U Thor" "author@example.com" . 4)) (cdr result)))))
+      (should-error (libgit-blame-files repo '("a") nil 0) :type 'args-out-of-range)
+      (should-error (libgit-blame-files repo '("a") nil -1) :type 'args-out-of-range)
+      (should-error (libgit-blame-files repo '("a" "missing"))))))
@@ -60,3 +60,25 @@
         (should (libgit-blob-p blob))
         (should-not (multibyte-string-p (libgit-blob-rawcontent blob)))
         (should (equal cont (libgit-blob-rawcontent blob)))))))
+
+(ert-deftest blob-lines ()
+  (with-temp-dir path
+    (init)
+    (let* ((repo (libgit-repository-open path))
+           (text (libgit-blob-lookup repo (libgit-blob-create-fromstring repo "ab\n\ncd\n")))
+           (partial (libgit-blob-lookup repo (libgit-blob-create-fromstring repo "ab\ncd")))
+           (empty (libgit-blob-lookup repo (libgit-blob-create-fromstring repo "")))
+           (long (libgit-blob-lookup
+                  repo (libgit-blob-create-fromstring
+                        repo (concat (make-string 10000 ?a) (string 0) "\n")))))
+      (should (= 3 (libgit-blob-line-count text)))
+      (should (= 2 (libgit-blob-line-count partial)))
+      (should (= 0 (libgit-blob-line-count empty)))
+      (should (= 1 (libgit-blob-line-count long)))
+      (should (equal [0 3 4] (libgit-blob-line-offsets text)))
+      (should (equal [0 3] (libgit-blob-line-offsets partial)))
+      (should (equal [] (libgit-blob-line-offsets empty)))
+      ;; The NUL byte is past the range checked by the default heuristic
+      (should-not (libgit-blob-binary-p long))
+      (should (libgit-blob-binary-p long 'full))
+      (should-not (libgit-blob-binary-p text 'full)))))
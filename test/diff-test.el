@@ -268,3 +268,186 @@
      (should success)
      (should (= 1 (libgit-diff-num-deltas diff)))
      (should (= 1 (libgit-diff-num-deltas diff 'renamed))))))
+
+(ert-deftest diff-refine ()
+  (with-temp-dir path
+    (init)
+    (commit-change "file" "one\nfoo cat baz\ntwo\n")
+    (commit-change "file" "one\nfoo cut baz\ntwo\n")
+    (let* ((repo (libgit-repository-open path))
+           (new-tree (libgit-revparse-single repo "HEAD^{tree}"))
+           (old-tree (libgit-revparse-single repo "HEAD~1^{tree}"))
+           (diff (libgit-diff-tree-to-tree repo old-tree new-tree))
+           words chars)
+      (libgit-diff-foreach
+       diff
+       (lambda (_ _))
+       nil
+       (lambda (delta hunk)
+         (setq words (libgit-diff-hunk-refine delta hunk))
+         (setq chars (libgit-diff-hunk-refine delta hunk 'char))))
+      (should (equal words [1 4 7 2 4 7]))
+      (should (equal chars [1 5 6 2 5 6]))
+      (should (equal (libgit-diff-refine diff) [0 0 1 4 7 0 0 2 4 7]))
+      (should-error (libgit-diff-refine diff 'line)))))
+
+(ert-deftest diff-buffer ()
+  (with-temp-dir path
+    (init)
+    (commit-change "file" "a\nb\nc\nd\n")
+    (let* ((repo (libgit-repository-open path))
+           (blob (libgit-revparse-single repo "HEAD:file")))
+      (should (equal (libgit-diff-buffer-to-blob blob "a\nB\nc\nd\ne\n")
+                     [?! 2 1 2 1 ?+ 4 0 5 1]))
+      (should (equal (libgit-diff-buffer-to-blob blob "b\nc\nd\n")
+                     [?- 1 1 0 0]))
+      (should (equal (libgit-diff-buffer-to-blob blob "a\nb\nc\nd\n") []))
+      (with-temp-buffer
+        (insert "a\nb\nX\nd\nignored\n")
+        (narrow-to-region (point-min) 9)
+        (should (equal (libgit-diff-buffer-to-index repo "file" (current-buffer))
+                       [?! 3 1 3 1])))
+      (should-not (libgit-diff-buffer-to-index repo "nonexistent" "a\n"))
+      (should-error (libgit-diff-buffer-to-blob blob 'a)))))
+
+(ert-deftest diff-buffer-filters ()
+  (with-temp-dir path
+    (init)
+    (write ".gitattributes" "file text eol=crlf\n")
+    (add ".gitattributes")
+    (commit-change "file" "a\nb\nc\n")
+    (commit-change "data" "x\0y\n")
+    (let* ((repo (libgit-repository-open path))
+           (blob (libgit-revparse-single repo "HEAD:file"))
+           (data (libgit-revparse-single repo "HEAD:data")))
+      (with-temp-buffer
+        (insert "a\nB\nc\n")
+        (setq buffer-file-coding-system 'utf-8-dos)
+        (should (equal (libgit-diff-buffer-to-index repo "file" (current-buffer))
+                       [?! 2 1 2 1]))
+        (should (equal (libgit-diff-buffer-to-blob blob (current-buffer) "file")
+                       [?! 2 1 2 1]))
+        (should (equal (libgit-diff-buffer-to-blob blob (current-buffer))
+                       [?! 1 3 1 3]))
+
+        ;; An error in the buffer leaves the current buffer alone
+        (setq buffer-file-coding-system 'no-such-coding-system)
+        (let ((buffer (current-buffer)))
+          (with-temp-buffer
+            (let ((current (current-buffer)))
+              (should-error (libgit-diff-buffer-to-blob blob buffer))
+              (should (eq current (current-buffer)))))))
+      (should (equal (libgit-diff-buffer-to-blob data "x\0y\nz\n") [?+ 1 0 2 1]))
+      (should (equal (libgit-diff-buffer-to-blob data "x\0y\nz\n" "data") [?+ 1 0 2 1]))
+      (should (equal (libgit-diff-buffer-to-index repo "data" "x\0y\nz\n") [?+ 1 0 2 1])))))
+
+(ert-deftest diff-cache ()
+  (with-temp-dir path
+    (init)
+    (commit-change "file" "a\nb\n")
+    (commit-change "file" "a\nc\n")
+    (libgit-diff-cache-flush)
+    (let* ((repo (libgit-repository-open path))
+           (new-tree (libgit-revparse-single repo "HEAD^{tree}"))
+           (old-tree (libgit-revparse-single repo "HEAD~1^{tree}"))
+           (stats (libgit-diff-cache-stats))
+           (hits (alist-get 'hits stats))
+           (misses (alist-get 'misses stats))
+           (diff (libgit-diff-tree-to-tree repo old-tree new-tree))
+           (text (libgit-diff-to-string diff)))
+      (should (string-match-p "^-b\n\\+c\n" text))
+      (should (= 1 (alist-get 'entries (libgit-diff-cache-stats))))
+      (should (= (1+ misses) (alist-get 'misses (libgit-diff-cache-stats))))
+      (let ((again (libgit-diff-tree-to-tree repo old-tree new-tree)))
+        (should (= (1+ hits) (alist-get 'hits (libgit-diff-cache-stats))))
+        (should (string= text (libgit-diff-to-string again))))
+      ;; Different options are a different entry
+      (libgit-diff-tree-to-tree repo old-tree new-tree '((context-lines . 0)))
+      (should (= 2 (alist-get 'entries (libgit-diff-cache-stats))))
+      (libgit-diff-tree-to-tree repo old-tree new-tree '((pathspec "other")))
+      (should (= 3 (alist-get 'entries (libgit-diff-cache-stats))))
+      ;; Modifying a diff in place leaves the cached one alone
+      (libgit-diff-find-similar diff)
+      (should (= 3 (alist-get 'entries (libgit-diff-cache-stats))))
+      (libgit-diff-cache-flush)
+      (should (= 0 (alist-get 'entries (libgit-diff-cache-stats))))
+      (should (= 0 (alist-get 'size (libgit-diff-cache-stats)))))))
+
+(ert-deftest diff-cache-find-similar ()
+  (with-temp-dir path
+    (init)
+    (commit-change "file1" "content")
+    (rename-file "file1" "file2")
+    (add "file1")
+    (add "file2")
+    (commit "Rename")
+    (let* ((repo (libgit-repository-open path))
+           (new-tree (libgit-revparse-single repo "HEAD^{tree}"))
+           (old-tree (libgit-revparse-single repo "HEAD~1^{tree}"))
+           (diff (libgit-diff-tree-to-tree repo old-tree new-tree))
+           (other (libgit-diff-tree-to-tree repo old-tree new-tree)))
+      (libgit-diff-find-similar diff)
+      (should (= 1 (libgit-diff-num-deltas diff 'renamed)))
+      ;; Other holders of the same cached diff don't see the change
+      (should (= 2 (libgit-diff-num-deltas other)))
+      (should (= 0 (libgit-diff-num-deltas other 'renamed)))
+      (should (= 2 (libgit-diff-num-deltas
+                    (libgit-diff-tree-to-tree repo old-tree new-tree)))))))
+
+(ert-deftest diff-find-parallel ()
+  (with-temp-dir path
+    (init)
+    (commit-change "file1" "line1\nline2\nline3\nline4\nline5\nline6\nline7\nline8\n")
+    (delete-file "file1")
+    (write "file2" "line1\nline2\nline3\nline4\nline5\nline6\nline7\nchanged\n")
+    (add "file1")
+    (add "file2")
+    (commit "Rename with changes")
+    (let* ((repo (libgit-repository-open path))
+           (new-tree (libgit-revparse-single repo "HEAD^{tree}"))
+           (old-tree (libgit-revparse-single repo "HEAD~1^{tree}")))
+      (dolist (options '(((parallel . 2)) ((parallel . t) (budget . 60000)) ((budget . 60000))))
+        (let ((diff (libgit-diff-tree-to-tree repo old-tree new-tree)))
+          (should (eq t (libgit-diff-find-similar
+                         diff `((flags . (find-renames)) ,@options))))
+          (should (= 1 (libgit-diff-num-deltas diff)))
+          (should (= 1 (libgit-diff-num-deltas diff 'renamed)))))
+      (let ((diff (libgit-diff-tree-to-tree repo old-tree new-tree)))
+        (should-error (libgit-diff-find-similar diff '((parallel . yes))))))))
+
+(ert-deftest diff-find-budget ()
+  (with-temp-dir path
+    (init)
+    (cl-flet ((content (i) (mapconcat #'number-to-string (number-sequence i (+ i 2000)) "\n")))
+      (dotimes (i 100)
+        (write (format "old%d" i) (content i)))
+      (write "same" "identical\ncontent\n")
+      (add ".")
+      (commit "Old files")
+      (run "git" "rm" "-q" "old*")
+      (run "git" "mv" "same" "moved")
+      (dotimes (i 100)
+        (write (format "new%d" i) (concat (content i) "\nchanged\n")))
+      (add ".")
+      (commit "Renames with changes"))
+    (let* ((repo (libgit-repository-open path))
+           (new-tree (libgit-revparse-single repo "HEAD^{tree}"))
+           (old-tree (libgit-revparse-single repo "HEAD~1^{tree}")))
+      ;; Past the budget, only identical files are matched
+      (let ((diff (libgit-diff-tree-to-tree repo old-tree new-tree)))
+        (should (eq 'budget-exceeded
+                    (libgit-diff-find-similar
+                     diff '((flags . (find-renames)) (budget . 0)))))
+        (should (= 1 (libgit-diff-num-deltas diff 'renamed)))
+        (should (= 100 (libgit-diff-num-deltas diff 'added)))
+        (should-error (libgit-diff-find-similar diff '((budget . -1)))
+                      :type 'args-out-of-range)
+        (should-error (libgit-diff-find-similar diff '((parallel . 0)))
+                      :type 'args-out-of-range)
+        (should-error (libgit-diff-find-similar diff '((parallel . -1)))
+                      :type 'args-out-of-range))
+      ;; Every rename is found on several threads
+      (let ((diff (libgit-diff-tree-to-tree repo old-tree new-tree)))
+        (should (eq t (libgit-diff-find-similar
+                       diff '((flags . (find-renames)) (parallel . 4)))))
+        (should (= 101 (libgit-diff-num-deltas diff 'renamed)))))))
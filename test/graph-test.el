@@ -30,6 +30,52 @@
         (should (equal '(3 . 2) (libgit-graph-ahead-behind repo c4 c6)))
         (should (equal '(3 . 3) (libgit-graph-ahead-behind repo c4 c7)))))))
 
+(ert-deftest branches-ahead-behind ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (run "git" "branch" "other")
+    (run "git" "checkout" "-b" "branch")
+    (commit-change "a" "2")
+    (commit-change "a" "3")
+    (run "git" "branch" "--set-upstream-to=master")
+    (run "git" "checkout" "master")
+    (commit-change "a" "4")
+    (let ((repo (libgit-repository-open path)))
+      (dotimes (_ 2)
+        (should (equal '(("branch" 2 . 1) ("master") ("other"))
+                       (libgit-branches-ahead-behind repo)))
+        (should (equal '(("branch" 2 . 1) ("master" 0 . 0) ("other" 0 . 1))
+                       (libgit-branches-ahead-behind repo nil "master")))
+        (should (equal '(("branch" 2 . 0))
+                       (libgit-branches-ahead-behind repo "b*" "other")))
+        ;; The second round walks the commit graph
+        (libgit-commit-graph-write repo)
+        (run "git" "commit-graph" "verify")))))
+
+(ert-deftest refs-containing ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (run "git" "tag" "-a" "v1" "-m" "v1")
+    (run "git" "checkout" "-b" "branch")
+    (commit-change "a" "2")
+    (run "git" "checkout" "master")
+    (commit-change "a" "3")
+    (run "git" "tag" "v2")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "v1^{commit}"))
+          (c2 (rev-parse "branch"))
+          (c3 (rev-parse)))
+      (dotimes (_ 2)
+        (should (equal '("refs/heads/branch" "refs/heads/master" "refs/tags/v1" "refs/tags/v2")
+                       (libgit-refs-containing repo c1)))
+        (should (equal '("refs/heads/branch") (libgit-refs-containing repo c2)))
+        (should (equal '("refs/tags/v2") (libgit-refs-containing repo c3 "refs/tags/*")))
+        ;; The second round uses generation numbers
+        (libgit-commit-graph-write repo)
+        (run "git" "commit-graph" "verify")))))
+
 (ert-deftest descendant-p ()
   (let (c1 c2 c3 c4 c5 c6 c7)
     (with-temp-dir path
@@ -56,3 +102,74 @@
         (should (libgit-graph-descendant-p repo c4 c2))
         (should-not (libgit-graph-descendant-p repo c7 c2))
         (should-not (libgit-graph-descendant-p repo c2 c7))))))
+
+(ert-deftest commit-graph ()
+  (let (c1 c2 c3 c4 c5 c6)
+    (with-temp-dir path
+      (init)
+      (commit-change "a" "1")
+      (setq c1 (rev-parse))
+      (run "git" "checkout" "-b" "branch")
+      (commit-change "b" "2")
+      (setq c2 (rev-parse))
+      (commit-change "b" "3")
+      (setq c3 (rev-parse))
+      (run "git" "checkout" "master")
+      (commit-change "a" "4")
+      (setq c4 (rev-parse))
+      (merge "branch")
+      (setq c5 (rev-parse))
+      (let ((repo (libgit-repository-open path)))
+        (should-not (libgit-commit-graph-generation repo c1))
+        (should (= 5 (libgit-commit-graph-write repo)))
+        (run "git" "commit-graph" "verify")
+        (should (= #o444 (file-modes ".git/objects/info/commit-graph")))
+        (should (= 1 (libgit-commit-graph-generation repo c1)))
+        (should (= 3 (libgit-commit-graph-generation repo c3)))
+        (should (= 4 (libgit-commit-graph-generation repo c5)))
+        (should (equal '(1 . 2) (libgit-graph-ahead-behind repo c4 c3)))
+        (should (equal '(0 . 0) (libgit-graph-ahead-behind repo c5 c5)))
+        (should (libgit-graph-descendant-p repo c5 c2))
+        (should-not (libgit-graph-descendant-p repo c3 c4))
+        (should-not (libgit-graph-descendant-p repo c5 c5))
+        (should (string= c1 (libgit-merge-base repo (list c3 c4))))
+        (should (string= c3 (libgit-merge-base repo (list c3 c5))))
+
+        ;; Commits missing from the graph fall back to libgit2
+        (commit-change "a" "6")
+        (setq c6 (rev-parse))
+        (should-not (libgit-commit-graph-generation repo c6))
+        (should (equal '(1 . 0) (libgit-graph-ahead-behind repo c6 c5)))
+        (should (= 6 (libgit-commit-graph-write repo)))
+        (run "git" "commit-graph" "verify")
+        (should (= 5 (libgit-commit-graph-generation repo c6)))
+        (should (equal '(1 . 0) (libgit-graph-ahead-behind repo c6 c5)))
+
+        ;; A lock held by someone else is left alone
+        (write ".git/objects/info/commit-graph.lock" "busy")
+        (should-error (libgit-commit-graph-write repo))
+        (should (string= "busy" (read-file ".git/objects/info/commit-graph.lock")))
+        (delete-file ".git/objects/info/commit-graph.lock")))))
+
+(ert-deftest commit-graph-criss-cross ()
+  (let (c2 c3 m1 m2 base)
+    (with-temp-dir path
+      (init)
+      (commit-change "a" "1")
+      (create-branch "branch")
+      (commit-change "b" "2")
+      (setq c2 (rev-parse))
+      (checkout "master")
+      (commit-change "a" "3")
+      (setq c3 (rev-parse))
+      (merge c2)
+      (setq m1 (rev-parse))
+      (checkout "branch")
+      (merge c3)
+      (setq m2 (rev-parse))
+      (let ((repo (libgit-repository-open path)))
+        (should (= 2 (length (libgit-merge-bases repo (list m1 m2)))))
+        (setq base (libgit-merge-base repo (list m1 m2)))
+        ;; The graph gives the same one of the two merge bases
+        (should (= 5 (libgit-commit-graph-write repo)))
+        (should (string= base (libgit-merge-base repo (list m1 m2))))))))
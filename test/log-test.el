@@ -0,0 +1,236 @@
+(ert-deftest log-fields ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1" "first")
+    (commit-change "a" "2" "second\n\nbody")
+    (let* ((repo (libgit-repository-open path))
+           (c1 (rev-parse "HEAD~"))
+           (c2 (rev-parse))
+           (log (libgit-log repo nil '(id parents author-name author-email
+                                       committer-time summary message refs))))
+      (should (vectorp log))
+      (should (= 2 (length log)))
+      (let ((rec (aref log 0)))
+        (should (string= c2 (aref rec 0)))
+        (should (equal (list c1) (aref rec 1)))
+        (should (string= "A U Thor" (aref rec 2)))
+        (should (string= "author@example.com" (aref rec 3)))
+        (should (integerp (aref rec 4)))
+        (should (string= "second" (aref rec 5)))
+        (should (string= "second\n\nbody\n" (aref rec 6)))
+        (should (member "HEAD" (aref rec 7)))
+        (should (member "refs/heads/master" (aref rec 7))))
+      (let ((rec (aref log 1)))
+        (should (string= c1 (aref rec 0)))
+        (should-not (aref rec 1))
+        (should-not (aref rec 7))))))
+
+(ert-deftest log-limit-offset ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (commit-change "a" "2")
+    (commit-change "a" "3")
+    (commit-change "a" "4")
+    (let ((repo (libgit-repository-open path)))
+      (should (equal (vector (vector (rev-parse "HEAD~1")) (vector (rev-parse "HEAD~2")))
+                     (libgit-log repo "HEAD" '(id) 2 1)))
+      (should (= 4 (length (libgit-log repo "HEAD" '(id)))))
+      (should (= 0 (length (libgit-log repo "HEAD" '(id) nil 10)))))))
+
+(ert-deftest log-cursor ()
+  (with-temp-dir path
+    (init)
+    (dotimes (i 5)
+      (commit-change "a" (number-to-string i)))
+    (let* ((repo (libgit-repository-open path))
+           (ids (cl-loop for i below 5
+                         collect (vector (rev-parse (format "HEAD~%d" i)))))
+           (cursor (libgit-log-cursor-new repo nil '(id))))
+      (should (libgit-log-cursor-p cursor))
+      (should (equal (vconcat (cl-subseq ids 0 2)) (libgit-log-cursor-next cursor 2)))
+      (should (equal (vconcat (cl-subseq ids 2 4)) (libgit-log-cursor-next cursor 2)))
+      (should (equal (vconcat (cl-subseq ids 4)) (libgit-log-cursor-next cursor 2)))
+      (should (equal [] (libgit-log-cursor-next cursor 2)))
+
+      (setq cursor (libgit-log-cursor-new repo "HEAD~2" '(id) '(topological)))
+      (should (equal (vconcat (cl-subseq ids 2 3)) (libgit-log-cursor-next cursor 1)))
+      (should (libgit-log-cursor-valid-p cursor))
+      ;; Packing moves the references without changing them
+      (run "git" "pack-refs" "--all")
+      (should (libgit-log-cursor-valid-p cursor))
+      (should (equal (vconcat (cl-subseq ids 3 4)) (libgit-log-cursor-next cursor 1)))
+      (commit-change "a" "5")
+      (should-not (libgit-log-cursor-valid-p cursor))
+      (should-error (libgit-log-cursor-next cursor 1)))))
+
+(ert-deftest log-spec ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (commit-change "a" "2")
+    (commit-change "a" "3")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD~2"))
+          (c2 (rev-parse "HEAD~1"))
+          (c3 (rev-parse)))
+      (should (equal (vector (vector c3))
+                     (libgit-log repo (concat c2 "..HEAD") '(id))))
+      (should (equal (vector (vector c2) (vector c1))
+                     (libgit-log repo (list c2) '(id))))
+      (should (equal (vector (vector c3) (vector c2))
+                     (libgit-log repo (list "HEAD" (concat "^" c1)) '(id))))
+      (should-error (libgit-log repo nil '(no-such-field))))))
+
+(ert-deftest log-path ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (commit-change "dir/b" "1")
+    (commit-change "a" "2")
+    (commit-change "dir/b" "2")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD~3"))
+          (c2 (rev-parse "HEAD~2"))
+          (c3 (rev-parse "HEAD~1"))
+          (c4 (rev-parse)))
+      (should (equal (vector c3 c1) (libgit-log-path repo "a")))
+      (should (equal (vector c4 c2) (libgit-log-path repo "dir")))
+      (should (equal (vector c4) (libgit-log-path repo "dir/b" '((limit . 1)))))
+      (should (equal (vector c2) (libgit-log-path repo "dir/b" `((revisions . ,c3)))))
+      (should (equal [] (libgit-log-path repo "nothing")))
+      (should-error (libgit-log-path repo "a" '((no-such-option . t))))
+
+      ;; Same results when Bloom filters rule out commits
+      (should (= 4 (libgit-commit-graph-write repo t)))
+      (run "git" "commit-graph" "verify")
+      (should (equal (vector c3 c1) (libgit-log-path repo "a")))
+      (should (equal (vector c4 c2) (libgit-log-path repo "dir/b")))
+      (should (equal (vector c4 c2) (libgit-log-path repo "/dir//b/")))
+      (should (equal (vector c4 c2) (libgit-log-path repo "dir/")))
+      (should (equal [] (libgit-log-path repo "nothing"))))))
+
+(ert-deftest log-path-simplify ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (create-branch "branch")
+    (commit-change "b" "1")
+    (checkout "master")
+    (commit-change "a" "2")
+    (merge "branch")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD^1~"))
+          (c2 (rev-parse "HEAD^2"))
+          (c3 (rev-parse "HEAD^1"))
+          (m (rev-parse)))
+      ;; The merge is the same as one parent, so only that side is followed
+      (should (equal (vector c3 c1) (libgit-log-path repo "a")))
+      (should (equal (vector c2) (libgit-log-path repo "b")))
+      (should (equal (vector m c3 c1) (libgit-log-path repo "a" '((full-history . t)))))
+      (should (equal (vector m c2) (libgit-log-path repo "b" '((full-history . t)))))
+      (let ((log (libgit-log-path repo '("a" "b"))))
+        (should (= 4 (length log)))
+        (should (string= m (aref log 0)))))))
+
+(ert-deftest log-path-follow ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "one\ntwo\nthree\nfour\nfive\n")
+    (commit-change "other" "x")
+    (run "git" "mv" "a" "b")
+    (commit)
+    (commit-change "b" "one\ntwo\nthree\nfour\nfive\nsix\n")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD~3"))
+          (c3 (rev-parse "HEAD~1"))
+          (c4 (rev-parse)))
+      (should (equal (vector c4 c3) (libgit-log-path repo "b")))
+      (should (equal (vector (cons c4 "b") (cons c3 "b") (cons c1 "a"))
+                     (libgit-log-path repo "b" '((follow . t)))))
+      (should (equal (vector (cons c4 "b"))
+                     (libgit-log-path repo "b" '((follow . t) (limit . 1)))))
+      (should-error (libgit-log-path repo '("a" "b") '((follow . t)))))))
+
+(ert-deftest log-line-range ()
+  (with-temp-dir path
+    (init)
+    (commit-change "f" "a\nb\nc\nd\ne\n")
+    (commit-change "f" "a\nb\nC\nd\ne\n")
+    (commit-change "f" "x\ny\na\nb\nC\nd\ne\n")
+    (commit-change "f" "x\ny\na\nb\nC\nd\nE\n")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD~3"))
+          (c2 (rev-parse "HEAD~2"))
+          (c3 (rev-parse "HEAD~1")))
+      ;; Lines move down when lines are added above them
+      (should (equal (vector (cons c2 [3 4]) (cons c1 [3 4]))
+                     (libgit-log-line-range repo "f" 5 6)))
+      (should (equal (vector (cons c3 [1 2]))
+                     (libgit-log-line-range repo "f" 1 2)))
+      (should (equal (vector (cons c2 [3 4]))
+                     (libgit-log-line-range repo "f" 5 6 '((limit . 1)))))
+      (should (equal (vector (cons c1 [3 3]))
+                     (libgit-log-line-range repo "f" 3 3 `((revisions . ,c1)))))
+      (should-error (libgit-log-line-range repo "f" 5 8))
+      (should-error (libgit-log-line-range repo "f" 0 1))
+      (should-error (libgit-log-line-range repo "f" 1 2 '((follow . t)))))))
+
+(ert-deftest log-graph ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (create-branch "branch")
+    (commit-change "b" "1")
+    (checkout "master")
+    (commit-change "a" "2")
+    (merge "branch")
+    (let ((repo (libgit-repository-open path))
+          (m (rev-parse))
+          (c1 (rev-parse "HEAD^1~")))
+      (let* ((walk (libgit-revwalk-new repo))
+             (result (progn (libgit-revwalk-sorting walk '(topological))
+                            (libgit-revwalk-push-head walk)
+                            (libgit-log-graph walk 10 '(id))))
+             (rows (car result)))
+        (should (= 4 (length rows)))
+        (should-not (cdr result))
+        ;; The merge opens a second lane for its second parent, and the
+        ;; lanes join again at the root
+        (should (equal (vector m 0 [0 0 0 1]) (aref rows 0)))
+        (should (equal (vector c1 0 []) (aref rows 3)))
+
+        ;; Continuing from the lanes of a page gives the same rows
+        (libgit-revwalk-push-head walk)
+        (let* ((first (libgit-log-graph walk 2 '(id)))
+               (second (libgit-log-graph walk 2 '(id) (cdr first))))
+          (should (= 2 (length (cdr first))))
+          (should (equal rows (vconcat (car first) (car second)))))))))
+
+(ert-deftest log-pickaxe ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "foo\n")
+    (commit-change "a" "foo\nbar\n")
+    (commit-change "b" "foo bar\n")
+    (commit-change "a" "bar\n")
+    (let ((repo (libgit-repository-open path))
+          (c1 (rev-parse "HEAD~3"))
+          (c2 (rev-parse "HEAD~2"))
+          (c3 (rev-parse "HEAD~1"))
+          (c4 (rev-parse)))
+      (should (equal (vector c4 c3 c1) (libgit-log-pickaxe repo "foo")))
+      (should (equal (vector c3 c2) (libgit-log-pickaxe repo "bar")))
+      (should (equal (vector c4 c1) (libgit-log-pickaxe repo "foo" "a")))
+      (should (equal (vector c4) (libgit-log-pickaxe repo "foo" nil nil '((limit . 1)))))
+      ;; Same results on a single thread
+      (should (equal (vector c4 c3 c1)
+                     (libgit-log-pickaxe repo "foo" nil nil '((parallel . 1)))))
+      (unless (eq system-type 'windows-nt)
+        (should (equal (vector c4 c2 c1) (libgit-log-pickaxe repo "^(foo|bar)$" nil t))))
+      (should-error (libgit-log-pickaxe repo ""))
+      (should-error (libgit-log-pickaxe repo "foo" nil nil '((parallel . 0)))
+                    :type 'args-out-of-range)
+      (should-error (libgit-log-pickaxe repo "foo" nil nil '((parallel . -1)))
+                    :type 'args-out-of-range)
+      (should-error (libgit-log-pickaxe repo "foo" nil nil '((follow . t)))))))
@@ -87,3 +87,140 @@
                      (cl-loop for i below 3
                               collect (libgit-commit-id
                                        (libgit-commit-nth-gen-ancestor head i))))))))
+
+(ert-deftest revwalk-next-n ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "abc")
+    (commit-change "b" "abc")
+    (commit-change "c" "abc")
+    (commit-change "d" "abc")
+    (commit-change "e" "abc")
+    (let* ((repo (libgit-repository-open path))
+           (walk (libgit-revwalk-new repo))
+           (head (libgit-revparse-single repo "HEAD"))
+           (expected (cl-loop for i below 5
+                              collect (libgit-commit-id
+                                       (libgit-commit-nth-gen-ancestor head i)))))
+      (libgit-revwalk-push-head walk)
+      (let ((first (libgit-revwalk-next-n walk 2))
+            (second (libgit-revwalk-next-n walk 2))
+            (third (libgit-revwalk-next-n walk 2)))
+        (should (= 2 (length first)))
+        (should (= 2 (length second)))
+        (should (= 1 (length third)))
+        (should (equal expected (append first second third nil)))))))
+
+(ert-deftest revwalk-search ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1" "Add feature")
+    (commit-change "a" "2" "fix bug\n\nCloses #12")
+    (commit-change "a" "3" "Fix another bug")
+    (let* ((repo (libgit-repository-open path))
+           (walk (libgit-revwalk-new repo))
+           (c1 (rev-parse "HEAD~2"))
+           (c2 (rev-parse "HEAD~1"))
+           (c3 (rev-parse)))
+      (libgit-revwalk-push-head walk)
+      (should (equal (vector c3) (libgit-revwalk-search walk '((message . "Fix")))))
+      (libgit-revwalk-push-head walk)
+      (should (equal (vector c3 c2)
+                     (libgit-revwalk-search walk '((message . "fix") (ignore-case . t)))))
+      (libgit-revwalk-push-head walk)
+      (should (equal (vector c3 c2 c1)
+                     (libgit-revwalk-search walk '((author . "author@example")))))
+      (libgit-revwalk-push-head walk)
+      (should (equal [] (libgit-revwalk-search walk '((committer . "nobody")))))
+      (libgit-revwalk-push-head walk)
+      (should (equal [] (libgit-revwalk-search walk '((since . 4102444800)))))
+
+      ;; Paging keeps the position of the walk
+      (libgit-revwalk-push-head walk)
+      (should (equal (vector c3) (libgit-revwalk-search walk '((message . "bug")) 1)))
+      (should (equal (vector c2) (libgit-revwalk-search walk '((message . "bug")) 1)))
+      (should (equal [] (libgit-revwalk-search walk '((message . "bug")) 1)))
+
+      (unless (eq system-type 'windows-nt)
+        (libgit-revwalk-push-head walk)
+        (should (equal (vector c2)
+                       (libgit-revwalk-search walk '((message-regexp . "^Closes #[0-9]+$"))))))
+      (should-error (libgit-revwalk-search walk '((no-such-filter . t)))))))
+
+(ert-deftest revwalk-limit ()
+  (with-temp-dir path
+    (init)
+    (dotimes (i 8)
+      (let ((process-environment
+             (cons (format "GIT_COMMITTER_DATE=%d +0000" (+ 1000000000 (* i 100)))
+                   process-environment)))
+        (commit-change "a" (number-to-string i))))
+    (let* ((repo (libgit-repository-open path))
+           (walk (libgit-revwalk-new repo))
+           (ids (cl-loop for i below 8 collect (rev-parse (format "HEAD~%d" i)))))
+      (libgit-revwalk-limit walk '((since . 1000000500)))
+      (libgit-revwalk-push-head walk)
+      (should (equal (cl-subseq ids 0 3) (append (libgit-revwalk-next-n walk 10) nil)))
+
+      (libgit-revwalk-limit walk '((since . 1000000100) (until . 1000000600) (skip . 1) (max-count . 3)))
+      (libgit-revwalk-push-head walk)
+      (should (equal (cl-subseq ids 2 5) (append (libgit-revwalk-next-n walk 10) nil)))
+
+      ;; Counts carry over between pages
+      (libgit-revwalk-push-head walk)
+      (should (equal (list (nth 2 ids)) (append (libgit-revwalk-next-n walk 1) nil)))
+      (should (equal (cl-subseq ids 3 5) (append (libgit-revwalk-next-n walk 10) nil)))
+
+      ;; Other orders only skip commits
+      (libgit-revwalk-sorting walk '(topological))
+      (libgit-revwalk-limit walk '((since . 1000000500)))
+      (libgit-revwalk-push-head walk)
+      (should (equal (cl-subseq ids 0 3) (append (libgit-revwalk-next-n walk 10) nil)))
+
+      (libgit-revwalk-limit walk nil)
+      (libgit-revwalk-push-head walk)
+      (should (= 8 (length (libgit-revwalk-next-n walk 10))))
+      (should-error (libgit-revwalk-limit walk '((skip . -1))))
+      (should-error (libgit-revwalk-limit walk '((no-such-limit . 1)))))))
+
+(ert-deftest revwalk-hide-where ()
+  (with-temp-dir path
+    (init)
+    (commit-change "a" "1")
+    (create-branch "trunk")
+    (create-branch "side")
+    (commit-change "b" "1")
+    (checkout "trunk")
+    (commit-change "a" "2")
+    (merge "side")
+    (let* ((repo (libgit-repository-open path))
+           (walk (libgit-revwalk-new repo))
+           (merge (rev-parse))
+           (main (rev-parse "HEAD^1"))
+           (side (rev-parse "HEAD^2"))
+           (root (rev-parse "HEAD^1^")))
+      (cl-flet ((walk-ids (specs)
+                  (libgit-revwalk-hide-where walk specs)
+                  (libgit-revwalk-push-head walk)
+                  (sort (append (libgit-revwalk-next-n walk 10) nil) #'string<)))
+        (should (equal (sort (list main side root) #'string<)
+                       (walk-ids '((merges . t)))))
+        (should (equal (sort (list merge main root) #'string<)
+                       (walk-ids '((first-parent-below . 0)))))
+        (should (equal (sort (list merge main side root) #'string<)
+                       (walk-ids '((first-parent-below . 1)))))
+        (should (equal (sort (list merge main) #'string<)
+                       (walk-ids '((glob . "heads/side*")))))
+        (should (equal nil (walk-ids '((author . "author@example")))))
+        (should (equal (sort (list merge main side root) #'string<)
+                       (walk-ids nil))))
+      ;; only `merges' and `author' can change during a walk
+      (libgit-revwalk-push-head walk)
+      (should (equal (vector merge) (libgit-revwalk-next-n walk 1)))
+      (libgit-revwalk-hide-where walk '((author . "author@example")))
+      (should-error (libgit-revwalk-hide-where walk '((glob . "heads/side*"))))
+      (should-error (libgit-revwalk-hide-where walk '((first-parent-below . 0))))
+      (should (equal [] (libgit-revwalk-next-n walk 10)))
+      (libgit-revwalk-hide-where walk '((first-parent-below . 0)))
+      (should-error (libgit-revwalk-hide-where walk '((first-parent-below . -1))))
+      (should-error (libgit-revwalk-hide-where walk '((no-such-spec . t)))))))